@@ -6,6 +6,7 @@ import {F_OK} from "constants";
 import {v4} from 'uuid'
 import {Test} from "tape";
 import {Obj} from "./object";
+import {CommandRecorder} from "./painter";
 
 const filePath = join(__dirname, '../test-documents/test.pdf'),
     pwdDoc = join(__dirname, '../test-documents/pwd.pdf')
@@ -51,6 +52,60 @@ tap('Document Api', sub => {
                 end(t)
             })
 
+            standard.test('font encoding conversions', t => {
+                const encoding = pdf.createFont({fontName: 'monospace', encoding: FontEncoding.WinAnsi}).getEncoding(),
+                    bytes = encoding.convertToEncoding('a\u0000\u20ac\u00e9')
+                t.assert(Buffer.isBuffer(bytes), 'returns a Buffer')
+                t.deepEqual([...bytes], [0x61, 0x00, 0x80, 0xe9], 'binary safe, table driven')
+                t.equal(encoding.convertToUnicode(bytes), 'a\u0000\u20ac\u00e9', 'round trip')
+                const batch = encoding.convertToEncoding(['one', 'two'])
+                t.deepEqual(batch.map(b => b.toString('latin1')), ['one', 'two'], 'batch conversion')
+                t.deepEqual(encoding.convertToUnicode(batch), ['one', 'two'])
+                end(t)
+            })
+
+            standard.test('document fonts share the process font cache', t => {
+                new Document(filePath).on('ready', (other: Document) => {
+                    const a = pdf.createFont({fontName: 'monospace', encoding: FontEncoding.Identity}),
+                        b = other.createFont({fontName: 'monospace', encoding: FontEncoding.Identity})
+                    t.equal(a.getMetrics().fileName, b.getMetrics().fileName, 'resolved to the same face')
+                    t.equal(a.stringWidth('NoPoDoFo'), b.stringWidth('NoPoDoFo'), 'same metrics in both documents')
+                    end(t)
+                })
+            })
+
+            standard.test('document create font from data', t => {
+                const file = pdf.createFont({fontName: 'monospace', encoding: FontEncoding.Identity}).getMetrics().fileName
+                readFile(file, (e, data) => {
+                    if (e) t.fail(e.message)
+                    const font = pdf.createFont({fontName: 'custom', encoding: FontEncoding.Identity, embed: true, data})
+                    t.ok(font.getMetrics(), 'font loaded from a buffer')
+                    t.ok(font.stringWidth('NoPoDoFo') > 0, 'font from a buffer measures text')
+                    t.throws(() => pdf.createFont({fontName: 'custom', data: Buffer.from('not a font')}), 'invalid font data throws')
+                    t.throws(() => pdf.createFont({fontName: 'custom', data: Buffer.concat([Buffer.from('OTTO'), data.slice(4)])}),
+                        /TrueType outlines/, 'CFF OpenType data is rejected')
+                    end(t)
+                })
+            })
+
+            standard.test('document reuses fonts', t => {
+                const first = pdf.createFont({fontName: 'monospace', encoding: FontEncoding.Identity, embed: true, subset: false}),
+                    second = pdf.createFont({fontName: 'monospace', encoding: FontEncoding.Identity, embed: true, subset: false}),
+                    bold = pdf.createFont({fontName: 'monospace', bold: true, encoding: FontEncoding.Identity, embed: true, subset: false})
+                t.equal(second.getIdentifier(), first.getIdentifier(), 'same face, style and encoding share a font')
+                t.notEqual(bold.getIdentifier(), first.getIdentifier(), 'another style is another font')
+                end(t)
+            })
+
+            standard.test('document create subset font', t => {
+                const subset = pdf.createFont({fontName: 'monospace', encoding: FontEncoding.Identity, embed: true}),
+                    whole = pdf.createFont({fontName: 'monospace', encoding: FontEncoding.Identity, embed: true, subset: false})
+                t.true(subset.isSubsetting(), 'embedded identity fonts are subset by default')
+                t.false(whole.isSubsetting(), 'subset can be disabled')
+                t.doesNotThrow(() => subset.embed(), 'embedding a subset is deferred to write')
+                end(t)
+            })
+
             standard.test('document delete page object by index', t => {
                 const beforeCount = pdf.getPageCount()
                 pdf.deletePage(0)
@@ -79,6 +134,83 @@ tap('Document Api', sub => {
                     })
                 })
             })
+            standard.test('search', t => {
+                pdf.search(/[a-z]+/, {caseFold: true, index: true})
+                    .then(hits => {
+                        t.assert(hits instanceof Array, 'search resolves an array of hits')
+                        hits.forEach(hit => {
+                            t.assert(hit.page >= 0 && hit.page < pdf.getPageCount(), 'hit page index in range')
+                            t.assert(hit.rects.length > 0, 'hit has rectangles')
+                        })
+                        return pdf.search('nopodofo-no-such-text', {index: true})
+                    })
+                    .then(hits => {
+                        t.assert(hits.length === 0, 'indexed search for missing text is empty')
+                        t.end()
+                    })
+                    .catch(e => t.fail(e.message))
+            })
+            standard.test('extract tables', t => {
+                pdf.extractTables()
+                    .then(tables => {
+                        t.assert(tables instanceof Array, 'resolves an array of tables')
+                        tables.forEach(table => {
+                            t.assert(table.rows.length === table.rowEdges.length - 1, 'a row between each pair of row rules')
+                            t.assert(table.rows[0].length === table.columns.length - 1, 'a cell between each pair of column rules')
+                        })
+                        t.end()
+                    })
+                    .catch(e => t.fail(e.message))
+            })
+            standard.test('filter contents', t => {
+                pdf.filterContents({pages: [0], operators: ['BMC', 'BDC', 'EMC']})
+                    .then(count => {
+                        t.assert(count === 1, 'one page rewritten')
+                        return pdf.search('nopodofo-no-such-text')
+                    })
+                    .then(hits => {
+                        t.assert(hits.length === 0, 'rewritten page can be searched')
+                        t.end()
+                    })
+                    .catch(e => t.fail(e.message))
+            })
+            standard.test('render pages', t => {
+                const jobs = []
+                for (let page = 0; page < pdf.getPageCount(); page++) {
+                    const commands = new CommandRecorder()
+                    commands.save().setGrey(0.9).rectangle(10, 10, 50, 20).fill().restore()
+                    jobs.push({page, commands})
+                }
+                let before: number
+                pdf.search('withholding')
+                    .then(hits => {
+                        before = hits.length
+                        t.assert(before > 0, 'page text found before rendering')
+                        return pdf.renderPages(jobs)
+                    })
+                    .then(count => {
+                        t.assert(count === pdf.getPageCount(), 'every page rendered')
+                        return pdf.search('withholding')
+                    })
+                    .then(hits => {
+                        t.equal(hits.length, before, 'original page text survives')
+                        return pdf.renderPages([{page: pdf.getPageCount(), commands: new CommandRecorder()}])
+                    })
+                    .then(() => t.fail('page out of range should reject'))
+                    .catch(e => {
+                        t.assert(e instanceof Error, 'rejects a page out of range')
+                        t.end()
+                    })
+            })
+            standard.test('optimize images', t => {
+                pdf.optimizeImages({maxDpi: 72, jpegQuality: 60})
+                    .then(result => {
+                        t.assert(result.optimized <= result.images, 'optimizes a subset of the images')
+                        t.assert(result.bytesAfter <= result.bytesBefore, 'never grows the image streams')
+                        t.end()
+                    })
+                    .catch(e => t.fail(e.message))
+            })
             standard.test('is allowed', t => {
                 t.ok(pdf.isAllowed('Copy'), 'Copy protection not defined. Can get ProtectionProperties')
                 t.end()
@@ -48,9 +48,110 @@ export interface CreateFontOpts {
     italic?: boolean,
     encoding?: FontEncoding,
     embed?: boolean,
-    fileName?: string
+    fileName?: string,
+    /**
+     * TrueType or OpenType font file contents, used instead of fontName / fileName
+     */
+    data?: Buffer,
+    /**
+     * only embed the glyphs that are drawn, applies to embedded fonts with the Identity encoding. default: true
+     */
+    subset?: boolean
+}
+
+export interface SearchOptions {
+    caseFold?: boolean,
+    wholeWord?: boolean,
+    /**
+     * Build (or reuse) a per-document trigram index, repeated queries against the
+     * same document then only scan pages that may contain the query.
+     */
+    index?: boolean
+}
+
+export interface SearchHit {
+    /**
+     * zero based page index, as used by Document.getPage
+     */
+    page: number,
+    text: string,
+    rects: Array<{ left: number, bottom: number, width: number, height: number }>
+}
+
+export interface ExtractedTable {
+    /**
+     * zero based page index, as used by Document.getPage
+     */
+    page: number,
+    left: number,
+    bottom: number,
+    width: number,
+    height: number,
+    /**
+     * x of each column rule, left to right
+     */
+    columns: Array<number>,
+    /**
+     * y of each row rule, top to bottom
+     */
+    rowEdges: Array<number>,
+    /**
+     * text of each cell, rows top to bottom
+     */
+    rows: Array<Array<string>>
 }
 
+export interface RenderJob {
+    /**
+     * zero based page index, as used by Document.getPage
+     */
+    page: number,
+    /**
+     * recorded drawing, i.e. a CommandRecorder
+     */
+    commands: { opcodes: Uint8Array, args: Float64Array }
+}
+
+export interface OptimizeImagesOptions {
+    /**
+     * images shown at a higher resolution are downsampled to this, 0 disables downsampling
+     */
+    maxDpi?: number,
+    /**
+     * quality (1 - 100) for JPEG images re-encoded as JPEG, 0 re-encodes them with flate instead
+     */
+    jpegQuality?: number,
+    /**
+     * store colour images that only contain grey pixels as DeviceGray
+     */
+    grayscaleDetect?: boolean
+}
+
+export interface OptimizeImagesResult {
+    images: number,
+    optimized: number,
+    bytesBefore: number,
+    bytesAfter: number
+}
+
+export interface FilterContentsOptions {
+    /**
+     * zero based page indices, every page when omitted
+     */
+    pages?: Array<number>,
+    /**
+     * content stream operators to drop, i.e. ['BDC', 'BMC', 'EMC']
+     */
+    operators?: Array<string>,
+    /**
+     * resource names of XObjects whose Do operator is dropped
+     */
+    xobjects?: Array<string>,
+    /**
+     * clip all content to this rectangle
+     */
+    clip?: { left: number, bottom: number, width: number, height: number }
+}
 
 /**
  * @class Document
@@ -281,10 +382,104 @@ export class Document extends EventEmitter {
             opts.hasOwnProperty('italic') ? opts.italic : false,
             opts.hasOwnProperty('encoding') ? opts.encoding : 1,
             opts.hasOwnProperty('embed') ? opts.embed : false,
-            opts.hasOwnProperty('fileName') ? opts.fileName : null)
+            opts.data ? opts.data : opts.hasOwnProperty('fileName') ? opts.fileName : null,
+            opts.hasOwnProperty('subset') ? opts.subset : true)
         return new Font(instance)
     }
 
+    /**
+     * @desc Search the text of every page. Text is extracted natively, pages are processed in parallel.
+     *      A RegExp is matched line by line, in windows of at most 1024 characters.
+     * @param {string | RegExp} query
+     * @param {SearchOptions} opts
+     * @returns {Promise<Array<SearchHit>>} - each hit with the page index and the rectangles covering the match
+     */
+    search(query: string | RegExp, opts: SearchOptions = {}): Promise<Array<SearchHit>> {
+        if (!this._loaded) {
+            return Promise.reject(new Error('load a pdf file before calling this method'))
+        }
+        const isRegExp = query instanceof RegExp,
+            source = isRegExp ? (query as RegExp).source : query as string,
+            caseFold = opts.caseFold === true || (isRegExp && (query as RegExp).flags.indexOf('i') !== -1)
+        return new Promise((resolve, reject) => {
+            this._instance.search(source, isRegExp, caseFold, opts.wholeWord === true, opts.index === true,
+                (e: Error, hits: Array<SearchHit>) => e ? reject(e) : resolve(hits))
+        })
+    }
+
+    /**
+     * @desc Rewrite page content streams in a single pass through the configured filters.
+     *      Pages are rewritten in parallel.
+     * @param {FilterContentsOptions} opts
+     * @returns {Promise<number>} - the number of pages rewritten
+     */
+    filterContents(opts: FilterContentsOptions): Promise<number> {
+        if (!this._loaded) {
+            return Promise.reject(new Error('load a pdf file before calling this method'))
+        }
+        const clip = opts.clip ? [opts.clip.left, opts.clip.bottom, opts.clip.width, opts.clip.height] : []
+        return new Promise((resolve, reject) => {
+            this._instance.filterContents(opts.pages || [], opts.operators || [], opts.xobjects || [], clip,
+                (e: Error, count: number) => e ? reject(e) : resolve(count))
+        })
+    }
+
+    /**
+     * @desc Find tables drawn with ruling lines and read the text of their cells. Pages are processed in parallel.
+     * @param {Array<number>} pages - zero based page indices, every page when omitted
+     * @returns {Promise<Array<ExtractedTable>>}
+     */
+    extractTables(pages: Array<number> = []): Promise<Array<ExtractedTable>> {
+        if (!this._loaded) {
+            return Promise.reject(new Error('load a pdf file before calling this method'))
+        }
+        return new Promise((resolve, reject) => {
+            this._instance.extractTables(pages, (e: Error, tables: Array<ExtractedTable>) => e ? reject(e) : resolve(tables))
+        })
+    }
+
+    /**
+     * @desc Serialize recorded drawing for many pages at once. Each command buffer becomes a content stream on a
+     *      worker thread, streams are then appended to their pages in order. The buffers may be reused as soon as
+     *      this returns.
+     * @param {Array<RenderJob>} jobs
+     * @param {number} precision - decimals written for each number
+     * @returns {Promise<number>} - the number of pages rendered
+     */
+    renderPages(jobs: Array<RenderJob>, precision: number = 3): Promise<number> {
+        if (!this._loaded) {
+            return Promise.reject(new Error('load a pdf file before calling this method'))
+        }
+        return new Promise((resolve, reject) => {
+            this._instance.renderPages(
+                jobs.map(job => job.page),
+                jobs.map(job => job.commands.opcodes),
+                jobs.map(job => job.commands.args),
+                precision,
+                (e: Error, count: number) => e ? reject(e) : resolve(count))
+        })
+    }
+
+    /**
+     * @desc Shrink the images painted on the pages of this document. Every image is downsampled to maxDpi at its
+     *      largest placement and reduced to gray where it has no colour; images are only replaced when the result
+     *      is smaller. Decoding and encoding run on worker threads.
+     * @param {OptimizeImagesOptions} opts
+     * @returns {Promise<OptimizeImagesResult>}
+     */
+    optimizeImages(opts: OptimizeImagesOptions = {}): Promise<OptimizeImagesResult> {
+        if (!this._loaded) {
+            return Promise.reject(new Error('load a pdf file before calling this method'))
+        }
+        return new Promise((resolve, reject) => {
+            this._instance.optimizeImages(
+                opts.maxDpi === undefined ? 150 : opts.maxDpi,
+                opts.jpegQuality === undefined ? 75 : opts.jpegQuality,
+                opts.grayscaleDetect === undefined ? true : opts.grayscaleDetect,
+                (e: Error, result: OptimizeImagesResult) => e ? reject(e) : resolve(result))
+        })
+    }
+
     writeUpdate(device: string | Signer): void {
         if (device instanceof Signer)
             this._instance.writeUpdate((device as any)._instance)
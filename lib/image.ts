@@ -26,7 +26,7 @@ export class Image {
     /**
      *
      * @param {Document} _doc - document to embed image in
-     * @param {string | Buffer} data - image file path, or image buffer (buffer not yet implemented)
+     * @param {string | Buffer} data - image file path, or JPEG, PNG or TIFF image data
      */
     constructor(private _doc: Document, data?: string | Buffer) {
         if (data) {
@@ -42,8 +42,12 @@ export class Image {
     getHeight(): number {
         return this._instance.getHeight()
     }
+    /**
+     * @description Loading the same file twice embeds it once, the second image reuses the XObject of the first.
+     *      Other documents loading the file reuse the encoded stream without decoding the file again.
+     */
     loadFromFile(file: string): void {
-        this._instance.setFile(file)
+        this._instance.loadFromFile(file)
     }
     /**
      * @description Embeds data as an image on the document. To use this image pass to Painter.drawImage.
@@ -53,11 +57,22 @@ export class Image {
      * @returns void
      */
     loadFromBuffer(data: Buffer | string): void {
-        if(Buffer.isBuffer(data)) this._instance.setData(data.toString('utf8'))
+        if(Buffer.isBuffer(data)) this._instance.setData(data)
         else if(typeof data === 'string' || (data as any) instanceof String)
-            this._instance.setData(data)
+            this._instance.setData(Buffer.from(data as string, 'binary'))
         else throw new TypeError("Image.setData requires a single argument of type string | Buffer")
     }
+
+    /**
+     * @description Read and decode the image on a worker thread. The format (JPEG, PNG or TIFF) is detected from
+     *      the data. A Buffer is decoded in place, do not modify it until the promise settles.
+     * @param {string | Buffer} source - image file path or image data
+     */
+    load(source: string | Buffer): Promise<void> {
+        return new Promise((resolve, reject) => {
+            this._instance.loadAsync(source, (e: Error) => e ? reject(e) : resolve())
+        })
+    }
     isLoaded(): boolean {
         return this._instance.isLoaded()
     }
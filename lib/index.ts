@@ -57,7 +57,7 @@ import {Stream} from './stream'
 import {Form} from './form'
 import {ContentsTokenizer} from './parser'
 import {Ref} from './reference'
-import {Cell, Table} from './table'
+import {Cell, Table, TableWriter} from './table'
 
 
 export {
@@ -99,7 +99,8 @@ export {
     signature,
     Ref,
     Cell,
-    Table
+    Table,
+    TableWriter
 }
 export const CONVERSION = 0.0028346456693
 
@@ -1,4 +1,4 @@
-import {existsSync, unlinkSync, writeFile} from 'fs'
+import {existsSync, readFileSync, unlinkSync, writeFile} from 'fs'
 import {join} from 'path'
 import * as test from 'tape'
 import {Document} from './document'
@@ -7,6 +7,8 @@ import {Field} from './field';
 import {Painter} from "./painter";
 import {Image} from "./image";
 import {Page} from "./page";
+import {Rect} from "./rect";
+import {inflateSync} from 'zlib'
 
 
 const filePath = join(__dirname, '../test-documents/test.pdf'),
@@ -139,6 +141,26 @@ function pageResources() {
     })
 }
 
+function pageLoadImgBuffer() {
+    test('load image from buffer', t => {
+        const data = readFileSync(join(__dirname, '../test-documents/test.jpg')),
+            img = new Image(doc),
+            loaded = new Image(doc)
+        t.doesNotThrow(() => img.loadFromBuffer(data), 'binary data with NULs loads')
+        t.assert(img.isLoaded(), 'image is loaded')
+        loaded.load(data)
+            .then(() => {
+                t.equal(loaded.getWidth(), img.getWidth(), 'async load decodes the same image')
+                return new Image(doc).load(Buffer.from('not an image'))
+            })
+            .then(() => t.fail('unknown data should be rejected'))
+            .catch(e => {
+                t.assert(e instanceof Error, 'rejects data that is not an image')
+                t.end()
+            })
+    })
+}
+
 function pageAddImg() {
     test('add image', t => {
         const painter = new Painter(doc),
@@ -146,6 +168,11 @@ function pageAddImg() {
 
         painter.page = page
         painter.drawImage(img, 0, page.height - img.getHeight())
+        const objects = doc.getObjects().length,
+            again = new Image(doc, join(__dirname, '../test-documents/test.jpg'))
+        t.equal(doc.getObjects().length, objects, 'same file embeds once per document')
+        t.equal(again.getWidth(), img.getWidth())
+        painter.drawImage(again, 100, page.height - img.getHeight())
         painter.finishPage()
 
         doc.write('./img.out.pdf', e => {
@@ -204,6 +231,72 @@ function pageAddImg() {
     })
 }
 
+function pageHitTest() {
+    test('hit test and query', t => {
+        const count = page.getNumAnnots(),
+            all = page.query(new Rect([0, 0, page.width, page.height]))
+        t.assert(all.length === count, 'query over the page finds every annotation')
+        if (count > 0) {
+            const annot = all[0],
+                hits = page.hitTest(annot.left + annot.width / 2, annot.bottom + annot.height / 2)
+            t.assert(hits.some(hit => hit.annotation === annot.annotation), 'hit test finds the annotation under a point')
+        }
+        const text = page.query(new Rect([0, 0, page.width, page.height]), true)
+        t.assert(text.length >= all.length, 'text runs are added on request')
+        t.end()
+    })
+}
+
+function pageRedact() {
+    test('redact', t => {
+        const last = doc.getPage(doc.getPageCount() - 1),
+            removed = last.redact([new Rect([0, 0, last.width, last.height / 2])])
+        t.assert(typeof removed === 'number' && removed >= 0, 'returns the number of glyphs removed')
+        t.assert(last.getContents(false).length > 0, 'redaction boxes are painted')
+        t.end()
+    })
+    test('redact multi stream contents', t => {
+        const source = readFileSync(filePath),
+            original = decodedStreams(source),
+            listed = /\/Contents\[([^\]]*)\]/.exec(source.toString('latin1')) as RegExpExecArray,
+            refs = listed[1].trim().split(/\s+R\s*/).filter(r => r).map(r => parseInt(r, 10)),
+            secrets = refs.map(ref => original.get(ref) as string).filter(s => /T[jJ]/.test(s)),
+            redacted = new Document(source)
+        t.assert(refs.length > 1 && secrets.length > 1, 'page has text in several content streams')
+        redacted.on('ready', () => {
+            const first = redacted.getPage(0)
+            t.assert(first.redact([new Rect([0, 0, first.width, first.height])]) > 0, 'glyphs removed')
+            redacted.write((e: Error, data: Buffer) => {
+                if (e instanceof Error) t.fail(e.message)
+                const written = Array.from(decodedStreams(data).values())
+                t.assert(secrets.every(secret => written.every(stream => stream.indexOf(secret) === -1)),
+                    'no original content stream is written')
+                t.end()
+            })
+        })
+    })
+}
+
+// Decoded flate streams of a PDF file by object number
+function decodedStreams(data: Buffer): Map<number, string> {
+    const streams = new Map<number, string>(),
+        text = data.toString('latin1'),
+        pattern = /(\d+) \d+ obj\s*<<((?:(?!endobj)[^])*?)>>\s*stream\r?\n/g
+    let match: RegExpExecArray | null
+    while ((match = pattern.exec(text)) !== null) {
+        const start = match.index + match[0].length,
+            end = text.indexOf('endstream', start)
+        if (match[2].indexOf('FlateDecode') === -1 || end === -1) continue
+        try {
+            streams.set(parseInt(match[1], 10), inflateSync(data.slice(start, end)).toString('latin1'))
+        } catch (e) {
+            // truncated by the trailing end of line, keep what zlib recovered
+            streams.set(parseInt(match[1], 10), inflateSync(data.slice(start, end), {finishFlush: 2}).toString('latin1'))
+        }
+    }
+    return streams
+}
+
 function runTest(test: Function) {
     setImmediate(() => {
         global.gc()
@@ -224,7 +317,10 @@ export function runAll() {
         pageGetAnnot,
         pageContents,
         pageResources,
-        pageAddImg
+        pageAddImg,
+        pageLoadImgBuffer,
+        pageHitTest,
+        pageRedact
     ].map(i => runTest(i))
 }
 
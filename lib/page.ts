@@ -43,6 +43,29 @@ export interface IPage {
     getAnnotation(index: number): Annotation
     getAnnotations(): Array<Annotation>
     deleteAnnotation(index: number): void
+    redact(rects: Array<Rect>): number
+    hitTest(x: number, y: number, text?: boolean): Array<PageHit>
+    query(rect: Rect, text?: boolean): Array<PageHit>
+}
+
+export interface PageHit {
+    type: 'annotation' | 'field' | 'text',
+    /**
+     * index as used by Page.getAnnotation, annotations and fields only
+     */
+    annotation?: number,
+    /**
+     * index as used by Page.getField, fields only
+     */
+    field?: number,
+    /**
+     * text shown by the run, text only
+     */
+    text?: string,
+    left: number,
+    bottom: number,
+    width: number,
+    height: number
 }
 
 export class Page implements IPage {
@@ -163,6 +186,42 @@ export class Page implements IPage {
         this._instance.deleteAnnotation(index)
     }
 
+    /**
+     * @desc Permanently remove the glyphs and image pixels under the rectangles, then paint black boxes over them.
+     *      Images that can not be decoded, inline images and form XObjects touching a rectangle are removed entirely.
+     *      Throws when text in a font that can not be resolved may lie under a rectangle.
+     * @param {Array<Rect>} rects
+     * @returns {number} - the number of glyphs removed
+     */
+    redact(rects: Array<Rect>): number {
+        rects.forEach(rect => Page.assertRect(rect))
+        return this._instance.redact(rects.map(rect => (rect as any)._instance))
+    }
+
+    /**
+     * @desc Everything on the page at a point, topmost annotation first and text runs last.
+     *      Backed by a per page R-tree that is built on first use and kept up to date by createAnnotation and
+     *      deleteAnnotation.
+     * @param {number} x
+     * @param {number} y
+     * @param {boolean} text - include text runs, the page text is extracted on first use
+     * @returns {Array<PageHit>}
+     */
+    hitTest(x: number, y: number, text: boolean = false): Array<PageHit> {
+        return this._instance.hitTest(x, y, text)
+    }
+
+    /**
+     * @desc Everything on the page overlapping a rectangle, see hitTest
+     * @param {Rect} rect
+     * @param {boolean} text - include text runs
+     * @returns {Array<PageHit>}
+     */
+    query(rect: Rect, text: boolean = false): Array<PageHit> {
+        Page.assertRect(rect)
+        return this._instance.query(rect.left, rect.bottom, rect.width, rect.height, text)
+    }
+
     private static assertRect(rect: Rect) {
         if (rect.bottom === null ||
             rect.height === null ||
@@ -1,10 +1,12 @@
-import {Painter} from './painter'
+import {CommandRecorder, NPDFAlignment, Painter} from './painter'
 import * as tap from 'tape'
 import {join} from 'path';
 import {Document, FontEncoding} from './document';
 import {CONVERSION} from "./index";
 import {Rect} from "./rect";
-import {Cell, Table} from "./table";
+import {Cell, Table, TableWriter} from "./table";
+import {Obj} from "./object";
+import {inflateSync} from 'zlib'
 
 tap('Painter Api', sub => {
     const filePath = join(__dirname, '../test-documents/test.pdf'),
@@ -70,6 +72,249 @@ tap('Painter Api', sub => {
             })
         })
 
+        sub.test('font measure', t => {
+            const strings = ['Grayscale', 'Colour space', ''],
+                widths = font.measure(strings)
+            t.assert(widths instanceof Float64Array, 'returns a Float64Array')
+            t.equal(widths.length, strings.length, 'one width per string')
+            strings.forEach((s, i) => t.assert(Math.abs(widths[i] - font.stringWidth(s)) < 0.01, `measures "${s}"`))
+            const spaced = font.measure(['Colour space'], {size: font.size * 2, wordSpace: 5})
+            t.assert(Math.abs(spaced[0] - (widths[1] * 2 + 5)) < 0.01, 'size and word space options')
+            const charSpace = font.charSpace
+            font.charSpace = 10
+            const tracked = font.measure(strings)
+            strings.forEach((s, i) => t.assert(Math.abs(tracked[i] - font.stringWidth(s)) < 0.01,
+                `measures "${s}" with char space`))
+            font.charSpace = charSpace
+            t.assert(Math.abs(font.measure(strings, {charSpace: 10})[0] - tracked[0]) < 0.01, 'char space option')
+            t.throws(() => font.measure([1 as any]), /array of strings/)
+            t.end()
+        })
+
+        sub.test('text shaping', t => {
+            const mixed = font.shape('abc \u05d0\u05d1\u05d2 def')
+            t.equal(mixed.text, 'abc \u05d2\u05d1\u05d0 def', 'hebrew run reversed inside left to right text')
+            t.false(mixed.rtl)
+            const hebrew = font.shape('\u05e9\u05dc\u05d5\u05dd 123 (abc)')
+            t.true(hebrew.rtl, 'direction from the first strong character')
+            t.equal(hebrew.text, '(abc) 123 \u05dd\u05d5\u05dc\u05e9', 'numbers and latin keep their order')
+            t.equal(hebrew.adjustments.length, [...hebrew.text].length, 'one adjustment per glyph')
+            t.equal(font.shape('AVAV', {kerning: false}).adjustments.every(a => a === 0), true, 'kerning can be disabled')
+            t.equal(pdf.createFont({fontName: 'monospace'}).shape('office').text, 'office',
+                'no ligatures a WinAnsi font can not encode')
+            const writer = new Painter(doc, pdf.getPage(0))
+            writer.font = font
+            writer.shaping = {direction: 'rtl'}
+            t.deepEqual(writer.shaping, {kerning: true, ligatures: true, direction: 'rtl'})
+            t.doesNotThrow(() => {
+                writer.drawText({x: 20, y: 60}, '\u05e9\u05dc\u05d5\u05dd AVATAR')
+                writer.drawTextAligned({x: 20, y: 40, width: 200}, 'office', NPDFAlignment.Center)
+            })
+            writer.shaping = false
+            writer.finishPage()
+            t.end()
+        })
+
+        sub.test('text layout', t => {
+            const writer = new Painter(doc, pdf.getPage(0)),
+                text = 'The quick brown fox jumps over the lazy dog. ' +
+                    'Pack my box with five dozen liquor jugs.\nSecond paragraph'
+            writer.font = font
+            const single = writer.layoutText([{font, size: 12, text: 'Hello'}], 1000)
+            t.equal(single.lines.length, 1, 'short text fits on one line')
+            t.equal(single.lines[0].text, 'Hello')
+            const greedy = writer.layoutText([{font, size: 12, text}], 150),
+                optimal = writer.layoutText([{font, size: 12, text}], 150, {breaking: 'optimal', justify: true})
+            t.assert(greedy.lines.length > 2, 'breaks into several lines')
+            t.assert(greedy.lines.every(l => l.width <= 150 + 1e-6), 'lines fit the width')
+            t.equal(greedy.lines[greedy.lines.length - 1].text, 'Second paragraph', 'newline forces a break')
+            t.equal(optimal.lines.map(l => l.text.replace(/ /g, '')).join(''),
+                greedy.lines.map(l => l.text.replace(/ /g, '')).join(''), 'same text either way')
+            const hyphenated = writer.layoutText([{font, size: 12, text: 'extraordinarily'}], 60,
+                {hyphenate: w => w === 'extraordinarily' ? ['extra', 'ordi', 'narily'] : [w]})
+            t.assert(hyphenated.lines[0].hyphenated, 'breaks at a hyphenation point')
+            t.assert(writer.getMultiLineText(150, text).length > 2, 'getMultiLineText returns lines')
+            t.doesNotThrow(() => {
+                writer.drawTextLayout([{font, size: 12, text: 'Bold '}, {font, size: 9, text}], {x: 50, y: 700}, 200)
+                writer.drawMultiLineText(new Rect([50, 400, 200, 100]), text, 0, 0, true, true)
+            })
+            writer.finishPage()
+            t.end()
+        })
+
+        sub.test('async draws', t => {
+            const report = new Painter(doc, pdf.getPage(0)),
+                table = new Table(doc, 3, 20)
+            report.font = font
+            table.font = font
+            for (let r = 0; r < 20; r++) {
+                for (let c = 0; c < 3; c++) {
+                    new Cell(table, c, r).text = `${r}:${c}`
+                }
+            }
+            const drawing = report.drawMultiLineTextAsync(new Rect([50, 400, 200, 100]), 'Quarterly report', 0, 0)
+            t.throws(() => report.drawText({x: 10, y: 10}, 'busy'), /busy/, 'painter refuses calls while drawing')
+            t.throws(() => pdf.createFont({fontName: 'monospace'}), /busy/,
+                'document refuses main thread changes while a worker holds it')
+            drawing
+                .then(() => report.drawImageAsync(join(__dirname, '../test-documents/test.jpg'), 300, 500,
+                    {width: 100, height: 100}))
+                .then(() => table.drawAsync({x: 50, y: 300}, report))
+                .then(() => {
+                    t.doesNotThrow(() => report.finishPage(), 'painter is released once settled')
+                    t.end()
+                })
+                .catch(e => t.fail(e.message))
+        })
+
+        sub.test('table data', t => {
+            const table = new Table(doc, 3, 4),
+                rows = [['a', 'b', 'c'], ['d', 'e', 'f'], ['g', 'h', 'i'], ['j', 'k', 'l']],
+                background = new Array(12).fill(0xFFFFFFFF)
+            background[4] = 0xFF0000
+            table.font = font
+            table.setData(rows, {fonts: [font], font: new Array(12).fill(1), background, alignment: new Array(12).fill(1)})
+            t.equal(new Cell(table, 2, 3).text, 'l', 'row major data')
+            t.assert(new Cell(table, 1, 1).hasBackgroundColor(), 'per cell background')
+            t.deepEqual(new Cell(table, 1, 1).backgroundColor, [1, 0, 0], 'background colour of the cell')
+            table.foregroundColor = [0.5]
+            t.deepEqual(new Cell(table, 2, 2).foregroundColor, [0.5], 'table wide colour for cells without one')
+            t.throws(() => table.columnWidths([10]), /every column/)
+            t.notOk(new Cell(table, 0, 0).hasBackgroundColor(), 'other cells keep the table background')
+            t.equal(new Cell(table, 0, 0).alignment, 'CENTER', 'per cell alignment')
+            table.setData({columns: [['x', 'y']]})
+            t.equal(new Cell(table, 0, 1).text, 'y', 'column major data')
+            t.equal(new Cell(table, 1, 1).text, 'e', 'cells missing from data are unchanged')
+            t.throws(() => table.setData([['1', '2', '3', '4']]), /more rows or columns/)
+            t.throws(() => table.setData(rows, {font: [1]}), /every cell/)
+            t.end()
+        })
+
+        sub.test('table writer', t => {
+            const before = pdf.getPageCount(),
+                writer = new TableWriter(doc, {
+                    columns: [60, 200, 80],
+                    font,
+                    size: 9,
+                    header: [['#', 'Description', 'Amount']],
+                    pageSize: new Rect([0, 0, 300, 200]),
+                    area: new Rect([20, 20, 260, 160])
+                })
+            let drawn = 0
+            for (let batch = 0; batch < 10; batch++) {
+                const rows = []
+                for (let i = 0; i < 50; i++) {
+                    rows.push([`${batch * 50 + i}`, `Ledger entry ${batch * 50 + i}`, (i * 1.5).toFixed(2)])
+                }
+                drawn += writer.addRows(rows)
+            }
+            t.assert(drawn > 1, 'pages are drawn while rows are added')
+            t.assert(writer.pendingRows < 50, 'drawn rows are released')
+            const total = writer.close()
+            t.equal(pdf.getPageCount(), before + total, 'one page created per table page')
+            t.throws(() => writer.addRows([['late']]), /closed/)
+            t.throws(() => writer.addRows([['1', '2', '3', '4']]), /closed|columns/)
+            t.end()
+        })
+
+        sub.test('table layout', t => {
+            const table = new Table(doc, 2, 30),
+                area = new Rect([0, 0, 200, 100])
+            table.font = font
+            table.wordWrap = true
+            table.setData([['a short cell', 'a much longer cell that has to wrap onto several lines']])
+            table.rowHeight(10)
+            table.autoPageBreak = true
+            const layout = table.layout(area)
+            t.equal(layout.heights.length, 30, 'a height for every row')
+            t.equal(layout.height, 300, 'rows use the configured height')
+            t.deepEqual(layout.pageBreaks, [10, 20], 'rows continue on new pages')
+            t.equal(layout.pages, 3)
+            t.assert(layout.contentHeights[0] > layout.contentHeights[1], 'wrapped text needs more height')
+            t.end()
+        })
+
+        sub.test('exec command buffer', t => {
+            const chart = new Painter(doc, pdf.getPage(0)),
+                recorder = new CommandRecorder(4)
+            recorder.save().setStrokingColor([0.2, 0.4, 0.6]).setStrokeWidth(0.5).moveTo(50, 50)
+            for (let i = 1; i <= 1000; i++) {
+                recorder.lineTo(50 + i * 0.4, 50 + Math.sin(i / 50) * 40)
+            }
+            recorder.stroke().restore()
+            t.assert(recorder.length === 1006, 'records every command, growing past the initial capacity')
+            t.doesNotThrow(() => chart.exec(recorder))
+            t.throws(() => chart.exec({opcodes: new Uint8Array([1]), args: new Float64Array(1)}),
+                'rejects a buffer missing arguments')
+            chart.finishPage()
+            t.end()
+        })
+
+        sub.test('draw path', t => {
+            const plot = new Painter(doc, pdf.getPage(0)),
+                n = 10000,
+                points = new Float64Array(n * 2)
+            for (let i = 0; i < n; i++) {
+                points[i * 2] = i / n
+                points[i * 2 + 1] = Math.sin(i / 100)
+            }
+            t.equal(plot.drawPath(points), n, 'draws every point without a tolerance')
+            const drawn = plot.drawPath(points, {transform: [400, 0, 0, 50, 100, 400], tolerance: 0.5})
+            t.assert(drawn > 2 && drawn < n, `simplified to ${drawn} points`)
+            t.equal(plot.drawPath(points, {counts: [n / 2, n / 2], operation: 'none'}), n, 'splits subpaths')
+            t.throws(() => plot.drawPath(points, {counts: [1]}), /counts/, 'rejects counts not covering the points')
+            plot.finishPage()
+            t.end()
+        })
+
+        sub.test('fast mode', t => {
+            const target = pdf.getPage(0),
+                chart = new Painter(doc, target),
+                recorder = new CommandRecorder()
+            chart.fastMode = true
+            t.assert(chart.fastMode, 'fast mode enabled')
+            recorder.setStrokingGrey(0.5).moveTo(10, 10)
+            for (let i = 0; i < 500; i++) {
+                recorder.lineTo(10 + i, 10 + (i % 7))
+            }
+            recorder.stroke()
+            t.doesNotThrow(() => chart.exec(recorder))
+            chart.setColor([1.0, 0.0, 0.0])
+            t.doesNotThrow(() => chart.exec(recorder.reset().rectangle(20, 20, 40, 40).fill()))
+            t.doesNotThrow(() => chart.finishPage())
+            const raw: Buffer = target.getContents(true).stream
+            let drawn: string
+            try {
+                drawn = inflateSync(raw).toString('latin1')
+            } catch (e) {
+                drawn = raw.toString('latin1')
+            }
+            const stroke = drawn.lastIndexOf('\nS\n'),
+                color = drawn.lastIndexOf(' rg'),
+                rect = drawn.lastIndexOf(' re\n')
+            t.assert(stroke !== -1 && stroke < color && color < rect,
+                'the path is stroked before the colour changes and the rectangle follows it')
+            t.end()
+        })
+
+        sub.test('templates', t => {
+            const stamp = new Painter(doc, pdf.getPage(0))
+            stamp.font = font
+            stamp.beginTemplate(new Rect([0, 0, 100, 20]))
+            stamp.setColor([0.0, 0.0, 0.0])
+            stamp.rectangle(new Rect([0, 0, 100, 20]))
+            stamp.stroke()
+            const tpl = stamp.endTemplate()
+            t.assert(tpl instanceof Obj, 'endTemplate returns the template object')
+            t.equal(stamp.font.getIdentifier(), font.getIdentifier(), 'page painter keeps its state across a template')
+            t.doesNotThrow(() => {
+                stamp.drawTemplate(tpl, 10, 10)
+                stamp.drawTemplate(tpl, 10, 40, 0.5)
+            }, 'places the template on the page')
+            stamp.finishPage()
+            t.end()
+        })
+
     })
 
 })
@@ -87,6 +87,285 @@ export enum NPDFAlignment {
     Bottom
 }
 
+/**
+ * Opcodes of a drawing command buffer, see CommandRecorder. The values are shared with the native PaintOp enum.
+ */
+export enum NPDFPaintOp {
+    MoveTo,
+    LineTo,
+    CubicBezierTo,
+    QuadCurveTo,
+    Rectangle,
+    Ellipse,
+    Circle,
+    ClosePath,
+    Stroke,
+    Fill,
+    FillAndStroke,
+    EndPath,
+    Clip,
+    Save,
+    Restore,
+    SetColor,
+    SetStrokingColor,
+    SetGrey,
+    SetStrokingGrey,
+    SetColorCMYK,
+    SetStrokingColorCMYK,
+    SetStrokeWidth,
+    SetLineCapStyle,
+    SetLineJoinStyle,
+    SetMiterLimit,
+    Transform,
+    HorizontalLineTo,
+    VerticalLineTo,
+    DrawLine
+}
+
+/**
+ * @class CommandRecorder
+ * @desc Records drawing commands into a compact opcode / argument buffer that Painter.exec replays natively in a
+ *      single call. Colors are 0.0 - 1.0 and points are plain numbers, no objects are created per command.
+ */
+export interface TextRun {
+    font: Font
+    /**
+     * Defaults to the font's current size
+     */
+    size?: number
+    text: string
+}
+
+export interface TextLayoutOptions {
+    alignment?: NPDFAlignment
+    /**
+     * Stretch interword spaces to the full width, the last line of a paragraph keeps the alignment
+     */
+    justify?: boolean
+    /**
+     * greedy fills each line in turn, optimal minimizes the raggedness of the whole paragraph (Knuth-Plass)
+     */
+    breaking?: 'greedy' | 'optimal'
+    kerning?: boolean
+    /**
+     * Multiple of the largest font size on a line, default 1.2
+     */
+    lineHeight?: number
+    collapseSpaces?: boolean
+    hyphenPenalty?: number
+    /**
+     * Hyphenation hook, splits a word into the parts it may be broken between. The parts are joined with soft
+     * hyphens (U+00AD) before layout.
+     */
+    hyphenate?: (word: string) => Array<string>
+}
+
+export interface LayoutSegment {
+    run: number
+    x: number
+    width: number
+    text: string
+}
+
+export interface LayoutLine {
+    top: number
+    baseline: number
+    width: number
+    height: number
+    hyphenated: boolean
+    text: string
+    segments: Array<LayoutSegment>
+}
+
+export interface TextLayoutResult {
+    height: number
+    lines: Array<LayoutLine>
+}
+
+export interface PathOptions {
+    /**
+     * Number of points in each subpath, all points form one subpath when omitted
+     */
+    counts?: Array<number>
+    /**
+     * Affine matrix [a, b, c, d, e, f] applied to the points before simplifying
+     */
+    transform?: [number, number, number, number, number, number]
+    /**
+     * Douglas-Peucker tolerance in page units, 0 draws every point
+     */
+    tolerance?: number
+    close?: boolean
+    operation?: 'stroke' | 'fill' | 'fillAndStroke' | 'clip' | 'none'
+}
+
+export class CommandRecorder {
+    private _ops: Uint8Array
+    private _args: Float64Array
+    private _opCount: number = 0
+    private _argCount: number = 0
+
+    /**
+     * @param {number} capacity - initial number of commands, the buffers grow as needed
+     */
+    constructor(capacity: number = 1024) {
+        this._ops = new Uint8Array(Math.max(16, capacity))
+        this._args = new Float64Array(Math.max(16, capacity) * 2)
+    }
+
+    get opcodes(): Uint8Array {
+        return this._ops.subarray(0, this._opCount)
+    }
+
+    get args(): Float64Array {
+        return this._args.subarray(0, this._argCount)
+    }
+
+    get length(): number {
+        return this._opCount
+    }
+
+    reset(): this {
+        this._opCount = 0
+        this._argCount = 0
+        return this
+    }
+
+    moveTo(x: number, y: number): this {
+        return this.push(NPDFPaintOp.MoveTo, x, y)
+    }
+
+    lineTo(x: number, y: number): this {
+        return this.push(NPDFPaintOp.LineTo, x, y)
+    }
+
+    cubicBezierTo(x1: number, y1: number, x2: number, y2: number, x3: number, y3: number): this {
+        return this.push(NPDFPaintOp.CubicBezierTo, x1, y1, x2, y2, x3, y3)
+    }
+
+    quadCurveTo(x1: number, y1: number, x3: number, y3: number): this {
+        return this.push(NPDFPaintOp.QuadCurveTo, x1, y1, x3, y3)
+    }
+
+    rectangle(x: number, y: number, width: number, height: number): this {
+        return this.push(NPDFPaintOp.Rectangle, x, y, width, height)
+    }
+
+    ellipse(x: number, y: number, width: number, height: number): this {
+        return this.push(NPDFPaintOp.Ellipse, x, y, width, height)
+    }
+
+    circle(x: number, y: number, radius: number): this {
+        return this.push(NPDFPaintOp.Circle, x, y, radius)
+    }
+
+    closePath(): this {
+        return this.push(NPDFPaintOp.ClosePath)
+    }
+
+    stroke(): this {
+        return this.push(NPDFPaintOp.Stroke)
+    }
+
+    fill(): this {
+        return this.push(NPDFPaintOp.Fill)
+    }
+
+    fillAndStroke(): this {
+        return this.push(NPDFPaintOp.FillAndStroke)
+    }
+
+    endPath(): this {
+        return this.push(NPDFPaintOp.EndPath)
+    }
+
+    clip(): this {
+        return this.push(NPDFPaintOp.Clip)
+    }
+
+    save(): this {
+        return this.push(NPDFPaintOp.Save)
+    }
+
+    restore(): this {
+        return this.push(NPDFPaintOp.Restore)
+    }
+
+    setColor(rgb: NPDFrgb): this {
+        return this.push(NPDFPaintOp.SetColor, rgb[0], rgb[1], rgb[2])
+    }
+
+    setStrokingColor(rgb: NPDFrgb): this {
+        return this.push(NPDFPaintOp.SetStrokingColor, rgb[0], rgb[1], rgb[2])
+    }
+
+    setGrey(v: number): this {
+        return this.push(NPDFPaintOp.SetGrey, v)
+    }
+
+    setStrokingGrey(v: number): this {
+        return this.push(NPDFPaintOp.SetStrokingGrey, v)
+    }
+
+    setColorCMYK(cmyk: NPDFcmyk): this {
+        return this.push(NPDFPaintOp.SetColorCMYK, cmyk[0], cmyk[1], cmyk[2], cmyk[3])
+    }
+
+    setStrokingColorCMYK(cmyk: NPDFcmyk): this {
+        return this.push(NPDFPaintOp.SetStrokingColorCMYK, cmyk[0], cmyk[1], cmyk[2], cmyk[3])
+    }
+
+    setStrokeWidth(w: number): this {
+        return this.push(NPDFPaintOp.SetStrokeWidth, w)
+    }
+
+    setLineCapStyle(style: NPDFLineCapStyle): this {
+        return this.push(NPDFPaintOp.SetLineCapStyle, style)
+    }
+
+    setLineJoinStyle(style: NPDFLineJoinStyle): this {
+        return this.push(NPDFPaintOp.SetLineJoinStyle, style)
+    }
+
+    setMiterLimit(v: number): this {
+        return this.push(NPDFPaintOp.SetMiterLimit, v)
+    }
+
+    transform(a: number, b: number, c: number, d: number, e: number, f: number): this {
+        return this.push(NPDFPaintOp.Transform, a, b, c, d, e, f)
+    }
+
+    horizontalLineTo(x: number): this {
+        return this.push(NPDFPaintOp.HorizontalLineTo, x)
+    }
+
+    verticalLineTo(y: number): this {
+        return this.push(NPDFPaintOp.VerticalLineTo, y)
+    }
+
+    drawLine(x1: number, y1: number, x2: number, y2: number): this {
+        return this.push(NPDFPaintOp.DrawLine, x1, y1, x2, y2)
+    }
+
+    protected push(op: NPDFPaintOp, ...args: Array<number>): this {
+        if (this._opCount === this._ops.length) {
+            const ops = new Uint8Array(this._ops.length * 2)
+            ops.set(this._ops)
+            this._ops = ops
+        }
+        if (this._argCount + args.length > this._args.length) {
+            const grown = new Float64Array(Math.max(this._args.length * 2, this._argCount + args.length))
+            grown.set(this._args)
+            this._args = grown
+        }
+        this._ops[this._opCount++] = op
+        for (let i = 0; i < args.length; i++) {
+            this._args[this._argCount++] = args[i]
+        }
+        return this
+    }
+}
+
 export class Painter {
     private _instance: any
 
@@ -119,6 +398,30 @@ export class Painter {
         this._instance.font = (font as any)._instance
     }
 
+    /**
+     * When enabled, exec and drawPath serialize commands natively into a buffer that is written to the page on
+     * flush, finishPage or before the next call of any other drawing method, so the drawing order is kept.
+     */
+    get fastMode(): boolean {
+        return this._instance.fastMode
+    }
+
+    set fastMode(value: boolean) {
+        this._instance.fastMode = value
+    }
+
+    /**
+     * Shape the text of drawText, drawTextAligned and addText: kerning, ligatures, Arabic joining and right to left
+     * reordering. Shaped runs are cached per font and text.
+     */
+    get shaping(): boolean | ShapeOptions {
+        return this._instance.shaping
+    }
+
+    set shaping(value: boolean | ShapeOptions) {
+        this._instance.shaping = value
+    }
+
     get precision():number {
         return this._instance.precision
     }
@@ -127,8 +430,8 @@ export class Painter {
         this._instance.precision = value
     }
 
-    constructor(doc:Document, page?: IPage) {
-        this._instance = new __mod.Painter((doc as any)._instance)
+    constructor(private _doc: Document, page?: IPage) {
+        this._instance = new __mod.Painter((_doc as any)._instance)
         if (page)
             this._instance.page = (page as any)._instance
     }
@@ -284,7 +587,7 @@ export class Painter {
         this._instance.drawText(point, text)
     }
 
-    drawTextAligned(point:NPDFPoint, text:string, alignment:NPDFAlignment): void {
+    drawTextAligned(point:NPDFPoint & {width:number}, text:string, alignment:NPDFAlignment): void {
         this._instance.drawTextAligned(point, text, alignment)
     }
 
@@ -292,6 +595,56 @@ export class Painter {
         return this._instance.getMultiLineText(width, text, skipSpaces)
     }
 
+    drawMultiLineText(rect: Rect,
+                      text: string,
+                      alignment: NPDFAlignment = NPDFAlignment.Left,
+                      verticalAlignment: NPDFVerticalAlignment = NPDFVerticalAlignment.Top,
+                      clip: boolean = true,
+                      skipSpaces: boolean = true): void {
+        this._instance.drawMultiLineText((rect as any)._instance, text, alignment, verticalAlignment, clip, skipSpaces)
+    }
+
+    /**
+     * @desc Same as drawMultiLineText, the layout and drawing run on a worker thread. The painter can not be used
+     *      until the promise settles.
+     */
+    drawMultiLineTextAsync(rect: Rect,
+                           text: string,
+                           alignment: NPDFAlignment = NPDFAlignment.Left,
+                           verticalAlignment: NPDFVerticalAlignment = NPDFVerticalAlignment.Top,
+                           clip: boolean = true,
+                           skipSpaces: boolean = true): Promise<void> {
+        return new Promise((resolve, reject) => {
+            this._instance.drawMultiLineTextAsync((rect as any)._instance, text, alignment, verticalAlignment, clip,
+                skipSpaces, (e: Error) => e ? reject(e) : resolve())
+        })
+    }
+
+    /**
+     * @desc Break the runs into lines of the given width without drawing them. Line positions are measured from the
+     * top of the layout downwards.
+     */
+    layoutText(runs: Array<TextRun>, width: number, opts: TextLayoutOptions = {}): TextLayoutResult {
+        return this._instance.layoutText(Painter.nativeRuns(runs, opts), width, opts)
+    }
+
+    /**
+     * @desc Lay out and draw the runs in one call, point is the top left corner of the layout
+     */
+    drawTextLayout(runs: Array<TextRun>, point: NPDFPoint, width: number, opts: TextLayoutOptions = {}): TextLayoutResult {
+        return this._instance.drawTextLayout(Painter.nativeRuns(runs, opts), point, width, opts)
+    }
+
+    private static nativeRuns(runs: Array<TextRun>, opts: TextLayoutOptions): Array<any> {
+        return runs.map(run => ({
+            font: (run.font as any)._instance,
+            size: run.size,
+            text: opts.hyphenate ?
+                run.text.replace(/[^\s\u00AD]+/g, word => opts.hyphenate!(word).join('\u00AD')) :
+                run.text
+        }))
+    }
+
     bt(point:NPDFPoint): void {
         this._instance.beginText(point)
     }
@@ -329,6 +682,79 @@ export class Painter {
             this._instance.drawImage((img as any)._instance, x, y)
     }
 
+    /**
+     * @desc Draw an image from a worker thread. A file path or Buffer is loaded (also off the main thread) before it
+     *      is drawn. The painter can not be used until the promise settles.
+     */
+    drawImageAsync(img: Image | string | Buffer, x: number, y: number, scale?: { width: number, height: number }): Promise<void> {
+        let loaded: Promise<Image>
+        if (img instanceof Image) {
+            loaded = Promise.resolve(img)
+        } else {
+            const image = new Image(this._doc)
+            loaded = image.load(img).then(() => image)
+        }
+        return loaded.then(image => new Promise<void>((resolve, reject) => {
+            const cb = (e: Error) => e ? reject(e) : resolve()
+            scale ?
+                this._instance.drawImageAsync((image as any)._instance, x, y, scale.width, scale.height, cb) :
+                this._instance.drawImageAsync((image as any)._instance, x, y, cb)
+        }))
+    }
+
+    /**
+     * @desc Replay a recorded command buffer in a single native call
+     * @param {CommandRecorder | {opcodes: Uint8Array, args: Float64Array}} commands
+     */
+    exec(commands: CommandRecorder | { opcodes: Uint8Array, args: Float64Array }): void {
+        this._instance.exec(commands.opcodes, commands.args)
+    }
+
+    /**
+     * @desc Transform, simplify and draw a polyline of interleaved x, y points in a single native call
+     * @returns {number} the number of points drawn after simplification
+     */
+    drawPath(points: Float64Array, opts: PathOptions = {}): number {
+        return this._instance.drawPath(points, opts)
+    }
+
+    /**
+     * @desc Start recording a reusable template, drawing goes into a Form XObject until endTemplate is called
+     * @param {Rect} bbox - bounding box of the template in its own coordinate space
+     */
+    beginTemplate(bbox: Rect): void {
+        if (!(bbox instanceof Rect)) {
+            throw TypeError('beginTemplate requires argument type Rect')
+        }
+        this._instance.beginTemplate((bbox as any)._instance)
+    }
+
+    /**
+     * @desc Finish the template and return to the page that was being painted
+     * @returns {Obj} - the template, place it with drawTemplate
+     */
+    endTemplate(): Obj {
+        return new Obj(this._instance.endTemplate())
+    }
+
+    /**
+     * @desc Place a template with a single Do operator
+     * @param {Obj} tpl - a template returned by endTemplate
+     * @param {number} x
+     * @param {number} y
+     * @param {number} scale
+     */
+    drawTemplate(tpl: Obj, x: number, y: number, scale: number = 1): void {
+        this._instance.drawTemplate((tpl as any)._instance, x, y, scale)
+    }
+
+    /**
+     * @desc Write the output buffered in fast mode to the page
+     */
+    flush(): void {
+        this._instance.flush()
+    }
+
 }
 
 export interface FontMetrics {
@@ -347,6 +773,32 @@ export interface FontMetrics {
     fontType?: string
 }
 
+export interface ShapeOptions {
+    kerning?: boolean,
+    ligatures?: boolean,
+    direction?: 'auto' | 'ltr' | 'rtl'
+}
+
+export interface ShapedText {
+    /**
+     * text in visual order after substitutions
+     */
+    text: string,
+    /**
+     * TJ adjustment after each glyph, thousandths of an em
+     */
+    adjustments: Float64Array,
+    width: number,
+    rtl: boolean
+}
+
+export interface MeasureOptions {
+    size?: number,
+    // percentage of the font size, as charSpace on Font
+    charSpace?: number,
+    wordSpace?: number
+}
+
 export class Font {
     public get size() {
         return this._instance.size
@@ -407,6 +859,14 @@ export class Font {
         return this._instance.isItalic()
     }
 
+    /**
+     * @desc True when only the glyphs used are embedded, the subset is written with the document
+     * @returns {boolean}
+     */
+    isSubsetting(): boolean {
+        return this._instance.isSubsetting()
+    }
+
     getIdentifier(): string {
         return this._instance.getIdentifier()
     }
@@ -424,6 +884,26 @@ export class Font {
         return this._instance.stringWidth(v)
     }
 
+    /**
+     * @desc Measure many strings in one call, defaults to the font's current size and spacing
+     * @param {Array<string>} strings
+     * @param {MeasureOptions} opts
+     * @returns {Float64Array} - the width of each string
+     */
+    measure(strings: Array<string>, opts: MeasureOptions = {}): Float64Array {
+        return this._instance.measure(strings, opts)
+    }
+
+    /**
+     * @desc Shape a line of text the way painter.shaping draws it
+     * @param {string} text
+     * @param {ShapeOptions} opts
+     * @returns {ShapedText}
+     */
+    shape(text: string, opts: ShapeOptions = {}): ShapedText {
+        return this._instance.shape(text, opts)
+    }
+
     write(content: string, stream: Stream): void {
         this._instance.write(content, (stream as any)._instance)
     }
@@ -441,12 +921,23 @@ export class Encoding {
         this._instance.addToDictionary(target)
     }
 
-    convertToUnicode(content: string, font: Font): string {
-        return this._instance.convertToUnicode(content, (font as any)._instance)
+    /**
+     * @desc Decode encoded bytes, arrays are converted in one call. The font is only required for encodings that
+     * are not single byte (WinAnsi, MacRoman, Standard, PdfDoc, ...).
+     */
+    convertToUnicode(content: Buffer | string, font?: Font): string
+    convertToUnicode(content: Array<Buffer | string>, font?: Font): Array<string>
+    convertToUnicode(content: Buffer | string | Array<Buffer | string>, font?: Font): string | Array<string> {
+        return this._instance.convertToUnicode(content, font ? (font as any)._instance : undefined)
     }
 
-    convertToEncoding(content: string, font: Font): Buffer {
-        return this._instance.convertToEncoding(content, (font as any)._instance)
+    /**
+     * @desc Encode text, characters the encoding can not represent are left out. Arrays are converted in one call.
+     */
+    convertToEncoding(content: string, font?: Font): Buffer
+    convertToEncoding(content: Array<string>, font?: Font): Array<Buffer>
+    convertToEncoding(content: string | Array<string>, font?: Font): Buffer | Array<Buffer> {
+        return this._instance.convertToEncoding(content, font ? (font as any)._instance : undefined)
     }
 }
 
@@ -19,6 +19,7 @@
 import {__mod, Document} from "./document";
 import {Font, NPDFAlignment, NPDFColor, NPDFPoint, NPDFVerticalAlignment, Painter} from "./painter";
 import {Page} from "./page";
+import {Rect} from "./rect";
 
 export class Cell {
     /**
@@ -61,7 +62,7 @@ export class Cell {
     constructor(private _table: Table, private _col: number, private _row: number) {
     }
 
-    getImage(): Buffer {
+    getImage(): Buffer | null {
         return (this._table as any)._instance.getImage(this._col, this._row)
     }
 
@@ -70,11 +71,67 @@ export class Cell {
     }
 
     hasBackgroundColor(): boolean {
-        return (this._table as any)._instance.hasBackgroundColor()
+        return (this._table as any)._instance.hasBackgroundColor(this._col, this._row)
     }
 
 }
 
+/**
+ * Per cell styles for Table.setData. Every array holds one value per cell in row major order (row * columns + col).
+ */
+export interface CellStyles {
+    /**
+     * fonts referenced by font
+     */
+    fonts?: Array<Font>,
+    /**
+     * 0 for the table font, n for fonts[n - 1]
+     */
+    font?: ArrayLike<number>,
+    /**
+     * packed 0xRRGGBB colours, 0xFFFFFFFF keeps the table colour
+     */
+    foreground?: ArrayLike<number>,
+    background?: ArrayLike<number>,
+    border?: ArrayLike<number>,
+    /**
+     * NPDFAlignment per cell, -1 keeps the table alignment
+     */
+    alignment?: ArrayLike<number>,
+    /**
+     * NPDFVerticalAlignment per cell, -1 keeps the table alignment
+     */
+    verticalAlignment?: ArrayLike<number>,
+    /**
+     * 1 wraps, 0 does not, -1 keeps the table setting
+     */
+    wordWrap?: ArrayLike<number>
+}
+
+export interface TableLayout {
+    /**
+     * column widths
+     */
+    widths: Float64Array,
+    /**
+     * row heights the table is drawn with
+     */
+    heights: Float64Array,
+    /**
+     * height the wrapped text of each row needs
+     */
+    contentHeights: Float64Array,
+    /**
+     * indices of the rows starting a new page
+     */
+    pageBreaks: Array<number>,
+    /**
+     * total height of all rows
+     */
+    height: number,
+    pages: number
+}
+
 export class Table {
     private _instance: any
     private _position: NPDFPoint = {x:0, y:0}
@@ -183,6 +240,27 @@ export class Table {
         this._instance.enableBackground = v
     }
 
+    /**
+     * Set the text and optionally the style of many cells in one call. Rows are given as rows[row][col], or as
+     * {columns} indexed columns[col][row]. Missing, null and undefined entries leave the cell unchanged.
+     */
+    setData(data: Array<Array<string>> | { columns: Array<Array<string>> }, styles: CellStyles = {}): void {
+        const columnMajor = !Array.isArray(data)
+        this._instance.setData(
+            columnMajor ? (data as { columns: Array<Array<string>> }).columns : data,
+            columnMajor,
+            {
+                fonts: styles.fonts ? styles.fonts.map(f => (f as any)._instance) : undefined,
+                font: styles.font ? Uint16Array.from(styles.font) : undefined,
+                foreground: styles.foreground ? Uint32Array.from(styles.foreground) : undefined,
+                background: styles.background ? Uint32Array.from(styles.background) : undefined,
+                border: styles.border ? Uint32Array.from(styles.border) : undefined,
+                alignment: styles.alignment ? Int8Array.from(styles.alignment) : undefined,
+                verticalAlignment: styles.verticalAlignment ? Int8Array.from(styles.verticalAlignment) : undefined,
+                wordWrap: styles.wordWrap ? Int8Array.from(styles.wordWrap) : undefined
+            })
+    }
+
     // table methods
     draw(point: NPDFPoint, painter: Painter): void {
         if (painter instanceof Painter === false) {
@@ -191,6 +269,27 @@ export class Table {
         this._instance.draw(point, (painter as any)._instance)
     }
 
+    /**
+     * Lay out and draw the table on a worker thread, the painter can not be used until the promise settles.
+     */
+    drawAsync(point: NPDFPoint, painter: Painter): Promise<void> {
+        if (painter instanceof Painter === false) {
+            return Promise.reject(Error('painter must be an instance of NoPoDoFo Painter'))
+        }
+        return new Promise((resolve, reject) => {
+            this._instance.drawAsync(point, (painter as any)._instance, (e: Error) => e ? reject(e) : resolve())
+        })
+    }
+
+    /**
+     * Measure the table as draw would place it, without drawing anything. Rows start at point (the top left corner,
+     * the top left of area by default) and continue at the top of area on each new page when autoPageBreak is set.
+     */
+    layout(area: Rect, point?: NPDFPoint): TableLayout {
+        const p = point || {x: area.left, y: area.bottom + area.height}
+        return this._instance.layout((area as any)._instance, p.x, p.y)
+    }
+
     columnCount(): number {
         return this._instance.columnCount()
     }
@@ -200,18 +299,100 @@ export class Table {
     }
 
     columnWidth(v: number): void {
-        this._instance.columnWidth(v)
+        this._instance.setColumnWidth(v)
     }
 
     columnWidths(v: Array<number>): void {
-        this._instance.columnWidths(v)
+        this._instance.setColumnWidths(v)
     }
 
     rowHeight(v: number): void {
-        this._instance.rowHeight(v)
+        this._instance.setRowHeight(v)
     }
 
     rowHeights(v: Array<number>): void {
-        this._instance.rowHeights(v)
+        this._instance.setRowHeights(v)
+    }
+}
+
+export interface TableWriterOptions {
+    /**
+     * column widths in points
+     */
+    columns: Array<number>,
+    font: Font,
+    /**
+     * font size, the font's current size by default
+     */
+    size?: number,
+    /**
+     * rows repeated at the top of every page
+     */
+    header?: Array<Array<string>>,
+    /**
+     * size of the pages created for the table, the first page's size or A4 by default
+     */
+    pageSize?: Rect,
+    /**
+     * area of each page filled by the table, the page less a 36 point margin by default
+     */
+    area?: Rect,
+    /**
+     * existing page the table starts on, otherwise every page is created
+     */
+    firstPage?: Page,
+    padding?: number,
+    /**
+     * 0 draws no cell borders
+     */
+    borderWidth?: number,
+    /**
+     * line height as a multiple of the font size
+     */
+    lineHeight?: number
+}
+
+/**
+ * Streams rows into a table spanning as many pages as needed. Each page is drawn as soon as it is full and its rows
+ * are released, memory use depends on the page size and not on the number of rows.
+ */
+export class TableWriter {
+    private _instance: any
+
+    get pageCount(): number {
+        return this._instance.pageCount
+    }
+
+    /**
+     * rows waiting for the current page to fill up
+     */
+    get pendingRows(): number {
+        return this._instance.pendingRows
+    }
+
+    constructor(doc: Document, opts: TableWriterOptions) {
+        this._instance = new __mod.TableWriter((doc as any)._instance, {
+            ...opts,
+            font: (opts.font as any)._instance,
+            pageSize: opts.pageSize ? (opts.pageSize as any)._instance : undefined,
+            area: opts.area ? (opts.area as any)._instance : undefined,
+            firstPage: opts.firstPage ? (opts.firstPage as any)._instance : undefined
+        })
+    }
+
+    /**
+     * Lay out and append rows, pages filled by them are drawn right away
+     * @returns {number} the number of pages drawn
+     */
+    addRows(rows: Array<Array<string>>): number {
+        return this._instance.addRows(rows)
+    }
+
+    /**
+     * Draw the last page, no rows can be added afterwards
+     * @returns {number} the total number of pages the table spans
+     */
+    close(): number {
+        return this._instance.close()
     }
 }
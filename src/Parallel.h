@@ -0,0 +1,79 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NPDF_PARALLEL_H
+#define NPDF_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <vector>
+
+/**
+ * Runs fn(0) ... fn(count - 1) across the available hardware threads. Work is
+ * handed out one index at a time so uneven pages do not stall a thread. The
+ * first exception thrown by fn is rethrown on the calling thread once every
+ * thread has joined.
+ */
+static void
+ParallelFor(size_t count, const std::function<void(size_t)>& fn)
+{
+  if (count == 0) {
+    return;
+  }
+  size_t threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+  threads = std::min(threads, count);
+  if (threads == 1) {
+    for (size_t i = 0; i < count; ++i) {
+      fn(i);
+    }
+    return;
+  }
+  std::atomic<size_t> next(0);
+  std::exception_ptr failure = nullptr;
+  std::atomic<bool> failed(false);
+  auto work = [&]() {
+    size_t i;
+    while (!failed && (i = next++) < count) {
+      try {
+        fn(i);
+      } catch (...) {
+        bool expected = false;
+        if (failed.compare_exchange_strong(expected, true)) {
+          failure = std::current_exception();
+        }
+      }
+    }
+  };
+  std::vector<std::thread> pool;
+  pool.reserve(threads - 1);
+  for (size_t t = 1; t < threads; ++t) {
+    pool.emplace_back(work);
+  }
+  work();
+  for (auto& t : pool) {
+    t.join();
+  }
+  if (failure) {
+    std::rethrow_exception(failure);
+  }
+}
+
+#endif // NPDF_PARALLEL_H
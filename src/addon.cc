@@ -43,6 +43,7 @@
 #include "doc/Signer.h"
 #include "doc/TextField.h"
 #include "doc/SimpleTable.h"
+#include "doc/TableWriter.h"
 #include "doc/ListBox.h"
 #include <napi.h>
 
@@ -78,6 +79,7 @@ init(Napi::Env env, Napi::Object exports)
   NoPoDoFo::Data::Initialize(env, exports);
   NoPoDoFo::ContentsTokenizer::Initialize(env, exports);
   NoPoDoFo::SimpleTable::Initialize(env, exports);
+  NoPoDoFo::TableWriter::Initialize(env, exports);
 
   exports["signature"] = Function::New(env, NPDFSignatureData);
 
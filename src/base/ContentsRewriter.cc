@@ -0,0 +1,167 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ContentsRewriter.h"
+#include <iomanip>
+#include <locale>
+#include <sstream>
+
+namespace NoPoDoFo {
+
+using namespace PoDoFo;
+
+using std::string;
+using std::vector;
+
+void
+ContentsSerializer::Operand(const PdfVariant& var)
+{
+  scratch.clear();
+  var.ToString(scratch, ePdfWriteMode_Compact);
+  data.append(scratch);
+  data.push_back(' ');
+}
+
+void
+ContentsSerializer::Operator(const string& op)
+{
+  data.append(op);
+  data.push_back('\n');
+}
+
+ContentsRewriter::ContentsRewriter(string contents)
+  : contents(std::move(contents))
+{}
+
+void
+ContentsRewriter::AddFilter(std::shared_ptr<ContentsFilter> filter)
+{
+  filters.push_back(std::move(filter));
+}
+
+string
+ContentsRewriter::Run()
+{
+  ContentsSerializer out;
+  ContentsState state;
+  for (auto& filter : filters) {
+    filter->Begin(out);
+  }
+  if (!contents.empty()) {
+    PdfContentsTokenizer tokenizer(contents.data(),
+                                   static_cast<long>(contents.size()));
+    EPdfContentsType type;
+    const char* keyword = nullptr;
+    PdfVariant var;
+    vector<PdfVariant> operands;
+    bool dropInline = false;
+    bool pendingEI = false;
+    while (tokenizer.ReadNext(type, keyword, var)) {
+      if (type == ePdfContentsType_Variant) {
+        operands.push_back(var);
+        continue;
+      }
+      if (type == ePdfContentsType_ImageData) {
+        // inline image data runs up to and including the EI operator
+        if (!dropInline) {
+          string raw;
+          var.ToString(raw, ePdfWriteMode_Compact);
+          out.Raw(raw);
+          out.Raw("\nEI\n");
+        }
+        pendingEI = true;
+        dropInline = false;
+        operands.clear();
+        continue;
+      }
+      string op(keyword);
+      if (pendingEI && op == "EI") {
+        pendingEI = false;
+        operands.clear();
+        continue;
+      }
+      pendingEI = false;
+      if (dropInline) {
+        operands.clear();
+        continue;
+      }
+      bool keep = true;
+      for (auto& filter : filters) {
+        if (!filter->Visit(op, operands, state, out)) {
+          keep = false;
+          break;
+        }
+      }
+      if (keep) {
+        for (auto& operand : operands) {
+          out.Operand(operand);
+        }
+        out.Operator(op);
+      } else if (op == "BI") {
+        dropInline = true;
+      }
+      state.Apply(op, operands);
+      operands.clear();
+    }
+  }
+  for (auto it = filters.rbegin(); it != filters.rend(); ++it) {
+    (*it)->End(out);
+  }
+  return std::move(out.GetData());
+}
+
+bool
+OperatorFilter::Visit(const string& op,
+                      vector<PdfVariant>&,
+                      const ContentsState&,
+                      ContentsSerializer&)
+{
+  return names.find(op) == names.end();
+}
+
+bool
+XObjectFilter::Visit(const string& op,
+                     vector<PdfVariant>& operands,
+                     const ContentsState&,
+                     ContentsSerializer&)
+{
+  if (op != "Do" || operands.empty() || !operands.back().IsName()) {
+    return true;
+  }
+  return names.find(operands.back().GetName().GetName()) == names.end();
+}
+
+void
+ClipFilter::Begin(ContentsSerializer& out)
+{
+  // PDF numbers have no exponent form
+  std::ostringstream clipping;
+  clipping.imbue(std::locale::classic());
+  clipping << std::fixed << std::setprecision(3) << "q\n"
+           << clip.left << " " << clip.bottom << " " << clip.right - clip.left
+           << " " << clip.top - clip.bottom << " re\nW\nn\n";
+  out.Raw(clipping.str());
+}
+
+void
+ClipFilter::End(ContentsSerializer& out)
+{
+  out.Raw("Q\n");
+}
+}
@@ -0,0 +1,142 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NPDF_CONTENTSREWRITER_H
+#define NPDF_CONTENTSREWRITER_H
+
+#include "ContentsState.h"
+#include <memory>
+#include <podofo/podofo.h>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace NoPoDoFo {
+
+/**
+ * Writes operands and operators back into content stream syntax
+ */
+class ContentsSerializer
+{
+public:
+  ContentsSerializer() { data.reserve(1 << 16); }
+  void Operand(const PoDoFo::PdfVariant&);
+  void Operator(const std::string&);
+  void Raw(const std::string& value) { data.append(value); }
+  std::string& GetData() { return data; }
+
+private:
+  std::string data;
+  std::string scratch;
+};
+
+/**
+ * A stage of the rewrite pipeline. Visit is called once per operator with the
+ * operands preceding it and the state as of before the operator; returning
+ * false drops the operator along with its operands. Operands may be modified
+ * in place and additional content may be written through the serializer.
+ */
+class ContentsFilter
+{
+public:
+  virtual ~ContentsFilter() = default;
+  virtual void Begin(ContentsSerializer&) {}
+  virtual bool Visit(const std::string& op,
+                     std::vector<PoDoFo::PdfVariant>& operands,
+                     const ContentsState& state,
+                     ContentsSerializer& out) = 0;
+  virtual void End(ContentsSerializer&) {}
+};
+
+/**
+ * Streams a content stream through a chain of filters and back out in a single
+ * pass, nothing beyond the current operator is kept in memory. Only works on
+ * the bytes handed to it so any number of rewriters can run concurrently.
+ */
+class ContentsRewriter
+{
+public:
+  explicit ContentsRewriter(std::string contents);
+  void AddFilter(std::shared_ptr<ContentsFilter> filter);
+  std::string Run();
+
+private:
+  std::string contents;
+  std::vector<std::shared_ptr<ContentsFilter>> filters;
+};
+
+/**
+ * Drops every operator with a name in the set
+ */
+class OperatorFilter : public ContentsFilter
+{
+public:
+  explicit OperatorFilter(std::set<std::string> names)
+    : names(std::move(names))
+  {}
+  bool Visit(const std::string&,
+             std::vector<PoDoFo::PdfVariant>&,
+             const ContentsState&,
+             ContentsSerializer&) override;
+
+private:
+  std::set<std::string> names;
+};
+
+/**
+ * Drops Do operators painting an XObject with a resource name in the set
+ */
+class XObjectFilter : public ContentsFilter
+{
+public:
+  explicit XObjectFilter(std::set<std::string> names)
+    : names(std::move(names))
+  {}
+  bool Visit(const std::string&,
+             std::vector<PoDoFo::PdfVariant>&,
+             const ContentsState&,
+             ContentsSerializer&) override;
+
+private:
+  std::set<std::string> names;
+};
+
+/**
+ * Clips all page content to a rectangle
+ */
+class ClipFilter : public ContentsFilter
+{
+public:
+  explicit ClipFilter(const Box& clip)
+    : clip(clip)
+  {}
+  void Begin(ContentsSerializer&) override;
+  bool Visit(const std::string&,
+             std::vector<PoDoFo::PdfVariant>&,
+             const ContentsState&,
+             ContentsSerializer&) override
+  {
+    return true;
+  }
+  void End(ContentsSerializer&) override;
+
+private:
+  Box clip;
+};
+}
+#endif // NPDF_CONTENTSREWRITER_H
@@ -0,0 +1,337 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ContentsState.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+namespace NoPoDoFo {
+
+using namespace PoDoFo;
+
+using std::map;
+using std::string;
+using std::vector;
+
+Matrix
+Matrix::Multiply(const Matrix& o) const
+{
+  return Matrix(a * o.a + b * o.c,
+                a * o.b + b * o.d,
+                c * o.a + d * o.c,
+                c * o.b + d * o.d,
+                e * o.a + f * o.c + o.e,
+                e * o.b + f * o.d + o.f);
+}
+
+void
+Matrix::Transform(double x, double y, double& outX, double& outY) const
+{
+  outX = a * x + c * y + e;
+  outY = b * x + d * y + f;
+}
+
+bool
+Matrix::Invert(Matrix& out) const
+{
+  const double det = a * d - b * c;
+  if (std::fabs(det) < 1e-12) {
+    return false;
+  }
+  out.a = d / det;
+  out.b = -b / det;
+  out.c = -c / det;
+  out.d = a / det;
+  out.e = (c * f - d * e) / det;
+  out.f = (b * e - a * f) / det;
+  return true;
+}
+
+Box
+Box::Transformed(const Matrix& m, double x0, double y0, double x1, double y1)
+{
+  double xs[4], ys[4];
+  m.Transform(x0, y0, xs[0], ys[0]);
+  m.Transform(x1, y0, xs[1], ys[1]);
+  m.Transform(x1, y1, xs[2], ys[2]);
+  m.Transform(x0, y1, xs[3], ys[3]);
+  Box box;
+  box.left = *std::min_element(xs, xs + 4);
+  box.right = *std::max_element(xs, xs + 4);
+  box.bottom = *std::min_element(ys, ys + 4);
+  box.top = *std::max_element(ys, ys + 4);
+  return box;
+}
+
+double
+ContentsState::ToReal(const PdfVariant& var)
+{
+  if (var.IsReal()) {
+    return var.GetReal();
+  }
+  if (var.IsNumber()) {
+    return static_cast<double>(var.GetNumber());
+  }
+  return 0.0;
+}
+
+void
+ContentsState::Apply(const string& op, const vector<PdfVariant>& operands)
+{
+  const size_t n = operands.size();
+  if (op == "q") {
+    stack.push(gs);
+  } else if (op == "Q") {
+    if (!stack.empty()) {
+      gs = stack.top();
+      stack.pop();
+    }
+  } else if (op == "cm" && n >= 6) {
+    Matrix m(ToReal(operands[n - 6]),
+             ToReal(operands[n - 5]),
+             ToReal(operands[n - 4]),
+             ToReal(operands[n - 3]),
+             ToReal(operands[n - 2]),
+             ToReal(operands[n - 1]));
+    gs.ctm = m.Multiply(gs.ctm);
+  } else if (op == "BT") {
+    inText = true;
+    tm = tlm = Matrix();
+  } else if (op == "ET") {
+    inText = false;
+  } else if (op == "Tf" && n >= 2) {
+    if (operands[n - 2].IsName()) {
+      gs.fontName = operands[n - 2].GetName().GetName();
+    }
+    gs.fontSize = ToReal(operands[n - 1]);
+  } else if (op == "Tc" && n >= 1) {
+    gs.charSpace = ToReal(operands[n - 1]);
+  } else if (op == "Tw" && n >= 1) {
+    gs.wordSpace = ToReal(operands[n - 1]);
+  } else if (op == "Tz" && n >= 1) {
+    gs.hScale = ToReal(operands[n - 1]) / 100.0;
+  } else if (op == "TL" && n >= 1) {
+    gs.leading = ToReal(operands[n - 1]);
+  } else if (op == "Ts" && n >= 1) {
+    gs.rise = ToReal(operands[n - 1]);
+  } else if ((op == "Td" || op == "TD") && n >= 2) {
+    const double tx = ToReal(operands[n - 2]);
+    const double ty = ToReal(operands[n - 1]);
+    if (op == "TD") {
+      gs.leading = -ty;
+    }
+    tlm = Matrix(1, 0, 0, 1, tx, ty).Multiply(tlm);
+    tm = tlm;
+  } else if (op == "Tm" && n >= 6) {
+    tlm = Matrix(ToReal(operands[n - 6]),
+                 ToReal(operands[n - 5]),
+                 ToReal(operands[n - 4]),
+                 ToReal(operands[n - 3]),
+                 ToReal(operands[n - 2]),
+                 ToReal(operands[n - 1]));
+    tm = tlm;
+  } else if (op == "T*" || op == "'" || op == "\"") {
+    if (op == "\"" && n >= 3) {
+      gs.wordSpace = ToReal(operands[n - 3]);
+      gs.charSpace = ToReal(operands[n - 2]);
+    }
+    tlm = Matrix(1, 0, 0, 1, 0, -gs.leading).Multiply(tlm);
+    tm = tlm;
+  }
+}
+
+Matrix
+ContentsState::TextRenderingMatrix() const
+{
+  Matrix params(gs.fontSize * gs.hScale, 0, 0, gs.fontSize, 0, gs.rise);
+  return params.Multiply(tm).Multiply(gs.ctm);
+}
+
+void
+ContentsState::Advance(double width, bool isSpace)
+{
+  const double tx =
+    (width / 1000.0 * gs.fontSize + gs.charSpace + (isSpace ? gs.wordSpace : 0)) *
+    gs.hScale;
+  tm = Matrix(1, 0, 0, 1, tx, 0).Multiply(tm);
+}
+
+void
+ContentsState::Adjust(double amount)
+{
+  const double tx = -amount / 1000.0 * gs.fontSize * gs.hScale;
+  tm = Matrix(1, 0, 0, 1, tx, 0).Multiply(tm);
+}
+
+static void
+AppendStream(PdfObject* obj, string& out)
+{
+  if (!obj || !obj->HasStream()) {
+    return;
+  }
+  char* buffer = nullptr;
+  pdf_long length = 0;
+  obj->GetStream()->GetFilteredCopy(&buffer, &length);
+  out.append(buffer, static_cast<size_t>(length));
+  out.push_back('\n');
+  podofo_free(buffer);
+}
+
+string
+ContentsState::ReadContents(PdfPage* page)
+{
+  string out;
+  PdfObject* contents = page->GetObject()->GetIndirectKey(PdfName("Contents"));
+  if (!contents) {
+    return out;
+  }
+  if (contents->IsArray()) {
+    PdfVecObjects* owner = page->GetObject()->GetOwner();
+    for (auto& item : contents->GetArray()) {
+      AppendStream(item.IsReference() ? owner->GetObject(item.GetReference())
+                                      : &item,
+                   out);
+    }
+  } else {
+    AppendStream(contents, out);
+  }
+  return out;
+}
+
+vector<PdfReference>
+ContentsState::WriteContents(PdfPage* page, const char* data, size_t length)
+{
+  vector<PdfReference> dropped;
+  PdfObject* pageObj = page->GetObject();
+  PdfVecObjects* owner = pageObj->GetOwner();
+  PdfObject* contents = pageObj->GetIndirectKey(PdfName("Contents"));
+  if (!contents) {
+    contents = owner->CreateObject();
+    pageObj->GetDictionary().AddKey(PdfName("Contents"), contents->Reference());
+  } else if (contents->IsArray()) {
+    PdfArray& array = contents->GetArray();
+    PdfObject* target = nullptr;
+    for (size_t i = 0; i < array.size(); ++i) {
+      if (!array[i].IsReference()) {
+        continue;
+      }
+      if (!target) {
+        target = owner->GetObject(array[i].GetReference());
+        if (target) {
+          continue;
+        }
+      }
+      dropped.push_back(array[i].GetReference());
+    }
+    if (!target) {
+      target = owner->CreateObject();
+    }
+    PdfReference ref = target->Reference();
+    array.clear();
+    array.push_back(ref);
+    contents = target;
+  }
+  contents->GetStream()->Set(data, static_cast<pdf_long>(length));
+  return dropped;
+}
+
+void
+ContentsState::AppendContents(PdfPage* page, const char* data, size_t length)
+{
+  PdfObject* pageObj = page->GetObject();
+  PdfVecObjects* owner = pageObj->GetOwner();
+  PdfObject* stream = owner->CreateObject();
+  string wrapped = "q\n";
+  wrapped.append(data, length);
+  wrapped.append("\nQ\n");
+  stream->GetStream()->Set(wrapped.data(),
+                           static_cast<pdf_long>(wrapped.size()));
+  PdfObject* contents = pageObj->GetDictionary().GetKey(PdfName("Contents"));
+  if (contents && contents->IsReference()) {
+    PdfObject* target = owner->GetObject(contents->GetReference());
+    if (target && target->IsArray()) {
+      target->GetArray().push_back(stream->Reference());
+      return;
+    }
+  }
+  if (contents && contents->IsArray()) {
+    contents->GetArray().push_back(stream->Reference());
+    return;
+  }
+  PdfArray array;
+  if (contents) {
+    array.push_back(*contents);
+  }
+  array.push_back(stream->Reference());
+  pageObj->GetDictionary().AddKey(PdfName("Contents"), array);
+}
+
+static void
+CountReferences(const PdfVariant& value, map<PdfReference, int>& counts)
+{
+  if (value.IsReference()) {
+    ++counts[value.GetReference()];
+  } else if (value.IsArray()) {
+    for (auto& item : value.GetArray()) {
+      CountReferences(item, counts);
+    }
+  } else if (value.IsDictionary()) {
+    for (auto& item : value.GetDictionary().GetKeys()) {
+      CountReferences(*item.second, counts);
+    }
+  }
+}
+
+void
+ContentsState::RemoveUnreferenced(PdfMemDocument* doc,
+                                  const vector<PdfReference>& refs)
+{
+  if (refs.empty()) {
+    return;
+  }
+  PdfVecObjects* owner = &doc->GetObjects();
+  map<PdfReference, int> counts;
+  for (auto obj : *owner) {
+    CountReferences(*obj, counts);
+  }
+  if (doc->GetTrailer()) {
+    CountReferences(*doc->GetTrailer(), counts);
+  }
+  vector<PdfReference> pending(refs.begin(), refs.end());
+  while (!pending.empty()) {
+    PdfReference next = pending.back();
+    pending.pop_back();
+    if (counts[next] > 0) {
+      continue;
+    }
+    PdfObject* obj = owner->RemoveObject(next);
+    if (!obj) {
+      continue;
+    }
+    map<PdfReference, int> children;
+    CountReferences(*obj, children);
+    for (auto& child : children) {
+      counts[child.first] -= child.second;
+      pending.push_back(child.first);
+    }
+    delete obj;
+  }
+}
+}
@@ -0,0 +1,128 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NPDF_CONTENTSSTATE_H
+#define NPDF_CONTENTSSTATE_H
+
+#include <podofo/podofo.h>
+#include <stack>
+#include <string>
+#include <vector>
+
+namespace NoPoDoFo {
+
+/**
+ * PDF transformation matrix [a b 0 c d 0 e f 1], applied to row vectors
+ */
+struct Matrix
+{
+  double a = 1, b = 0, c = 0, d = 1, e = 0, f = 0;
+
+  Matrix() = default;
+  Matrix(double a, double b, double c, double d, double e, double f)
+    : a(a)
+    , b(b)
+    , c(c)
+    , d(d)
+    , e(e)
+    , f(f)
+  {}
+  // this x other
+  Matrix Multiply(const Matrix& other) const;
+  void Transform(double x, double y, double& outX, double& outY) const;
+  bool Invert(Matrix& out) const;
+};
+
+/**
+ * Axis aligned box in default user space
+ */
+struct Box
+{
+  double left = 0, bottom = 0, right = 0, top = 0;
+
+  bool Intersects(const Box& other) const
+  {
+    return left < other.right && other.left < right && bottom < other.top &&
+           other.bottom < top;
+  }
+  bool Contains(double x, double y) const
+  {
+    return x >= left && x <= right && y >= bottom && y <= top;
+  }
+  // Bounding box of the unit-space rectangle (x0,y0)-(x1,y1) under m
+  static Box Transformed(const Matrix& m,
+                         double x0,
+                         double y0,
+                         double x1,
+                         double y1);
+};
+
+struct GraphicsState
+{
+  Matrix ctm;
+  std::string fontName;
+  double fontSize = 0;
+  double charSpace = 0;
+  double wordSpace = 0;
+  double hScale = 1;
+  double leading = 0;
+  double rise = 0;
+};
+
+/**
+ * Tracks the graphics and text state while walking a content stream. Callers
+ * feed each operator with its operands to Apply, text showing operators are
+ * left to the caller since they require glyph metrics, see Advance.
+ */
+class ContentsState
+{
+public:
+  GraphicsState gs;
+  Matrix tm;
+  Matrix tlm;
+  bool inText = false;
+
+  void Apply(const std::string& op,
+             const std::vector<PoDoFo::PdfVariant>& operands);
+  // Text rendering matrix for the current text position
+  Matrix TextRenderingMatrix() const;
+  // Move the text position past a glyph of width (1/1000 text space units)
+  void Advance(double width, bool isSpace);
+  // Apply a TJ array position adjustment
+  void Adjust(double amount);
+
+  static double ToReal(const PoDoFo::PdfVariant&);
+  // Concatenated, decoded content streams of a page
+  static std::string ReadContents(PoDoFo::PdfPage*);
+  // Replace the page content streams with a single stream, creating it when
+  // the page has none. Returns the streams no longer listed in /Contents.
+  static std::vector<PoDoFo::PdfReference> WriteContents(PoDoFo::PdfPage*,
+                                                         const char*,
+                                                         size_t);
+  // Add a stream wrapped in q/Q after the page content streams
+  static void AppendContents(PoDoFo::PdfPage*, const char*, size_t);
+  // Removes the objects and everything only reachable through them from the
+  // document, objects still referenced elsewhere are kept
+  static void RemoveUnreferenced(PoDoFo::PdfMemDocument*,
+                                 const std::vector<PoDoFo::PdfReference>&);
+
+private:
+  std::stack<GraphicsState> stack;
+};
+}
+#endif // NPDF_CONTENTSSTATE_H
@@ -0,0 +1,272 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ImageOptimizer.h"
+#include "../Parallel.h"
+#include "RasterImage.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace NoPoDoFo {
+
+using namespace PoDoFo;
+using std::string;
+using std::vector;
+
+// forms nested deeper than this are not followed
+static const int MaxFormDepth = 8;
+
+static PdfObject*
+Resolve(PdfObject* owner, PdfObject* obj)
+{
+  if (obj && obj->IsReference() && owner && owner->GetOwner()) {
+    return owner->GetOwner()->GetObject(obj->GetReference());
+  }
+  return obj;
+}
+
+static double
+Real(PdfObject* obj, size_t i, double fallback)
+{
+  if (obj && obj->IsArray() && obj->GetArray().size() > i) {
+    return ContentsState::ToReal(obj->GetArray()[i]);
+  }
+  return fallback;
+}
+
+// Masks tied to the exact pixel values or dimensions of the image: a colour
+// key /Mask array matches component values, which resampling, grayscale
+// conversion and lossy encoding change, and an /SMask with /Matte holds
+// premultiplied alpha that must have the dimensions of the image
+static bool
+HasPixelMask(PdfObject* xobj)
+{
+  PdfObject* mask = xobj->GetIndirectKey(PdfName("Mask"));
+  if (mask && mask->IsArray()) {
+    return true;
+  }
+  PdfObject* smask = xobj->GetIndirectKey(PdfName("SMask"));
+  return smask && smask->IsDictionary() &&
+         smask->GetDictionary().HasKey(PdfName("Matte"));
+}
+
+static bool
+HasFilter(PdfObject* xobj, const char* name)
+{
+  PdfObject* filter = xobj->GetIndirectKey(PdfName("Filter"));
+  if (filter && filter->IsName()) {
+    return filter->GetName().GetName() == name;
+  }
+  if (filter && filter->IsArray()) {
+    for (auto& item : filter->GetArray()) {
+      if (item.IsName() && item.GetName().GetName() == name) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+ImageOptimizer::ImageOptimizer(PdfMemDocument* document,
+                               const ImageOptimizerOptions& options)
+  : document(document)
+  , options(options)
+{}
+
+void
+ImageOptimizer::Place(PdfObject* xobject, const Matrix& ctm)
+{
+  auto it = placements.find(xobject->Reference());
+  if (it == placements.end()) {
+    PdfObject* w = xobject->GetIndirectKey(PdfName("Width"));
+    PdfObject* h = xobject->GetIndirectKey(PdfName("Height"));
+    if (!w || !h || !w->IsNumber() || !h->IsNumber()) {
+      return;
+    }
+    Placement placement{ xobject,
+                         static_cast<int>(w->GetNumber()),
+                         static_cast<int>(h->GetNumber()),
+                         0 };
+    it = placements.emplace(xobject->Reference(), placement).first;
+  }
+  Placement& placement = it->second;
+  // the unit square is painted, the image axes end up as (a, b) and (c, d)
+  double inchesX = std::hypot(ctm.a, ctm.b) / 72.0;
+  double inchesY = std::hypot(ctm.c, ctm.d) / 72.0;
+  if (inchesX <= 0 || inchesY <= 0) {
+    return;
+  }
+  double dpi = std::min(placement.width / inchesX, placement.height / inchesY);
+  if (placement.dpi == 0 || dpi < placement.dpi) {
+    placement.dpi = dpi;
+  }
+}
+
+void
+ImageOptimizer::Scan(PdfObject* resources,
+                     const string& contents,
+                     const Matrix& base,
+                     int depth)
+{
+  PdfObject* xobjects =
+    resources ? Resolve(resources, resources->GetIndirectKey(PdfName("XObject")))
+              : nullptr;
+  if (contents.empty() || !xobjects || !xobjects->IsDictionary()) {
+    return;
+  }
+  PdfContentsTokenizer tokenizer(contents.data(),
+                                 static_cast<long>(contents.size()));
+  EPdfContentsType type;
+  const char* keyword = nullptr;
+  PdfVariant var;
+  vector<PdfVariant> operands;
+  ContentsState state;
+  state.gs.ctm = base;
+  while (tokenizer.ReadNext(type, keyword, var)) {
+    if (type == ePdfContentsType_Variant) {
+      operands.push_back(var);
+      continue;
+    }
+    if (type != ePdfContentsType_Keyword) {
+      operands.clear();
+      continue;
+    }
+    string op(keyword);
+    state.Apply(op, operands);
+    if (op == "Do" && !operands.empty() && operands.back().IsName()) {
+      PdfObject* xobject = Resolve(
+        xobjects, xobjects->GetDictionary().GetKey(operands.back().GetName()));
+      PdfObject* subtype =
+        xobject && xobject->IsDictionary()
+          ? xobject->GetIndirectKey(PdfName("Subtype"))
+          : nullptr;
+      if (subtype && subtype->IsName()) {
+        if (subtype->GetName() == PdfName("Image")) {
+          Place(xobject, state.gs.ctm);
+        } else if (subtype->GetName() == PdfName("Form") &&
+                   depth < MaxFormDepth && xobject->HasStream()) {
+          PdfObject* m = xobject->GetIndirectKey(PdfName("Matrix"));
+          Matrix matrix(Real(m, 0, 1),
+                        Real(m, 1, 0),
+                        Real(m, 2, 0),
+                        Real(m, 3, 1),
+                        Real(m, 4, 0),
+                        Real(m, 5, 0));
+          PdfObject* formResources =
+            xobject->GetIndirectKey(PdfName("Resources"));
+          char* buffer = nullptr;
+          pdf_long length = 0;
+          xobject->GetStream()->GetFilteredCopy(&buffer, &length);
+          string form(buffer, static_cast<size_t>(length));
+          podofo_free(buffer);
+          Scan(formResources ? formResources : resources,
+               form,
+               matrix.Multiply(state.gs.ctm),
+               depth + 1);
+        }
+      }
+    }
+    operands.clear();
+  }
+}
+
+ImageOptimizerResult
+ImageOptimizer::Run()
+{
+  for (int i = 0; i < document->GetPageCount(); ++i) {
+    PdfPage* page = document->GetPage(i);
+    Scan(page->GetResources(), ContentsState::ReadContents(page), Matrix(), 0);
+  }
+
+  struct Job
+  {
+    Placement* placement;
+    bool jpeg;
+    size_t before;
+    RasterImage raster;
+    string encoded;
+  };
+  vector<Job> jobs;
+  ImageOptimizerResult result;
+  for (auto& item : placements) {
+    Placement& placement = item.second;
+    ++result.images;
+    if (placement.dpi == 0 || !RasterImage::IsDecodable(placement.xobject) ||
+        HasPixelMask(placement.xobject)) {
+      continue;
+    }
+    Job job;
+    job.placement = &placement;
+    job.jpeg = HasFilter(placement.xobject, "DCTDecode") ||
+               HasFilter(placement.xobject, "DCT");
+    job.before = static_cast<size_t>(placement.xobject->GetStream()->GetLength());
+    jobs.push_back(std::move(job));
+  }
+
+  // every job only reads its own image object, the document is not
+  // modified until all of them are done
+  ParallelFor(jobs.size(), [&](size_t i) {
+    Job& job = jobs[i];
+    RasterImage& raster = job.raster;
+    if (!raster.Load(job.placement->xobject)) {
+      return;
+    }
+    bool changed = false;
+    double scale = options.maxDpi / job.placement->dpi;
+    if (options.maxDpi > 0 && scale < 0.9) {
+      raster.Downsample(
+        std::max(1, static_cast<int>(std::lround(raster.width * scale))),
+        std::max(1, static_cast<int>(std::lround(raster.height * scale))));
+      changed = true;
+    }
+    if (options.grayscaleDetect && raster.components == 3 &&
+        raster.IsGray(2)) {
+      raster.ToGray();
+      changed = true;
+    }
+    if (!changed) {
+      return;
+    }
+#ifdef NPDF_HAVE_JPEG
+    if (job.jpeg && options.jpegQuality > 0) {
+      job.encoded = raster.EncodeJpeg(options.jpegQuality);
+    }
+#endif
+    if (job.encoded.empty()) {
+      job.jpeg = false;
+      job.encoded = raster.EncodeFlate();
+    }
+  });
+
+  for (auto& job : jobs) {
+    result.bytesBefore += job.before;
+    if (job.encoded.empty() || job.encoded.size() >= job.before) {
+      result.bytesAfter += job.before;
+      continue;
+    }
+    job.raster.StoreEncoded(job.placement->xobject,
+                            job.encoded,
+                            job.jpeg ? "DCTDecode" : "FlateDecode");
+    result.bytesAfter += job.encoded.size();
+    ++result.optimized;
+  }
+  return result;
+}
+}
@@ -0,0 +1,85 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NPDF_IMAGEOPTIMIZER_H
+#define NPDF_IMAGEOPTIMIZER_H
+
+#include "ContentsState.h"
+#include <cstddef>
+#include <map>
+#include <podofo/podofo.h>
+#include <string>
+
+namespace NoPoDoFo {
+
+struct ImageOptimizerOptions
+{
+  // images placed above this resolution are downsampled to it
+  double maxDpi = 150;
+  // used when re-encoding JPEG images, 0 keeps every image flate encoded
+  int jpegQuality = 75;
+  // store RGB images without colour as DeviceGray
+  bool grayscaleDetect = true;
+};
+
+struct ImageOptimizerResult
+{
+  size_t images = 0;
+  size_t optimized = 0;
+  size_t bytesBefore = 0;
+  size_t bytesAfter = 0;
+};
+
+/**
+ * Shrinks the image XObjects painted on the pages of a document. The
+ * effective resolution of an image is taken from its largest placement
+ * (pages and the forms they paint), images are then decoded, downsampled,
+ * reduced to gray and re-encoded in parallel. An image is only replaced when
+ * the new stream is smaller. Images with a decode array, stencil masks,
+ * colour key masks, soft masks with /Matte and formats RasterImage can not
+ * decode are left alone.
+ */
+class ImageOptimizer
+{
+public:
+  ImageOptimizer(PoDoFo::PdfMemDocument*, const ImageOptimizerOptions&);
+  ImageOptimizerResult Run();
+
+private:
+  struct Placement
+  {
+    PoDoFo::PdfObject* xobject;
+    int width;
+    int height;
+    // lowest resolution the image is shown at, 0 while unplaced
+    double dpi;
+  };
+
+  PoDoFo::PdfMemDocument* document;
+  ImageOptimizerOptions options;
+  std::map<PoDoFo::PdfReference, Placement> placements;
+
+  void Scan(PoDoFo::PdfObject* resources,
+            const std::string& contents,
+            const Matrix& base,
+            int depth);
+  void Place(PoDoFo::PdfObject* xobject, const Matrix& ctm);
+};
+}
+#endif // NPDF_IMAGEOPTIMIZER_H
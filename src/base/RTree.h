@@ -0,0 +1,342 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NPDF_RTREE_H
+#define NPDF_RTREE_H
+
+#include "ContentsState.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace NoPoDoFo {
+
+/**
+ * R-tree of values keyed by their bounding box. BulkLoad packs the tree with
+ * Sort-Tile-Recursive in O(n log n), Insert and Remove keep it balanced for
+ * incremental updates. Searches treat touching boxes as overlapping so a
+ * point query is a zero sized box.
+ */
+template<typename T>
+class RTree
+{
+public:
+  typedef std::pair<Box, T> Entry;
+
+  RTree()
+    : root(new Node(true))
+  {}
+
+  void BulkLoad(std::vector<Entry> entries)
+  {
+    count = entries.size();
+    if (entries.empty()) {
+      root.reset(new Node(true));
+      return;
+    }
+    std::vector<std::unique_ptr<Node>> level;
+    Tile(entries,
+         [](const Entry& e) -> const Box& { return e.first; },
+         [&](typename std::vector<Entry>::iterator begin,
+             typename std::vector<Entry>::iterator end) {
+           std::unique_ptr<Node> leaf(new Node(true));
+           leaf->items.assign(std::make_move_iterator(begin),
+                              std::make_move_iterator(end));
+           leaf->Update();
+           level.push_back(std::move(leaf));
+         });
+    while (level.size() > 1) {
+      std::vector<std::unique_ptr<Node>> parents;
+      Tile(level,
+           [](const std::unique_ptr<Node>& n) -> const Box& { return n->box; },
+           [&](typename std::vector<std::unique_ptr<Node>>::iterator begin,
+               typename std::vector<std::unique_ptr<Node>>::iterator end) {
+             std::unique_ptr<Node> parent(new Node(false));
+             parent->children.assign(std::make_move_iterator(begin),
+                                     std::make_move_iterator(end));
+             parent->Update();
+             parents.push_back(std::move(parent));
+           });
+      level = std::move(parents);
+    }
+    root = std::move(level.front());
+  }
+
+  void Insert(const Box& box, const T& value)
+  {
+    std::unique_ptr<Node> sibling = InsertInto(root.get(), Entry(box, value));
+    if (sibling) {
+      std::unique_ptr<Node> parent(new Node(false));
+      parent->children.push_back(std::move(root));
+      parent->children.push_back(std::move(sibling));
+      parent->Update();
+      root = std::move(parent);
+    }
+    ++count;
+  }
+
+  // Removes one entry equal to value whose box is box
+  bool Remove(const Box& box, const T& value)
+  {
+    std::vector<Entry> orphans;
+    if (!RemoveFrom(root.get(), box, value, orphans)) {
+      return false;
+    }
+    --count;
+    while (!root->leaf && root->children.size() == 1) {
+      std::unique_ptr<Node> child = std::move(root->children.front());
+      root = std::move(child);
+    }
+    if (!root->leaf && root->children.empty()) {
+      root.reset(new Node(true));
+    }
+    for (auto& orphan : orphans) {
+      --count;
+      Insert(orphan.first, orphan.second);
+    }
+    return true;
+  }
+
+  // fn(const Box&, const T&) for every entry overlapping box
+  template<typename F>
+  void Search(const Box& box, F fn) const
+  {
+    if (count) {
+      SearchIn(root.get(), box, fn);
+    }
+  }
+
+  void Clear()
+  {
+    root.reset(new Node(true));
+    count = 0;
+  }
+  size_t Size() const { return count; }
+
+private:
+  enum
+  {
+    MaxEntries = 16,
+    MinEntries = 4
+  };
+
+  struct Node
+  {
+    explicit Node(bool leaf)
+      : leaf(leaf)
+    {}
+    bool leaf;
+    Box box;
+    std::vector<Entry> items;
+    std::vector<std::unique_ptr<Node>> children;
+
+    void Update()
+    {
+      bool first = true;
+      auto grow = [&](const Box& b) {
+        box = first ? b : Union(box, b);
+        first = false;
+      };
+      for (auto& item : items) {
+        grow(item.first);
+      }
+      for (auto& child : children) {
+        grow(child->box);
+      }
+    }
+    size_t Size() const { return leaf ? items.size() : children.size(); }
+  };
+
+  std::unique_ptr<Node> root;
+  size_t count = 0;
+
+  static bool Overlaps(const Box& a, const Box& b)
+  {
+    return a.left <= b.right && b.left <= a.right && a.bottom <= b.top &&
+           b.bottom <= a.top;
+  }
+  static Box Union(const Box& a, const Box& b)
+  {
+    return Box{ std::min(a.left, b.left),
+                std::min(a.bottom, b.bottom),
+                std::max(a.right, b.right),
+                std::max(a.top, b.top) };
+  }
+  static double Area(const Box& b)
+  {
+    return (b.right - b.left) * (b.top - b.bottom);
+  }
+  static double CenterX(const Box& b) { return b.left + b.right; }
+  static double CenterY(const Box& b) { return b.bottom + b.top; }
+
+  // Sort-Tile-Recursive: vertical slices by x, then runs of MaxEntries by y
+  template<typename V, typename GetBox, typename Emit>
+  static void Tile(std::vector<V>& values, GetBox getBox, Emit emit)
+  {
+    const size_t groups = (values.size() + MaxEntries - 1) / MaxEntries;
+    const auto slices =
+      static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(groups))));
+    const size_t sliceSize = slices * MaxEntries;
+    std::sort(values.begin(), values.end(), [&](const V& a, const V& b) {
+      return CenterX(getBox(a)) < CenterX(getBox(b));
+    });
+    for (size_t s = 0; s < values.size(); s += sliceSize) {
+      auto sliceBegin = values.begin() + s;
+      auto sliceEnd = values.begin() + std::min(values.size(), s + sliceSize);
+      std::sort(sliceBegin, sliceEnd, [&](const V& a, const V& b) {
+        return CenterY(getBox(a)) < CenterY(getBox(b));
+      });
+      for (auto it = sliceBegin; it < sliceEnd;) {
+        auto next = it + std::min<std::ptrdiff_t>(MaxEntries, sliceEnd - it);
+        emit(it, next);
+        it = next;
+      }
+    }
+  }
+
+  // Split an overfull list in half along the axis with the larger spread
+  template<typename V, typename GetBox>
+  static std::vector<V> Split(std::vector<V>& values, GetBox getBox)
+  {
+    Box extent = getBox(values.front());
+    for (auto& v : values) {
+      extent = Union(extent, getBox(v));
+    }
+    const bool byX =
+      extent.right - extent.left >= extent.top - extent.bottom;
+    std::sort(values.begin(), values.end(), [&](const V& a, const V& b) {
+      return byX ? CenterX(getBox(a)) < CenterX(getBox(b))
+                 : CenterY(getBox(a)) < CenterY(getBox(b));
+    });
+    const size_t half = values.size() / 2;
+    std::vector<V> upper(std::make_move_iterator(values.begin() + half),
+                         std::make_move_iterator(values.end()));
+    values.erase(values.begin() + half, values.end());
+    return upper;
+  }
+
+  std::unique_ptr<Node> InsertInto(Node* node, Entry entry)
+  {
+    std::unique_ptr<Node> sibling;
+    if (node->leaf) {
+      node->items.push_back(std::move(entry));
+      if (node->items.size() > MaxEntries) {
+        sibling.reset(new Node(true));
+        sibling->items = Split(
+          node->items, [](const Entry& e) -> const Box& { return e.first; });
+        sibling->Update();
+      }
+    } else {
+      Node* best = nullptr;
+      double bestGrowth = 0, bestArea = 0;
+      for (auto& child : node->children) {
+        const double area = Area(child->box);
+        const double growth = Area(Union(child->box, entry.first)) - area;
+        if (!best || growth < bestGrowth ||
+            (growth == bestGrowth && area < bestArea)) {
+          best = child.get();
+          bestGrowth = growth;
+          bestArea = area;
+        }
+      }
+      std::unique_ptr<Node> split = InsertInto(best, std::move(entry));
+      if (split) {
+        node->children.push_back(std::move(split));
+      }
+      if (node->children.size() > MaxEntries) {
+        sibling.reset(new Node(false));
+        sibling->children =
+          Split(node->children, [](const std::unique_ptr<Node>& n) -> const Box& {
+            return n->box;
+          });
+        sibling->Update();
+      }
+    }
+    node->Update();
+    return sibling;
+  }
+
+  static void Collect(Node* node, std::vector<Entry>& out)
+  {
+    if (node->leaf) {
+      std::move(node->items.begin(), node->items.end(), std::back_inserter(out));
+    } else {
+      for (auto& child : node->children) {
+        Collect(child.get(), out);
+      }
+    }
+  }
+
+  bool RemoveFrom(Node* node,
+                  const Box& box,
+                  const T& value,
+                  std::vector<Entry>& orphans)
+  {
+    if (node->leaf) {
+      for (auto it = node->items.begin(); it != node->items.end(); ++it) {
+        if (it->second == value && it->first.left == box.left &&
+            it->first.bottom == box.bottom && it->first.right == box.right &&
+            it->first.top == box.top) {
+          node->items.erase(it);
+          node->Update();
+          return true;
+        }
+      }
+      return false;
+    }
+    for (auto it = node->children.begin(); it != node->children.end(); ++it) {
+      Node* child = it->get();
+      if (!Overlaps(child->box, box) ||
+          !RemoveFrom(child, box, value, orphans)) {
+        continue;
+      }
+      // underfull nodes are dissolved and their entries inserted again
+      if (child->Size() < MinEntries) {
+        Collect(child, orphans);
+        node->children.erase(it);
+      }
+      node->Update();
+      return true;
+    }
+    return false;
+  }
+
+  template<typename F>
+  static void SearchIn(const Node* node, const Box& box, F& fn)
+  {
+    if (node->leaf) {
+      for (auto& item : node->items) {
+        if (Overlaps(item.first, box)) {
+          fn(item.first, item.second);
+        }
+      }
+      return;
+    }
+    for (auto& child : node->children) {
+      if (Overlaps(child->box, box)) {
+        SearchIn(child.get(), box, fn);
+      }
+    }
+  }
+};
+}
+#endif // NPDF_RTREE_H
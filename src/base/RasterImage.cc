@@ -0,0 +1,396 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RasterImage.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#ifdef NPDF_HAVE_JPEG
+#include <csetjmp>
+#include <jpeglib.h>
+#endif
+
+namespace NoPoDoFo {
+
+using namespace PoDoFo;
+
+using std::string;
+
+static PdfObject*
+Resolve(PdfObject* owner, PdfObject* obj)
+{
+  if (obj && obj->IsReference() && owner && owner->GetOwner()) {
+    return owner->GetOwner()->GetObject(obj->GetReference());
+  }
+  return obj;
+}
+
+static bool
+IsDCT(const PdfName& name)
+{
+  return name.GetName() == "DCTDecode" || name.GetName() == "DCT";
+}
+
+static bool
+IsSupportedFilter(const PdfName& name)
+{
+  static const char* filters[] = { "FlateDecode",    "Fl",  "LZWDecode",
+                                   "LZW",            "ASCIIHexDecode",
+                                   "AHx",            "ASCII85Decode",
+                                   "A85",            "RunLengthDecode",
+                                   "RL" };
+  for (auto* filter : filters) {
+    if (name.GetName() == filter) {
+      return true;
+    }
+  }
+#ifdef PODOFO_HAVE_JPEG_LIB
+  // PoDoFo decodes DCT through libjpeg when it was built with it
+  return IsDCT(name);
+#else
+  return false;
+#endif
+}
+
+int
+RasterImage::Components(PdfObject* xobj, bool& cmyk)
+{
+  cmyk = false;
+  PdfObject* cs = xobj->GetIndirectKey(PdfName("ColorSpace"));
+  if (!cs) {
+    return 0;
+  }
+  string family;
+  PdfObject* param = nullptr;
+  if (cs->IsName()) {
+    family = cs->GetName().GetName();
+  } else if (cs->IsArray() && !cs->GetArray().empty() &&
+             cs->GetArray()[0].IsName()) {
+    family = cs->GetArray()[0].GetName().GetName();
+    if (cs->GetArray().size() > 1) {
+      param = Resolve(xobj, &cs->GetArray()[1]);
+    }
+  }
+  if (family == "DeviceGray" || family == "G" || family == "CalGray") {
+    return 1;
+  }
+  if (family == "DeviceRGB" || family == "RGB" || family == "CalRGB") {
+    return 3;
+  }
+  if (family == "DeviceCMYK" || family == "CMYK") {
+    cmyk = true;
+    return 4;
+  }
+  if (family == "ICCBased" && param && param->IsDictionary()) {
+    PdfObject* n = param->GetIndirectKey(PdfName("N"));
+    if (n && n->IsNumber()) {
+      cmyk = n->GetNumber() == 4;
+      return static_cast<int>(n->GetNumber());
+    }
+  }
+  // Indexed, Separation, Lab... have no component value known to be black
+  return 0;
+}
+
+bool
+RasterImage::IsDecodable(PdfObject* xobj)
+{
+  if (!xobj || !xobj->IsDictionary() || !xobj->HasStream()) {
+    return false;
+  }
+  PdfObject* subtype = xobj->GetIndirectKey(PdfName("Subtype"));
+  if (!subtype || !subtype->IsName() ||
+      subtype->GetName() != PdfName("Image")) {
+    return false;
+  }
+  PdfObject* mask = xobj->GetIndirectKey(PdfName("ImageMask"));
+  if (mask && mask->IsBool() && mask->GetBool()) {
+    return false;
+  }
+  PdfObject* bpc = xobj->GetIndirectKey(PdfName("BitsPerComponent"));
+  if (!bpc || !bpc->IsNumber() || bpc->GetNumber() != 8) {
+    return false;
+  }
+  // a decode array may remap the component values, black is unknown then
+  if (xobj->GetDictionary().HasKey(PdfName("Decode"))) {
+    return false;
+  }
+  PdfObject* filter = xobj->GetIndirectKey(PdfName("Filter"));
+  bool dct = false;
+  if (filter) {
+    if (filter->IsName()) {
+      if (!IsSupportedFilter(filter->GetName())) {
+        return false;
+      }
+      dct = IsDCT(filter->GetName());
+    } else if (filter->IsArray()) {
+      for (auto& item : filter->GetArray()) {
+        if (!item.IsName() || !IsSupportedFilter(item.GetName())) {
+          return false;
+        }
+        dct = dct || IsDCT(item.GetName());
+      }
+    } else {
+      return false;
+    }
+  }
+  bool cmyk;
+  int components = Components(xobj, cmyk);
+  // CMYK JPEGs are commonly stored inverted, only trust gray and RGB ones
+  return components > 0 && !(dct && cmyk);
+}
+
+bool
+RasterImage::Load(PdfObject* xobj)
+{
+  if (!IsDecodable(xobj)) {
+    return false;
+  }
+  PdfObject* w = xobj->GetIndirectKey(PdfName("Width"));
+  PdfObject* h = xobj->GetIndirectKey(PdfName("Height"));
+  if (!w || !h || !w->IsNumber() || !h->IsNumber()) {
+    return false;
+  }
+  width = static_cast<int>(w->GetNumber());
+  height = static_cast<int>(h->GetNumber());
+  components = Components(xobj, cmyk);
+  const size_t expected = static_cast<size_t>(width) * height * components;
+  char* buffer = nullptr;
+  pdf_long length = 0;
+  xobj->GetStream()->GetFilteredCopy(&buffer, &length);
+  pixels.assign(expected, 0xFF);
+  std::memcpy(pixels.data(),
+              buffer,
+              std::min(expected, static_cast<size_t>(length)));
+  podofo_free(buffer);
+  return true;
+}
+
+void
+RasterImage::Fill(int x0, int y0, int x1, int y1)
+{
+  x0 = std::max(0, x0);
+  y0 = std::max(0, y0);
+  x1 = std::min(width, x1);
+  y1 = std::min(height, y1);
+  for (int y = y0; y < y1; ++y) {
+    unsigned char* row =
+      pixels.data() + (static_cast<size_t>(y) * width + x0) * components;
+    for (int x = x0; x < x1; ++x) {
+      for (int c = 0; c < components; ++c) {
+        // CMYK black is full key, every other supported space is all zeros
+        *row++ = (cmyk && c == 3) ? 0xFF : 0x00;
+      }
+    }
+  }
+}
+
+void
+RasterImage::Store(PdfObject* source, PdfObject* target) const
+{
+  if (source != target) {
+    for (auto& item : source->GetDictionary().GetKeys()) {
+      target->GetDictionary().AddKey(item.first, *item.second);
+    }
+  }
+  target->GetDictionary().RemoveKey(PdfName("Filter"));
+  target->GetDictionary().RemoveKey(PdfName("DecodeParms"));
+  target->GetDictionary().RemoveKey(PdfName::KeyLength);
+  TVecFilters filters;
+  filters.push_back(ePdfFilter_FlateDecode);
+  target->GetStream()->Set(reinterpret_cast<const char*>(pixels.data()),
+                           static_cast<pdf_long>(pixels.size()),
+                           filters);
+}
+
+bool
+RasterImage::IsGray(int tolerance) const
+{
+  if (components != 3) {
+    return components == 1;
+  }
+  const unsigned char* p = pixels.data();
+  const unsigned char* end = p + pixels.size();
+  for (; p < end; p += 3) {
+    if (std::abs(p[0] - p[1]) > tolerance ||
+        std::abs(p[1] - p[2]) > tolerance) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void
+RasterImage::ToGray()
+{
+  if (components != 3) {
+    return;
+  }
+  const size_t count = static_cast<size_t>(width) * height;
+  for (size_t i = 0; i < count; ++i) {
+    const unsigned char* p = pixels.data() + i * 3;
+    pixels[i] =
+      static_cast<unsigned char>((77 * p[0] + 150 * p[1] + 29 * p[2]) >> 8);
+  }
+  pixels.resize(count);
+  components = 1;
+  cmyk = false;
+}
+
+void
+RasterImage::Downsample(int targetWidth, int targetHeight)
+{
+  targetWidth = std::max(1, std::min(targetWidth, width));
+  targetHeight = std::max(1, std::min(targetHeight, height));
+  if (targetWidth == width && targetHeight == height) {
+    return;
+  }
+  const size_t rowLength = static_cast<size_t>(width) * components;
+  std::vector<unsigned char> out(static_cast<size_t>(targetWidth) *
+                                 targetHeight * components);
+  std::vector<uint32_t> sums(rowLength);
+  // source column span of every target column
+  std::vector<int> columns(targetWidth + 1);
+  for (int x = 0; x <= targetWidth; ++x) {
+    columns[x] =
+      static_cast<int>(static_cast<int64_t>(x) * width / targetWidth);
+  }
+  for (int y = 0; y < targetHeight; ++y) {
+    int y0 = static_cast<int>(static_cast<int64_t>(y) * height / targetHeight);
+    int y1 =
+      static_cast<int>(static_cast<int64_t>(y + 1) * height / targetHeight);
+    y1 = std::max(y1, y0 + 1);
+    std::fill(sums.begin(), sums.end(), 0);
+    // plain loop over contiguous bytes, vectorized by the compiler
+    for (int sy = y0; sy < y1; ++sy) {
+      const unsigned char* row = pixels.data() + sy * rowLength;
+      uint32_t* sum = sums.data();
+      for (size_t i = 0; i < rowLength; ++i) {
+        sum[i] += row[i];
+      }
+    }
+    unsigned char* target =
+      out.data() + static_cast<size_t>(y) * targetWidth * components;
+    for (int x = 0; x < targetWidth; ++x) {
+      int x0 = columns[x], x1 = std::max(columns[x + 1], x0 + 1);
+      uint32_t area = static_cast<uint32_t>((x1 - x0) * (y1 - y0));
+      for (int c = 0; c < components; ++c) {
+        uint32_t total = 0;
+        for (int sx = x0; sx < x1; ++sx) {
+          total += sums[static_cast<size_t>(sx) * components + c];
+        }
+        *target++ = static_cast<unsigned char>((total + area / 2) / area);
+      }
+    }
+  }
+  pixels.swap(out);
+  width = targetWidth;
+  height = targetHeight;
+}
+
+string
+RasterImage::EncodeFlate() const
+{
+  auto filter = PdfFilterFactory::Create(ePdfFilter_FlateDecode);
+  char* buffer = nullptr;
+  pdf_long length = 0;
+  filter->Encode(reinterpret_cast<const char*>(pixels.data()),
+                 static_cast<pdf_long>(pixels.size()),
+                 &buffer,
+                 &length);
+  string out(buffer, static_cast<size_t>(length));
+  podofo_free(buffer);
+  return out;
+}
+
+#ifdef NPDF_HAVE_JPEG
+namespace {
+struct JpegError
+{
+  jpeg_error_mgr manager;
+  jmp_buf jump;
+};
+}
+
+static void
+JpegErrorExit(j_common_ptr info)
+{
+  longjmp(reinterpret_cast<JpegError*>(info->err)->jump, 1);
+}
+
+string
+RasterImage::EncodeJpeg(int quality) const
+{
+  if (components != 1 && components != 3) {
+    return string();
+  }
+  jpeg_compress_struct info;
+  JpegError error;
+  info.err = jpeg_std_error(&error.manager);
+  error.manager.error_exit = JpegErrorExit;
+  unsigned char* buffer = nullptr;
+  unsigned long length = 0;
+  if (setjmp(error.jump)) {
+    jpeg_destroy_compress(&info);
+    free(buffer);
+    PODOFO_RAISE_ERROR_INFO(ePdfError_InvalidDataType, "JPEG encoding failed");
+  }
+  jpeg_create_compress(&info);
+  jpeg_mem_dest(&info, &buffer, &length);
+  info.image_width = static_cast<JDIMENSION>(width);
+  info.image_height = static_cast<JDIMENSION>(height);
+  info.input_components = components;
+  info.in_color_space = components == 1 ? JCS_GRAYSCALE : JCS_RGB;
+  jpeg_set_defaults(&info);
+  jpeg_set_quality(&info, std::max(1, std::min(quality, 100)), TRUE);
+  jpeg_start_compress(&info, TRUE);
+  const size_t stride = static_cast<size_t>(width) * components;
+  while (info.next_scanline < info.image_height) {
+    JSAMPROW row =
+      const_cast<JSAMPROW>(pixels.data() + info.next_scanline * stride);
+    jpeg_write_scanlines(&info, &row, 1);
+  }
+  jpeg_finish_compress(&info);
+  jpeg_destroy_compress(&info);
+  string out(reinterpret_cast<char*>(buffer), length);
+  free(buffer);
+  return out;
+}
+#endif
+
+void
+RasterImage::StoreEncoded(PdfObject* target,
+                          const string& data,
+                          const char* filter) const
+{
+  PdfDictionary& dict = target->GetDictionary();
+  dict.AddKey(PdfName("Width"), static_cast<pdf_int64>(width));
+  dict.AddKey(PdfName("Height"), static_cast<pdf_int64>(height));
+  dict.AddKey(PdfName("BitsPerComponent"), static_cast<pdf_int64>(8));
+  if (components == 1) {
+    dict.AddKey(PdfName("ColorSpace"), PdfName("DeviceGray"));
+  }
+  dict.AddKey(PdfName("Filter"), PdfName(filter));
+  dict.RemoveKey(PdfName("DecodeParms"));
+  PdfMemoryInputStream input(data.data(), static_cast<pdf_long>(data.size()));
+  target->GetStream()->SetRawData(&input, static_cast<pdf_long>(data.size()));
+}
+}
@@ -0,0 +1,71 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NPDF_RASTERIMAGE_H
+#define NPDF_RASTERIMAGE_H
+
+#include <podofo/podofo.h>
+#include <string>
+#include <vector>
+
+namespace NoPoDoFo {
+
+/**
+ * Decoded 8 bits per component pixels of an image XObject. Only images whose
+ * filters PoDoFo can decode are supported, see IsDecodable.
+ */
+class RasterImage
+{
+public:
+  int width = 0;
+  int height = 0;
+  int components = 0;
+  bool cmyk = false;
+  std::vector<unsigned char> pixels;
+
+  // Checks the image dictionary only, the stream is not touched
+  static bool IsDecodable(PoDoFo::PdfObject* xobj);
+  bool Load(PoDoFo::PdfObject* xobj);
+  // Paint the pixel rectangle [x0, x1) x [y0, y1) black, rows top to bottom
+  void Fill(int x0, int y0, int x1, int y1);
+  // Write the pixels flate encoded into target, the image dictionary entries
+  // of source are copied over
+  void Store(PoDoFo::PdfObject* source, PoDoFo::PdfObject* target) const;
+
+  // Every pixel of an RGB image within tolerance of grey
+  bool IsGray(int tolerance) const;
+  // Collapse RGB pixels to a single luma component
+  void ToGray();
+  // Box filter to a smaller size, each target pixel averages its source area
+  void Downsample(int targetWidth, int targetHeight);
+  std::string EncodeFlate() const;
+#ifdef NPDF_HAVE_JPEG
+  // Baseline JPEG of gray or RGB pixels, quality 1 - 100
+  std::string EncodeJpeg(int quality) const;
+#endif
+  // Replace the stream of target with already encoded pixel data, updating
+  // the size, colour space and filter entries to match
+  void StoreEncoded(PoDoFo::PdfObject* target,
+                    const std::string& data,
+                    const char* filter) const;
+
+private:
+  static int Components(PoDoFo::PdfObject* xobj, bool& cmyk);
+};
+}
+#endif // NPDF_RASTERIMAGE_H
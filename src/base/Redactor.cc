@@ -0,0 +1,488 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Redactor.h"
+#include "ContentsRewriter.h"
+#include "RasterImage.h"
+#include "TextExtractor.h"
+#include <array>
+#include <cmath>
+#include <map>
+#include <sstream>
+
+namespace NoPoDoFo {
+
+using namespace PoDoFo;
+
+using std::map;
+using std::set;
+using std::string;
+using std::vector;
+
+static PdfObject*
+Resolve(PdfObject* owner, PdfObject* obj)
+{
+  if (obj && obj->IsReference() && owner && owner->GetOwner()) {
+    return owner->GetOwner()->GetObject(obj->GetReference());
+  }
+  return obj;
+}
+
+struct XObjectTarget
+{
+  PdfObject* obj = nullptr;
+  bool image = false;
+  bool decodable = false;
+  int width = 0;
+  int height = 0;
+  // forms only, placement of the form space bounding box
+  Box bbox;
+  Matrix matrix;
+  // resource name of the redacted copy of the image
+  string replacement;
+  // pixel rectangles x0, y0, x1, y1 to paint black
+  vector<std::array<int, 4>> regions;
+  // a placement touched a rectangle / a placement still paints the original
+  bool hit = false;
+  bool kept = false;
+};
+
+// Advance of a glyph of an unresolved font is assumed to be at most this,
+// in 1/1000 text space units, which is wider than any regular glyph
+static const double MaxGlyphAdvance = 2000;
+
+class RedactFilter : public ContentsFilter
+{
+public:
+  RedactFilter(const vector<Box>& rects,
+               FontDecoderMap& fonts,
+               map<string, XObjectTarget>& xobjects,
+               set<string>& names)
+    : rects(rects)
+    , fonts(fonts)
+    , xobjects(xobjects)
+    , names(names)
+  {}
+  void Begin(ContentsSerializer& out) override { out.Raw("q\n"); }
+  bool Visit(const string& op,
+             vector<PdfVariant>& operands,
+             const ContentsState& state,
+             ContentsSerializer& out) override
+  {
+    if (op == "Tj" || op == "TJ" || op == "'" || op == "\"") {
+      return ShowText(op, operands, state, out);
+    }
+    if (op == "Do") {
+      return PaintXObject(operands, state);
+    }
+    if (op == "BI") {
+      // inline images are the unit square under the ctm, the data is not
+      // redacted pixel by pixel, an image touching a rectangle is dropped
+      return !Hit(Box::Transformed(state.gs.ctm, 0, 0, 1, 1));
+    }
+    return true;
+  }
+  void End(ContentsSerializer& out) override
+  {
+    out.Raw("Q\n");
+    // the boxes are painted outside of any page graphics state
+    std::ostringstream boxes;
+    for (auto& rect : rects) {
+      boxes << "q 0 g " << rect.left << " " << rect.bottom << " "
+            << rect.right - rect.left << " " << rect.top - rect.bottom
+            << " re f Q\n";
+    }
+    out.Raw(boxes.str());
+  }
+
+  size_t removed = 0;
+
+private:
+  const vector<Box>& rects;
+  FontDecoderMap& fonts;
+  map<string, XObjectTarget>& xobjects;
+  set<string>& names;
+
+  bool Hit(const Box& box) const
+  {
+    for (auto& rect : rects) {
+      if (rect.Intersects(box)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool ShowText(const string& op,
+                vector<PdfVariant>& operands,
+                const ContentsState& state,
+                ContentsSerializer& out)
+  {
+    if (operands.empty()) {
+      return true;
+    }
+    // ' and " move to the next line before showing, measure from there
+    ContentsState local = state;
+    local.Apply(op, operands);
+    auto it = fonts.find(local.gs.fontName);
+    FontDecoder* decoder = it == fonts.end() ? nullptr : it->second.get();
+    if (!decoder) {
+      return CheckUnresolved(operands.back(), local);
+    }
+    const double fontSize = local.gs.fontSize;
+    PdfArray shown;
+    double offset = 0;
+    bool changed = false;
+
+    auto flushOffset = [&]() {
+      if (offset != 0) {
+        shown.push_back(PdfVariant(offset));
+        offset = 0;
+      }
+    };
+    auto showString = [&](const PdfString& value) {
+      vector<uint32_t> codes;
+      decoder->Codes(value, codes);
+      string kept;
+      auto flushKept = [&]() {
+        if (!kept.empty()) {
+          flushOffset();
+          shown.push_back(PdfString(
+            kept.data(), static_cast<pdf_long>(kept.size()), value.IsHex()));
+          kept.clear();
+        }
+      };
+      for (uint32_t code : codes) {
+        const double width = decoder->Width(code);
+        const bool space = !decoder->IsTwoByte() && code == 32;
+        Box box = Box::Transformed(local.TextRenderingMatrix(),
+                                   0,
+                                   decoder->GetDescent() / 1000.0,
+                                   width / 1000.0,
+                                   decoder->GetAscent() / 1000.0);
+        if (Hit(box)) {
+          flushKept();
+          // move by the advance of the removed glyph so the rest stays put
+          double advance = width;
+          if (fontSize != 0) {
+            advance +=
+              (local.gs.charSpace + (space ? local.gs.wordSpace : 0)) *
+              1000.0 / fontSize;
+          }
+          offset -= advance;
+          changed = true;
+          ++removed;
+        } else if (decoder->IsTwoByte()) {
+          kept.push_back(static_cast<char>(code >> 8));
+          kept.push_back(static_cast<char>(code & 0xFF));
+        } else {
+          kept.push_back(static_cast<char>(code));
+        }
+        local.Advance(width, space);
+      }
+      flushKept();
+    };
+
+    PdfVariant& operand = operands.back();
+    if (operand.IsArray()) {
+      for (auto& item : operand.GetArray()) {
+        if (item.IsString() || item.IsHexString()) {
+          showString(item.GetString());
+        } else if (item.IsNumber() || item.IsReal()) {
+          const double amount = ContentsState::ToReal(item);
+          offset += amount;
+          local.Adjust(amount);
+        }
+      }
+    } else if (operand.IsString() || operand.IsHexString()) {
+      showString(operand.GetString());
+    }
+    if (!changed) {
+      return true;
+    }
+    flushOffset();
+    if (op == "'") {
+      out.Operator("T*");
+    } else if (op == "\"" && operands.size() >= 3) {
+      out.Operand(operands[0]);
+      out.Operator("Tw");
+      out.Operand(operands[1]);
+      out.Operator("Tc");
+      out.Operator("T*");
+    }
+    out.Operand(PdfVariant(shown));
+    out.Operator("TJ");
+    return false;
+  }
+
+  // Without a font only the byte count of the strings is known. The pen
+  // position is bounded assuming every byte is a glyph of at most
+  // MaxGlyphAdvance; text whose bounds miss all rectangles is kept, anything
+  // else can not be redacted glyph by glyph and fails the whole redaction.
+  bool CheckUnresolved(const PdfVariant& operand, const ContentsState& local)
+  {
+    const double fontSize = local.gs.fontSize;
+    double spacing = 0;
+    if (fontSize != 0) {
+      spacing = std::abs(local.gs.charSpace * 1000.0 / fontSize) +
+                std::abs(local.gs.wordSpace * 1000.0 / fontSize);
+    }
+    // lowest and highest possible pen position, 1/1000 text space units
+    double low = 0, high = 0;
+    auto showString = [&](const PdfString& value) {
+      const double bytes = static_cast<double>(value.GetLength());
+      const double nextLow = low - bytes * spacing;
+      const double nextHigh = high + bytes * (MaxGlyphAdvance + spacing);
+      Box box = Box::Transformed(local.TextRenderingMatrix(),
+                                 nextLow / 1000.0,
+                                 -1,
+                                 nextHigh / 1000.0,
+                                 2);
+      if (Hit(box)) {
+        PODOFO_RAISE_ERROR_INFO(
+          ePdfError_InvalidFontFile,
+          "Text in font " + local.gs.fontName +
+            " intersects a redaction rectangle but the font can not be "
+            "resolved from the page resources");
+      }
+      low = nextLow;
+      high = nextHigh;
+    };
+    if (operand.IsArray()) {
+      for (auto& item : operand.GetArray()) {
+        if (item.IsString() || item.IsHexString()) {
+          showString(item.GetString());
+        } else if (item.IsNumber() || item.IsReal()) {
+          const double amount = ContentsState::ToReal(item);
+          low -= amount;
+          high -= amount;
+        }
+      }
+    } else if (operand.IsString() || operand.IsHexString()) {
+      showString(operand.GetString());
+    }
+    return true;
+  }
+
+  bool PaintXObject(vector<PdfVariant>& operands, const ContentsState& state)
+  {
+    if (operands.empty() || !operands.back().IsName()) {
+      return true;
+    }
+    auto it = xobjects.find(operands.back().GetName().GetName());
+    if (it == xobjects.end()) {
+      return true;
+    }
+    XObjectTarget& target = it->second;
+    const Matrix& ctm = state.gs.ctm;
+    Box placed = target.image
+                   ? Box::Transformed(ctm, 0, 0, 1, 1)
+                   : Box::Transformed(target.matrix.Multiply(ctm),
+                                      target.bbox.left,
+                                      target.bbox.bottom,
+                                      target.bbox.right,
+                                      target.bbox.top);
+    if (!Hit(placed)) {
+      target.kept = true;
+      return true;
+    }
+    target.hit = true;
+    Matrix inverse;
+    if (!target.image || !target.decodable || !ctm.Invert(inverse)) {
+      return false;
+    }
+    for (auto& rect : rects) {
+      if (!rect.Intersects(placed)) {
+        continue;
+      }
+      // image space is the unit square with the first row at the top
+      Box unit = Box::Transformed(
+        inverse, rect.left, rect.bottom, rect.right, rect.top);
+      target.regions.push_back(
+        { static_cast<int>(std::floor(unit.left * target.width)),
+          static_cast<int>(std::floor((1 - unit.top) * target.height)),
+          static_cast<int>(std::ceil(unit.right * target.width)),
+          static_cast<int>(std::ceil((1 - unit.bottom) * target.height)) });
+    }
+    if (target.replacement.empty()) {
+      int i = 0;
+      do {
+        target.replacement = "NpdfRedact" + std::to_string(i++);
+      } while (names.count(target.replacement));
+      names.insert(target.replacement);
+    }
+    operands.back() = PdfName(target.replacement);
+    return true;
+  }
+};
+
+Redactor::Redactor(PdfMemDocument* doc, PdfPage* page)
+  : doc(doc)
+  , page(page)
+{}
+
+static double
+Real(PdfObject* obj, size_t i, double fallback)
+{
+  if (obj && obj->IsArray() && obj->GetArray().size() > i) {
+    return ContentsState::ToReal(obj->GetArray()[i]);
+  }
+  return fallback;
+}
+
+// Names painted with Do by a content stream
+static void
+PaintedNames(const string& contents, set<string>& painted)
+{
+  PdfContentsTokenizer tokenizer(contents.data(),
+                                 static_cast<long>(contents.size()));
+  EPdfContentsType type;
+  const char* keyword = nullptr;
+  PdfVariant var;
+  string last;
+  while (tokenizer.ReadNext(type, keyword, var)) {
+    if (type == ePdfContentsType_Variant) {
+      last = var.IsName() ? var.GetName().GetName() : "";
+    } else if (type == ePdfContentsType_Keyword) {
+      if (string(keyword) == "Do" && !last.empty()) {
+        painted.insert(last);
+      }
+      last.clear();
+    }
+  }
+}
+
+size_t
+Redactor::Redact(const vector<Box>& rects)
+{
+  if (rects.empty()) {
+    return 0;
+  }
+  FontDecoderMap fonts;
+  TextExtractor::ResolveFonts(doc, page, fonts);
+
+  map<string, XObjectTarget> xobjects;
+  set<string> names;
+  PdfObject* resources = page->GetResources();
+  PdfObject* dict =
+    resources ? resources->GetIndirectKey(PdfName("XObject")) : nullptr;
+  if (dict && dict->IsDictionary()) {
+    for (auto& item : dict->GetDictionary().GetKeys()) {
+      names.insert(item.first.GetName());
+      PdfObject* obj = Resolve(dict, item.second);
+      PdfObject* subtype =
+        obj && obj->IsDictionary() ? obj->GetIndirectKey(PdfName("Subtype"))
+                                   : nullptr;
+      if (!subtype || !subtype->IsName()) {
+        continue;
+      }
+      XObjectTarget target;
+      target.obj = obj;
+      if (subtype->GetName() == PdfName("Image")) {
+        target.image = true;
+        target.decodable = RasterImage::IsDecodable(obj);
+        PdfObject* w = obj->GetIndirectKey(PdfName("Width"));
+        PdfObject* h = obj->GetIndirectKey(PdfName("Height"));
+        target.width = w && w->IsNumber() ? static_cast<int>(w->GetNumber()) : 0;
+        target.height =
+          h && h->IsNumber() ? static_cast<int>(h->GetNumber()) : 0;
+      } else if (subtype->GetName() == PdfName("Form")) {
+        PdfObject* bbox = obj->GetIndirectKey(PdfName("BBox"));
+        PdfObject* m = obj->GetIndirectKey(PdfName("Matrix"));
+        target.bbox = Box{ Real(bbox, 0, 0),
+                           Real(bbox, 1, 0),
+                           Real(bbox, 2, 0),
+                           Real(bbox, 3, 0) };
+        target.matrix = Matrix(Real(m, 0, 1),
+                               Real(m, 1, 0),
+                               Real(m, 2, 0),
+                               Real(m, 3, 1),
+                               Real(m, 4, 0),
+                               Real(m, 5, 0));
+      } else {
+        continue;
+      }
+      xobjects[item.first.GetName()] = target;
+    }
+  }
+
+  auto filter = std::make_shared<RedactFilter>(rects, fonts, xobjects, names);
+  ContentsRewriter rewriter(ContentsState::ReadContents(page));
+  rewriter.AddFilter(filter);
+  string contents = rewriter.Run();
+
+  PdfVecObjects* owner = page->GetObject()->GetOwner();
+  for (auto& item : xobjects) {
+    XObjectTarget& target = item.second;
+    if (target.replacement.empty()) {
+      continue;
+    }
+    // the original may be shared with other pages, redact a copy
+    RasterImage raster;
+    if (!raster.Load(target.obj)) {
+      continue;
+    }
+    for (auto& region : target.regions) {
+      raster.Fill(region[0], region[1], region[2], region[3]);
+    }
+    PdfObject* copy = owner->CreateObject();
+    raster.Store(target.obj, copy);
+    dict->GetDictionary().AddKey(PdfName(target.replacement),
+                                 copy->Reference());
+  }
+  // streams dropped from /Contents still hold the unredacted text
+  vector<PdfReference> removedRefs =
+    ContentsState::WriteContents(page, contents.data(), contents.size());
+
+  // Originals no longer painted by this page leave the resources, unless
+  // another page sharing the same /XObject dictionary still paints them
+  set<string> unused;
+  for (auto& item : xobjects) {
+    if (item.second.hit && !item.second.kept) {
+      unused.insert(item.first);
+    }
+  }
+  set<string> painted;
+  for (int i = 0; !unused.empty() && i < doc->GetPageCount(); ++i) {
+    PdfPage* other = doc->GetPage(i);
+    if (!other || other->GetObject() == page->GetObject()) {
+      continue;
+    }
+    PdfObject* otherResources = other->GetResources();
+    if (otherResources &&
+        otherResources->GetIndirectKey(PdfName("XObject")) == dict) {
+      PaintedNames(ContentsState::ReadContents(other), painted);
+    }
+  }
+  for (auto& name : unused) {
+    if (painted.count(name)) {
+      continue;
+    }
+    PdfObject* entry = dict->GetDictionary().GetKey(PdfName(name));
+    if (entry && entry->IsReference()) {
+      removedRefs.push_back(entry->GetReference());
+    }
+    dict->GetDictionary().RemoveKey(PdfName(name));
+  }
+  // drop the objects themselves, with whatever only they referenced, so the
+  // unredacted data is not written with the document
+  ContentsState::RemoveUnreferenced(doc, removedRefs);
+  return filter->removed;
+}
+}
@@ -0,0 +1,52 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NPDF_REDACTOR_H
+#define NPDF_REDACTOR_H
+
+#include "ContentsState.h"
+#include <podofo/podofo.h>
+#include <vector>
+
+namespace NoPoDoFo {
+
+/**
+ * Removes page content under a set of rectangles in a single rewrite pass.
+ * Text show operands lose the glyphs whose boxes intersect a rectangle (the
+ * remaining glyphs keep their position), pixels of 8 bit images are painted
+ * black in a per page copy of the image, and opaque boxes are painted over
+ * the rectangles. Images that can not be decoded, inline images and form
+ * XObjects touching a rectangle are dropped entirely since their content can
+ * not be inspected. Originals no longer painted anywhere are removed from the
+ * resources and the document. Text in a font that can not be resolved is
+ * kept when its conservative bounds miss the rectangles, otherwise Redact
+ * raises a PdfError and leaves the page unchanged.
+ */
+class Redactor
+{
+public:
+  Redactor(PoDoFo::PdfMemDocument*, PoDoFo::PdfPage*);
+  // Returns the number of glyphs removed
+  size_t Redact(const std::vector<Box>& rects);
+
+private:
+  PoDoFo::PdfMemDocument* doc;
+  PoDoFo::PdfPage* page;
+};
+}
+#endif // NPDF_REDACTOR_H
@@ -0,0 +1,275 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SpatialIndex.h"
+#include <algorithm>
+
+namespace NoPoDoFo {
+
+using namespace PoDoFo;
+
+using std::string;
+using std::vector;
+
+SpatialIndex::SpatialIndex(PdfPage* page)
+{
+  PdfObject* annots =
+    page->GetObject()->GetIndirectKey(PdfName("Annots"));
+  if (!annots || !annots->IsArray()) {
+    return;
+  }
+  PdfVecObjects* owner = page->GetObject()->GetOwner();
+  vector<RTree<SpatialEntry>::Entry> entries;
+  for (auto& item : annots->GetArray()) {
+    PdfObject* annot =
+      item.IsReference() ? owner->GetObject(item.GetReference()) : nullptr;
+    Slot slot;
+    if (annot) {
+      slot.ref = item.GetReference();
+      slot.widget = IsWidget(annot);
+    }
+    Append(slot);
+    Box box;
+    if (!annot || !Bounds(annot, box)) {
+      continue;
+    }
+    entries.emplace_back(box,
+                         SpatialEntry{ slot.widget ? SpatialEntry::Widget
+                                                   : SpatialEntry::Annotation,
+                                       slot.ref });
+  }
+  tree.BulkLoad(std::move(entries));
+}
+
+bool
+SpatialIndex::Bounds(PdfObject* annot, Box& box)
+{
+  PdfObject* rect = annot->GetIndirectKey(PdfName("Rect"));
+  if (!rect || !rect->IsArray() || rect->GetArray().size() < 4) {
+    return false;
+  }
+  const PdfArray& a = rect->GetArray();
+  const double x1 = ContentsState::ToReal(a[0]);
+  const double y1 = ContentsState::ToReal(a[1]);
+  const double x2 = ContentsState::ToReal(a[2]);
+  const double y2 = ContentsState::ToReal(a[3]);
+  box = Box{ std::min(x1, x2),
+             std::min(y1, y2),
+             std::max(x1, x2),
+             std::max(y1, y2) };
+  return true;
+}
+
+bool
+SpatialIndex::IsWidget(PdfObject* annot)
+{
+  PdfObject* subtype = annot->GetIndirectKey(PdfName("Subtype"));
+  return subtype && subtype->IsName() &&
+         subtype->GetName() == PdfName("Widget");
+}
+
+void
+SpatialIndex::AddAnnotation(PdfObject* annot)
+{
+  Slot slot;
+  slot.ref = annot->Reference();
+  slot.widget = IsWidget(annot);
+  Append(slot);
+  Box box;
+  if (Bounds(annot, box)) {
+    tree.Insert(box,
+                SpatialEntry{ slot.widget ? SpatialEntry::Widget
+                                          : SpatialEntry::Annotation,
+                              slot.ref });
+  }
+}
+
+void
+SpatialIndex::RemoveAnnotation(int index, PdfObject* annot)
+{
+  if (index < 0) {
+    return;
+  }
+  const size_t at = live.Find(index);
+  if (at >= slots.size()) {
+    return;
+  }
+  Slot& slot = slots[at];
+  slot.removed = true;
+  live.Add(at, -1);
+  if (slot.widget) {
+    widgets.Add(at, -1);
+  }
+  ++tombstones;
+  Box box;
+  if (slot.ref.ObjectNumber() != 0) {
+    auto it = slotOf.find(slot.ref);
+    if (it != slotOf.end() && it->second == at) {
+      slotOf.erase(it);
+    }
+    if (annot && Bounds(annot, box)) {
+      tree.Remove(box,
+                  SpatialEntry{ slot.widget ? SpatialEntry::Widget
+                                            : SpatialEntry::Annotation,
+                                slot.ref });
+    }
+  }
+  // rebuilding once the tombstones outnumber the entries keeps the
+  // amortized cost of a delete O(log n)
+  if (tombstones * 2 > slots.size()) {
+    Compact();
+  }
+}
+
+void
+SpatialIndex::Append(const Slot& slot)
+{
+  slots.push_back(slot);
+  live.Push(1);
+  widgets.Push(slot.widget ? 1 : 0);
+  if (slot.ref.ObjectNumber() != 0) {
+    slotOf[slot.ref] = slots.size() - 1;
+  }
+}
+
+void
+SpatialIndex::Compact()
+{
+  vector<Slot> kept;
+  kept.reserve(slots.size() - tombstones);
+  for (auto& slot : slots) {
+    if (!slot.removed) {
+      kept.push_back(slot);
+    }
+  }
+  slots.clear();
+  live.Clear();
+  widgets.Clear();
+  slotOf.clear();
+  tombstones = 0;
+  for (auto& slot : kept) {
+    Append(slot);
+  }
+}
+
+void
+SpatialIndex::Counts::Push(int value)
+{
+  // node i + 1 covers the slots (i + 1 - lowbit, i + 1]
+  const size_t i = tree.size();
+  const size_t low = (i + 1) & (~i);
+  tree.push_back(value + Before(i) - Before(i + 1 - low));
+}
+
+void
+SpatialIndex::Counts::Add(size_t slot, int delta)
+{
+  for (size_t j = slot + 1; j <= tree.size(); j += j & (~j + 1)) {
+    tree[j - 1] += delta;
+  }
+}
+
+int
+SpatialIndex::Counts::Before(size_t slot) const
+{
+  int sum = 0;
+  for (size_t j = slot; j > 0; j -= j & (~j + 1)) {
+    sum += tree[j - 1];
+  }
+  return sum;
+}
+
+size_t
+SpatialIndex::Counts::Find(int rank) const
+{
+  size_t step = 1;
+  while (step * 2 <= tree.size()) {
+    step *= 2;
+  }
+  size_t position = 0;
+  for (; step > 0; step /= 2) {
+    if (position + step <= tree.size() &&
+        tree[position + step - 1] <= rank) {
+      position += step;
+      rank -= tree[position - 1];
+    }
+  }
+  return position;
+}
+
+void
+SpatialIndex::AddText(const vector<TextRun>& runs)
+{
+  hasText = true;
+  for (auto& run : runs) {
+    if (run.glyphs.empty()) {
+      continue;
+    }
+    Box box = run.glyphs.front().box;
+    std::u32string text;
+    for (auto& glyph : run.glyphs) {
+      box.left = std::min(box.left, glyph.box.left);
+      box.bottom = std::min(box.bottom, glyph.box.bottom);
+      box.right = std::max(box.right, glyph.box.right);
+      box.top = std::max(box.top, glyph.box.top);
+      text.push_back(glyph.ch);
+    }
+    SpatialEntry entry{ SpatialEntry::Text, PdfReference() };
+    entry.run = texts.size();
+    texts.push_back(TextExtractor::ToUtf8(text));
+    tree.Insert(box, entry);
+  }
+}
+
+vector<SpatialHit>
+SpatialIndex::Query(const Box& area) const
+{
+  vector<SpatialHit> hits;
+  tree.Search(area, [&](const Box& box, const SpatialEntry& entry) {
+    SpatialHit hit;
+    hit.kind = entry.kind;
+    hit.box = box;
+    if (entry.kind == SpatialEntry::Text) {
+      hit.text = texts[entry.run];
+    } else {
+      // annotation indices are /Annots positions and field indices count
+      // every widget before them, whether or not it has a usable /Rect
+      auto it = slotOf.find(entry.ref);
+      if (it == slotOf.end()) {
+        return;
+      }
+      hit.annotation = live.Before(it->second);
+      hit.field = entry.kind == SpatialEntry::Widget
+                    ? widgets.Before(it->second)
+                    : -1;
+    }
+    hits.push_back(hit);
+  });
+  std::sort(
+    hits.begin(), hits.end(), [](const SpatialHit& a, const SpatialHit& b) {
+      const bool aText = a.kind == SpatialEntry::Text;
+      const bool bText = b.kind == SpatialEntry::Text;
+      if (aText != bText) {
+        return bText;
+      }
+      return a.annotation > b.annotation;
+    });
+  return hits;
+}
+}
@@ -0,0 +1,116 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NPDF_SPATIALINDEX_H
+#define NPDF_SPATIALINDEX_H
+
+#include "RTree.h"
+#include "TextExtractor.h"
+#include <map>
+#include <podofo/podofo.h>
+#include <string>
+#include <vector>
+
+namespace NoPoDoFo {
+
+struct SpatialEntry
+{
+  enum Kind
+  {
+    Annotation,
+    Widget,
+    Text
+  };
+  Kind kind;
+  PoDoFo::PdfReference ref; // annotations and widgets
+  size_t run = 0;           // text runs
+
+  bool operator==(const SpatialEntry& other) const
+  {
+    return kind == other.kind && ref == other.ref && run == other.run;
+  }
+};
+
+struct SpatialHit
+{
+  SpatialEntry::Kind kind;
+  Box box;
+  int annotation = -1; // index as used by Page.getAnnotation
+  int field = -1;      // index as used by Page.getField, widgets only
+  std::string text;    // text runs only
+};
+
+/**
+ * R-tree over the annotation and widget rectangles of a page, text run boxes
+ * are added on request. Kept up to date through AddAnnotation and
+ * RemoveAnnotation so creating or deleting an annotation does not rebuild it.
+ */
+class SpatialIndex
+{
+public:
+  explicit SpatialIndex(PoDoFo::PdfPage*);
+  // Call after the annotation was appended to the page /Annots
+  void AddAnnotation(PoDoFo::PdfObject*);
+  // Call before the /Annots entry at index, annot, is deleted from the page
+  void RemoveAnnotation(int index, PoDoFo::PdfObject* annot);
+  bool HasText() const { return hasText; }
+  void AddText(const std::vector<TextRun>&);
+  // Hits overlapping box, topmost annotation first and text runs last
+  std::vector<SpatialHit> Query(const Box&) const;
+
+private:
+  RTree<SpatialEntry> tree;
+  struct Slot
+  {
+    PoDoFo::PdfReference ref; // 0 0 R for entries that are not annotations
+    bool widget = false;
+    bool removed = false;
+  };
+  // Fenwick tree over the slots, O(log n) updates and prefix sums
+  class Counts
+  {
+  public:
+    void Push(int value);
+    void Add(size_t slot, int delta);
+    // sum over the slots before slot
+    int Before(size_t slot) const;
+    // first slot where the running sum exceeds rank, the size if none does
+    size_t Find(int rank) const;
+    void Clear() { tree.clear(); }
+
+  private:
+    std::vector<int> tree;
+  };
+  // every /Annots entry in order, invalid ones included, so the indices
+  // match the Page accessors. Deleted entries stay as tombstones until
+  // Compact, positions are resolved from the counts when querying.
+  std::vector<Slot> slots;
+  Counts live;
+  Counts widgets;
+  std::map<PoDoFo::PdfReference, size_t> slotOf;
+  size_t tombstones = 0;
+  std::vector<std::string> texts;
+  bool hasText = false;
+
+  static bool Bounds(PoDoFo::PdfObject*, Box&);
+  static bool IsWidget(PoDoFo::PdfObject*);
+  void Append(const Slot&);
+  void Compact();
+};
+}
+#endif // NPDF_SPATIALINDEX_H
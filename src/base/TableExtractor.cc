@@ -0,0 +1,339 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TableExtractor.h"
+#include "RTree.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <numeric>
+
+namespace NoPoDoFo {
+
+using namespace PoDoFo;
+
+using std::string;
+using std::vector;
+
+typedef TableExtractor::Segment Segment;
+
+// Distance in points within which coordinates are taken to be the same line
+static const double Tolerance = 2.0;
+
+TableExtractor::TableExtractor(PdfMemDocument* doc, PdfPage* page)
+  : text(doc, page)
+{}
+
+struct Point
+{
+  double x, y;
+};
+
+void
+TableExtractor::CollectRulings(vector<Segment>& horizontal,
+                               vector<Segment>& vertical)
+{
+  const string& contents = text.GetContents();
+  if (contents.empty()) {
+    return;
+  }
+  PdfContentsTokenizer tokenizer(contents.data(),
+                                 static_cast<long>(contents.size()));
+  EPdfContentsType type;
+  const char* keyword = nullptr;
+  PdfVariant var;
+  vector<PdfVariant> operands;
+  ContentsState state;
+  // current path in user space, rectangles are kept apart since only those
+  // contribute when filled
+  vector<std::pair<Point, Point>> lines;
+  vector<std::pair<Point, Point>> rectEdges;
+  Point current{ 0, 0 }, start{ 0, 0 };
+
+  auto point = [&](size_t i) {
+    Point p;
+    state.gs.ctm.Transform(ContentsState::ToReal(operands[i]),
+                           ContentsState::ToReal(operands[i + 1]),
+                           p.x,
+                           p.y);
+    return p;
+  };
+  auto add = [&](const std::pair<Point, Point>& edge) {
+    const double dx = std::fabs(edge.first.x - edge.second.x);
+    const double dy = std::fabs(edge.first.y - edge.second.y);
+    if (dy <= Tolerance && dx > Tolerance) {
+      horizontal.push_back({ (edge.first.y + edge.second.y) / 2,
+                             std::min(edge.first.x, edge.second.x),
+                             std::max(edge.first.x, edge.second.x) });
+    } else if (dx <= Tolerance && dy > Tolerance) {
+      vertical.push_back({ (edge.first.x + edge.second.x) / 2,
+                           std::min(edge.first.y, edge.second.y),
+                           std::max(edge.first.y, edge.second.y) });
+    }
+  };
+
+  while (tokenizer.ReadNext(type, keyword, var)) {
+    if (type == ePdfContentsType_Variant) {
+      operands.push_back(var);
+      continue;
+    }
+    if (type != ePdfContentsType_Keyword) {
+      operands.clear();
+      continue;
+    }
+    string op(keyword);
+    const size_t n = operands.size();
+    if (op == "m" && n >= 2) {
+      current = start = point(n - 2);
+    } else if (op == "l" && n >= 2) {
+      Point next = point(n - 2);
+      lines.push_back({ current, next });
+      current = next;
+    } else if ((op == "c" || op == "v" || op == "y") && n >= 4) {
+      current = point(n - 2);
+    } else if (op == "h") {
+      lines.push_back({ current, start });
+      current = start;
+    } else if (op == "re" && n >= 4) {
+      const double x = ContentsState::ToReal(operands[n - 4]);
+      const double y = ContentsState::ToReal(operands[n - 3]);
+      const double w = ContentsState::ToReal(operands[n - 2]);
+      const double h = ContentsState::ToReal(operands[n - 1]);
+      Point c[4];
+      state.gs.ctm.Transform(x, y, c[0].x, c[0].y);
+      state.gs.ctm.Transform(x + w, y, c[1].x, c[1].y);
+      state.gs.ctm.Transform(x + w, y + h, c[2].x, c[2].y);
+      state.gs.ctm.Transform(x, y + h, c[3].x, c[3].y);
+      Box bounds = Box::Transformed(state.gs.ctm, x, y, x + w, y + h);
+      if (bounds.top - bounds.bottom <= Tolerance) {
+        // a thin filled or stroked rectangle draws a single rule
+        const double mid = (bounds.top + bounds.bottom) / 2;
+        rectEdges.push_back({ { bounds.left, mid }, { bounds.right, mid } });
+      } else if (bounds.right - bounds.left <= Tolerance) {
+        const double mid = (bounds.left + bounds.right) / 2;
+        rectEdges.push_back({ { mid, bounds.bottom }, { mid, bounds.top } });
+      } else {
+        for (int i = 0; i < 4; ++i) {
+          rectEdges.push_back({ c[i], c[(i + 1) % 4] });
+        }
+      }
+      current = start = c[0];
+    } else if (op == "S" || op == "s" || op == "B" || op == "B*" ||
+               op == "b" || op == "b*") {
+      if (op == "s" || op == "b" || op == "b*") {
+        lines.push_back({ current, start });
+      }
+      std::for_each(lines.begin(), lines.end(), add);
+      std::for_each(rectEdges.begin(), rectEdges.end(), add);
+      lines.clear();
+      rectEdges.clear();
+    } else if (op == "f" || op == "F" || op == "f*") {
+      std::for_each(rectEdges.begin(), rectEdges.end(), add);
+      lines.clear();
+      rectEdges.clear();
+    } else if (op == "n") {
+      lines.clear();
+      rectEdges.clear();
+    } else {
+      state.Apply(op, operands);
+    }
+    operands.clear();
+  }
+}
+
+// Sort and join segments lying on the same line that overlap or touch
+static void
+Merge(vector<Segment>& segments)
+{
+  std::sort(segments.begin(), segments.end(), [](const Segment& a, const Segment& b) {
+    return a.pos < b.pos || (a.pos == b.pos && a.from < b.from);
+  });
+  vector<Segment> merged;
+  size_t i = 0;
+  while (i < segments.size()) {
+    // a run of segments on (nearly) the same line, ordered by start
+    size_t j = i;
+    while (j + 1 < segments.size() &&
+           segments[j + 1].pos - segments[i].pos <= Tolerance) {
+      ++j;
+    }
+    std::sort(segments.begin() + i,
+              segments.begin() + j + 1,
+              [](const Segment& a, const Segment& b) { return a.from < b.from; });
+    Segment current = segments[i];
+    for (size_t k = i + 1; k <= j; ++k) {
+      if (segments[k].from <= current.to + Tolerance) {
+        current.to = std::max(current.to, segments[k].to);
+      } else {
+        merged.push_back(current);
+        current = segments[k];
+      }
+    }
+    merged.push_back(current);
+    i = j + 1;
+  }
+  segments = std::move(merged);
+}
+
+// Distinct coordinates, values closer than the tolerance collapse into one
+static vector<double>
+Cluster(vector<double> values)
+{
+  std::sort(values.begin(), values.end());
+  vector<double> out;
+  for (double value : values) {
+    if (out.empty() || value - out.back() > Tolerance) {
+      out.push_back(value);
+    }
+  }
+  return out;
+}
+
+static size_t
+Find(vector<size_t>& parent, size_t i)
+{
+  while (parent[i] != i) {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
+  }
+  return i;
+}
+
+vector<ExtractedTable>
+TableExtractor::Extract()
+{
+  vector<ExtractedTable> tables;
+  vector<Segment> horizontal, vertical;
+  CollectRulings(horizontal, vertical);
+  Merge(horizontal);
+  Merge(vertical);
+  if (horizontal.size() < 2 || vertical.size() < 2) {
+    return tables;
+  }
+
+  // group crossing segments, horizontal i is node i, vertical j is h + j
+  const size_t h = horizontal.size();
+  vector<std::pair<Box, size_t>> entries;
+  entries.reserve(vertical.size());
+  for (size_t j = 0; j < vertical.size(); ++j) {
+    const Segment& v = vertical[j];
+    entries.push_back({ Box{ v.pos - Tolerance,
+                             v.from - Tolerance,
+                             v.pos + Tolerance,
+                             v.to + Tolerance },
+                        j });
+  }
+  RTree<size_t> verticals;
+  verticals.BulkLoad(std::move(entries));
+  vector<size_t> parent(h + vertical.size());
+  std::iota(parent.begin(), parent.end(), 0);
+  for (size_t i = 0; i < h; ++i) {
+    const Segment& s = horizontal[i];
+    verticals.Search(Box{ s.from, s.pos, s.to, s.pos },
+                     [&](const Box&, const size_t& j) {
+                       parent[Find(parent, i)] = Find(parent, h + j);
+                     });
+  }
+
+  std::map<size_t, std::pair<vector<double>, vector<double>>> groups;
+  for (size_t i = 0; i < parent.size(); ++i) {
+    auto& group = groups[Find(parent, i)];
+    if (i < h) {
+      group.second.push_back(horizontal[i].pos);
+    } else {
+      group.first.push_back(vertical[i - h].pos);
+    }
+  }
+  for (auto& item : groups) {
+    vector<double> columns = Cluster(item.second.first);
+    vector<double> rows = Cluster(item.second.second);
+    if (columns.size() < 2 || rows.size() < 2 ||
+        (columns.size() - 1) * (rows.size() - 1) < 2) {
+      continue;
+    }
+    std::reverse(rows.begin(), rows.end());
+    ExtractedTable table;
+    table.box = Box{ columns.front(), rows.back(), columns.back(), rows.front() };
+    table.cells.assign(rows.size() - 1, vector<string>(columns.size() - 1));
+    table.columns = std::move(columns);
+    table.rows = std::move(rows);
+    tables.push_back(std::move(table));
+  }
+  if (tables.empty()) {
+    return tables;
+  }
+
+  // place every glyph by its center into the table and cell containing it
+  vector<std::pair<Box, size_t>> tableEntries;
+  for (size_t t = 0; t < tables.size(); ++t) {
+    tableEntries.push_back({ tables[t].box, t });
+  }
+  RTree<size_t> index;
+  index.BulkLoad(std::move(tableEntries));
+  vector<vector<vector<const TextGlyph*>>> placed(tables.size());
+  for (size_t t = 0; t < tables.size(); ++t) {
+    placed[t].resize(tables[t].cells.size() *
+                     tables[t].cells.front().size());
+  }
+  vector<TextRun> runs = text.Extract();
+  for (auto& run : runs) {
+    for (auto& glyph : run.glyphs) {
+      const double x = (glyph.box.left + glyph.box.right) / 2;
+      const double y = (glyph.box.bottom + glyph.box.top) / 2;
+      index.Search(Box{ x, y, x, y }, [&](const Box&, const size_t& t) {
+        const ExtractedTable& table = tables[t];
+        const auto col = static_cast<size_t>(
+          std::upper_bound(table.columns.begin(), table.columns.end(), x) -
+          table.columns.begin() - 1);
+        const auto row = static_cast<size_t>(
+          std::upper_bound(
+            table.rows.begin(), table.rows.end(), y, std::greater<double>()) -
+          table.rows.begin() - 1);
+        if (row < table.cells.size() && col < table.cells[row].size()) {
+          placed[t][row * table.cells[row].size() + col].push_back(&glyph);
+        }
+      });
+    }
+  }
+  for (size_t t = 0; t < tables.size(); ++t) {
+    ExtractedTable& table = tables[t];
+    const size_t cols = table.cells.front().size();
+    for (size_t c = 0; c < placed[t].size(); ++c) {
+      std::u32string cell;
+      const TextGlyph* prev = nullptr;
+      for (const TextGlyph* glyph : placed[t][c]) {
+        if (prev) {
+          const double height = prev->box.top - prev->box.bottom;
+          if (std::fabs(glyph->box.bottom - prev->box.bottom) > height / 2) {
+            cell.push_back(U'\n');
+          } else if (glyph->box.left - prev->box.right > height * 0.2 &&
+                     prev->ch != U' ' && glyph->ch != U' ') {
+            cell.push_back(U' ');
+          }
+        }
+        cell.push_back(glyph->ch);
+        prev = glyph;
+      }
+      table.cells[c / cols][c % cols] = TextExtractor::ToUtf8(cell);
+    }
+  }
+  return tables;
+}
+}
@@ -0,0 +1,68 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NPDF_TABLEEXTRACTOR_H
+#define NPDF_TABLEEXTRACTOR_H
+
+#include "TextExtractor.h"
+#include <podofo/podofo.h>
+#include <string>
+#include <vector>
+
+namespace NoPoDoFo {
+
+/**
+ * A ruled table found on a page. Column edges run left to right and row edges
+ * top to bottom, cells[row][col] holds the text placed inside the cell.
+ */
+struct ExtractedTable
+{
+  Box box;
+  std::vector<double> columns;
+  std::vector<double> rows;
+  std::vector<std::vector<std::string>> cells;
+};
+
+/**
+ * Detects tables drawn with ruling lines. Stroked paths and filled rectangles
+ * are reduced to horizontal and vertical segments, segments that cross each
+ * other (found through an R-tree) are grouped into grids and the page text is
+ * assigned to the grid cells. Like TextExtractor, construction reads the
+ * page and Extract can run on any thread.
+ */
+class TableExtractor
+{
+public:
+  TableExtractor(PoDoFo::PdfMemDocument*, PoDoFo::PdfPage*);
+  std::vector<ExtractedTable> Extract();
+
+  struct Segment
+  {
+    double pos; // y of horizontal, x of vertical segments
+    double from;
+    double to;
+  };
+
+private:
+  TextExtractor text;
+
+  void CollectRulings(std::vector<Segment>& horizontal,
+                      std::vector<Segment>& vertical);
+};
+}
+#endif // NPDF_TABLEEXTRACTOR_H
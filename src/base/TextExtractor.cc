@@ -0,0 +1,422 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TextExtractor.h"
+#include <algorithm>
+#include <cmath>
+
+namespace NoPoDoFo {
+
+using namespace PoDoFo;
+
+using std::string;
+using std::u32string;
+using std::vector;
+
+static PdfObject*
+Resolve(PdfObject* owner, PdfObject* obj)
+{
+  if (obj && obj->IsReference() && owner && owner->GetOwner()) {
+    return owner->GetOwner()->GetObject(obj->GetReference());
+  }
+  return obj;
+}
+
+FontDecoder::FontDecoder(PdfObject* fontObj, PdfFont* font)
+  : fontObj(fontObj)
+  , font(font)
+{
+  PdfObject* subtype = fontObj->GetIndirectKey(PdfName("Subtype"));
+  twoByte = subtype && subtype->IsName() &&
+            subtype->GetName() == PdfName("Type0");
+  if (twoByte) {
+    PdfObject* descendants =
+      fontObj->GetIndirectKey(PdfName("DescendantFonts"));
+    if (descendants && descendants->IsArray() &&
+        !descendants->GetArray().empty()) {
+      PdfObject* cid = Resolve(fontObj, &descendants->GetArray()[0]);
+      if (cid && cid->IsDictionary()) {
+        ReadCIDWidths(cid);
+        ReadDescriptor(cid->GetIndirectKey(PdfName("FontDescriptor")));
+      }
+    }
+  } else {
+    ReadDescriptor(fontObj->GetIndirectKey(PdfName("FontDescriptor")));
+    ReadSimpleWidths();
+    for (uint32_t code = 0; code < 256; ++code) {
+      unicode[code] = ToUnicode(code);
+    }
+  }
+}
+
+void
+FontDecoder::ReadDescriptor(PdfObject* descriptor)
+{
+  if (!descriptor || !descriptor->IsDictionary()) {
+    return;
+  }
+  PdfObject* value = descriptor->GetIndirectKey(PdfName("Ascent"));
+  if (value && ContentsState::ToReal(*value) > 0) {
+    ascent = ContentsState::ToReal(*value);
+  }
+  value = descriptor->GetIndirectKey(PdfName("Descent"));
+  if (value && ContentsState::ToReal(*value) < 0) {
+    descent = ContentsState::ToReal(*value);
+  }
+  value = descriptor->GetIndirectKey(PdfName("MissingWidth"));
+  if (value) {
+    defaultWidth = ContentsState::ToReal(*value);
+  }
+}
+
+void
+FontDecoder::ReadSimpleWidths()
+{
+  simpleWidths.assign(256, defaultWidth);
+  double scale = 1.0;
+  PdfObject* fontMatrix = fontObj->GetIndirectKey(PdfName("FontMatrix"));
+  if (fontMatrix && fontMatrix->IsArray() && !fontMatrix->GetArray().empty()) {
+    scale = ContentsState::ToReal(fontMatrix->GetArray()[0]) * 1000.0;
+  }
+  PdfObject* widths = fontObj->GetIndirectKey(PdfName("Widths"));
+  PdfObject* first = fontObj->GetIndirectKey(PdfName("FirstChar"));
+  if (widths && widths->IsArray() && first && first->IsNumber()) {
+    const auto firstChar = static_cast<size_t>(first->GetNumber());
+    PdfArray& array = widths->GetArray();
+    for (size_t i = 0; i < array.size() && firstChar + i < 256; ++i) {
+      simpleWidths[firstChar + i] =
+        ContentsState::ToReal(*Resolve(fontObj, &array[i])) * scale;
+    }
+    return;
+  }
+  if (!font) {
+    return;
+  }
+  // Standard 14 fonts carry no /Widths, fall back to the built in metrics
+  // measured at a font size of 1000 so that CharWidth is in glyph space.
+  auto* metrics = const_cast<PdfFontMetrics*>(font->GetFontMetrics());
+  const float size = metrics->GetFontSize();
+  const float scaling = metrics->GetFontScale();
+  const float charSpace = metrics->GetFontCharSpace();
+  metrics->SetFontSize(1000.0f);
+  metrics->SetFontScale(100.0f);
+  metrics->SetFontCharSpace(0.0f);
+  for (uint32_t code = 0; code < 256; ++code) {
+    simpleWidths[code] = metrics->CharWidth(static_cast<unsigned char>(code));
+  }
+  metrics->SetFontSize(size);
+  metrics->SetFontScale(scaling);
+  metrics->SetFontCharSpace(charSpace);
+}
+
+void
+FontDecoder::ReadCIDWidths(PdfObject* cid)
+{
+  defaultWidth = 1000;
+  PdfObject* dw = cid->GetIndirectKey(PdfName("DW"));
+  if (dw) {
+    defaultWidth = ContentsState::ToReal(*dw);
+  }
+  PdfObject* w = cid->GetIndirectKey(PdfName("W"));
+  if (!w || !w->IsArray()) {
+    return;
+  }
+  PdfArray& array = w->GetArray();
+  size_t i = 0;
+  while (i + 1 < array.size()) {
+    const auto start =
+      static_cast<uint32_t>(ContentsState::ToReal(*Resolve(cid, &array[i])));
+    PdfObject* next = Resolve(cid, &array[i + 1]);
+    if (next->IsArray()) {
+      PdfArray& widths = next->GetArray();
+      for (size_t j = 0; j < widths.size(); ++j) {
+        cidWidths[start + static_cast<uint32_t>(j)] =
+          ContentsState::ToReal(*Resolve(cid, &widths[j]));
+      }
+      i += 2;
+    } else if (i + 2 < array.size()) {
+      const auto end = static_cast<uint32_t>(ContentsState::ToReal(*next));
+      const double width = ContentsState::ToReal(*Resolve(cid, &array[i + 2]));
+      for (uint32_t code = start; code <= end && code - start < 0xFFFF;
+           ++code) {
+        cidWidths[code] = width;
+      }
+      i += 3;
+    } else {
+      break;
+    }
+  }
+}
+
+double
+FontDecoder::Width(uint32_t code) const
+{
+  if (!twoByte) {
+    return code < simpleWidths.size() ? simpleWidths[code] : defaultWidth;
+  }
+  auto it = cidWidths.find(code);
+  return it == cidWidths.end() ? defaultWidth : it->second;
+}
+
+u32string
+FontDecoder::ToUnicode(uint32_t code)
+{
+  char bytes[2];
+  pdf_long length = 1;
+  if (twoByte) {
+    bytes[0] = static_cast<char>((code >> 8) & 0xFF);
+    bytes[1] = static_cast<char>(code & 0xFF);
+    length = 2;
+  } else {
+    bytes[0] = static_cast<char>(code & 0xFF);
+  }
+  if (font && font->GetEncoding()) {
+    try {
+      PdfString raw(bytes, length);
+      PdfString converted = font->GetEncoding()->ConvertToUnicode(raw, font);
+      u32string text = TextExtractor::FromUtf8(converted.GetStringUtf8());
+      if (!text.empty()) {
+        return text;
+      }
+    } catch (PdfError&) {
+    }
+  }
+  if (twoByte) {
+    return u32string();
+  }
+  return u32string(1, static_cast<char32_t>(code));
+}
+
+void
+FontDecoder::Codes(const PdfString& value, vector<uint32_t>& out) const
+{
+  const auto* data = reinterpret_cast<const unsigned char*>(value.GetString());
+  const auto length = static_cast<size_t>(value.GetLength());
+  if (twoByte) {
+    for (size_t i = 0; i + 1 < length; i += 2) {
+      out.push_back(static_cast<uint32_t>(data[i] << 8 | data[i + 1]));
+    }
+  } else {
+    for (size_t i = 0; i < length; ++i) {
+      out.push_back(data[i]);
+    }
+  }
+}
+
+void
+FontDecoder::Decode(const PdfString& value, vector<Glyph>& out)
+{
+  vector<uint32_t> codes;
+  Codes(value, codes);
+  for (uint32_t code : codes) {
+    Glyph glyph;
+    glyph.width = Width(code);
+    glyph.space = !twoByte && code == 32;
+    if (twoByte) {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = unicode.find(code);
+      if (it == unicode.end()) {
+        it = unicode.emplace(code, ToUnicode(code)).first;
+      }
+      glyph.text = it->second;
+    } else {
+      glyph.text = unicode[code];
+    }
+    out.push_back(glyph);
+  }
+}
+
+TextExtractor::TextExtractor(PdfMemDocument* doc, PdfPage* page)
+  : contents(ContentsState::ReadContents(page))
+{
+  ResolveFonts(doc, page, fonts);
+}
+
+void
+TextExtractor::ResolveFonts(PdfMemDocument* doc,
+                            PdfPage* page,
+                            FontDecoderMap& fonts)
+{
+  PdfObject* resources = page->GetResources();
+  if (!resources) {
+    return;
+  }
+  PdfObject* fontDict = resources->GetIndirectKey(PdfName("Font"));
+  if (!fontDict || !fontDict->IsDictionary()) {
+    return;
+  }
+  for (auto& item : fontDict->GetDictionary().GetKeys()) {
+    PdfObject* fontObj = Resolve(fontDict, item.second);
+    if (!fontObj || !fontObj->IsDictionary()) {
+      continue;
+    }
+    PdfFont* font = nullptr;
+    try {
+      font = doc->GetFont(fontObj);
+    } catch (PdfError&) {
+      font = nullptr;
+    }
+    fonts[item.first.GetName()] =
+      std::make_shared<FontDecoder>(fontObj, font);
+  }
+}
+
+vector<TextRun>
+TextExtractor::Extract()
+{
+  vector<TextRun> runs;
+  if (contents.empty()) {
+    return runs;
+  }
+  PdfContentsTokenizer tokenizer(contents.data(),
+                                 static_cast<long>(contents.size()));
+  EPdfContentsType type;
+  const char* keyword = nullptr;
+  PdfVariant var;
+  vector<PdfVariant> operands;
+  vector<FontDecoder::Glyph> glyphs;
+  ContentsState state;
+
+  auto show = [&](FontDecoder& decoder, const PdfString& value, TextRun& run) {
+    glyphs.clear();
+    decoder.Decode(value, glyphs);
+    for (auto& glyph : glyphs) {
+      Matrix trm = state.TextRenderingMatrix();
+      Box box = Box::Transformed(trm,
+                                 0,
+                                 decoder.GetDescent() / 1000.0,
+                                 glyph.width / 1000.0,
+                                 decoder.GetAscent() / 1000.0);
+      // ligatures decode to several characters sharing one glyph box
+      const double step =
+        (box.right - box.left) / std::max<size_t>(1, glyph.text.size());
+      for (size_t i = 0; i < glyph.text.size(); ++i) {
+        TextGlyph placed{ glyph.text[i], box };
+        placed.box.left = box.left + step * i;
+        placed.box.right = placed.box.left + step;
+        run.glyphs.push_back(placed);
+      }
+      state.Advance(glyph.width, glyph.space);
+    }
+  };
+
+  while (tokenizer.ReadNext(type, keyword, var)) {
+    if (type == ePdfContentsType_Variant) {
+      operands.push_back(var);
+      continue;
+    }
+    if (type != ePdfContentsType_Keyword) {
+      operands.clear();
+      continue;
+    }
+    string op(keyword);
+    state.Apply(op, operands);
+    const bool isShow = op == "Tj" || op == "TJ" || op == "'" || op == "\"";
+    if (isShow && !operands.empty()) {
+      auto it = fonts.find(state.gs.fontName);
+      if (it != fonts.end()) {
+        TextRun run;
+        Matrix trm = state.TextRenderingMatrix();
+        run.fontSize = std::sqrt(trm.c * trm.c + trm.d * trm.d);
+        run.baseline = trm.f;
+        PdfVariant& operand = operands.back();
+        if (operand.IsArray()) {
+          for (auto& item : operand.GetArray()) {
+            if (item.IsString() || item.IsHexString()) {
+              show(*it->second, item.GetString(), run);
+            } else if (item.IsNumber() || item.IsReal()) {
+              state.Adjust(ContentsState::ToReal(item));
+            }
+          }
+        } else if (operand.IsString() || operand.IsHexString()) {
+          show(*it->second, operand.GetString(), run);
+        }
+        if (!run.glyphs.empty()) {
+          runs.push_back(std::move(run));
+        }
+      }
+    }
+    operands.clear();
+  }
+  return runs;
+}
+
+u32string
+TextExtractor::FromUtf8(const string& in)
+{
+  u32string out;
+  out.reserve(in.size());
+  size_t i = 0;
+  while (i < in.size()) {
+    const auto c = static_cast<unsigned char>(in[i]);
+    char32_t cp;
+    size_t extra;
+    if (c < 0x80) {
+      cp = c;
+      extra = 0;
+    } else if ((c & 0xE0) == 0xC0) {
+      cp = c & 0x1F;
+      extra = 1;
+    } else if ((c & 0xF0) == 0xE0) {
+      cp = c & 0x0F;
+      extra = 2;
+    } else if ((c & 0xF8) == 0xF0) {
+      cp = c & 0x07;
+      extra = 3;
+    } else {
+      ++i;
+      continue;
+    }
+    if (i + extra >= in.size()) {
+      break;
+    }
+    for (size_t j = 1; j <= extra; ++j) {
+      cp = (cp << 6) | (static_cast<unsigned char>(in[i + j]) & 0x3F);
+    }
+    out.push_back(cp);
+    i += extra + 1;
+  }
+  return out;
+}
+
+string
+TextExtractor::ToUtf8(const u32string& in)
+{
+  string out;
+  out.reserve(in.size());
+  for (char32_t cp : in) {
+    if (cp < 0x80) {
+      out.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+      out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+      out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+      out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+      out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+      out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+      out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+      out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+      out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+      out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+  }
+  return out;
+}
+}
@@ -0,0 +1,120 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NPDF_TEXTEXTRACTOR_H
+#define NPDF_TEXTEXTRACTOR_H
+
+#include "ContentsState.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <podofo/podofo.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace NoPoDoFo {
+
+/**
+ * Decodes the bytes of a text showing operand into unicode text and glyph
+ * widths. Widths are read from the font dictionary (/Widths or the CID /W
+ * array) so decoding never has to touch the font metrics once constructed.
+ */
+class FontDecoder
+{
+public:
+  struct Glyph
+  {
+    std::u32string text;
+    double width = 0; // glyph space, 1/1000 of text space
+    bool space = false;
+  };
+
+  FontDecoder(PoDoFo::PdfObject* fontObj, PoDoFo::PdfFont* font);
+  void Decode(const PoDoFo::PdfString&, std::vector<Glyph>& out);
+  // Split a show string into character codes
+  void Codes(const PoDoFo::PdfString&, std::vector<uint32_t>& out) const;
+  bool IsTwoByte() const { return twoByte; }
+  double GetAscent() const { return ascent; }
+  double GetDescent() const { return descent; }
+  double Width(uint32_t code) const;
+
+private:
+  PoDoFo::PdfObject* fontObj;
+  PoDoFo::PdfFont* font;
+  bool twoByte = false;
+  double ascent = 800;
+  double descent = -200;
+  double defaultWidth = 0;
+  std::vector<double> simpleWidths;
+  std::unordered_map<uint32_t, double> cidWidths;
+  std::unordered_map<uint32_t, std::u32string> unicode;
+  std::mutex mutex;
+
+  void ReadSimpleWidths();
+  void ReadCIDWidths(PoDoFo::PdfObject*);
+  void ReadDescriptor(PoDoFo::PdfObject*);
+  std::u32string ToUnicode(uint32_t code);
+};
+
+typedef std::map<std::string, std::shared_ptr<FontDecoder>> FontDecoderMap;
+
+/**
+ * A single glyph placed on the page
+ */
+struct TextGlyph
+{
+  char32_t ch;
+  Box box;
+};
+
+/**
+ * Text shown by a single text showing operator
+ */
+struct TextRun
+{
+  std::vector<TextGlyph> glyphs;
+  double fontSize = 0;
+  double baseline = 0;
+};
+
+/**
+ * Positioned text of a page. Construction reads the page content streams and
+ * resolves the page fonts, and so must happen while the document is not
+ * being modified. Extract only works on the captured data and can run on any
+ * thread.
+ */
+class TextExtractor
+{
+public:
+  TextExtractor(PoDoFo::PdfMemDocument*, PoDoFo::PdfPage*);
+  std::vector<TextRun> Extract();
+  const std::string& GetContents() const { return contents; }
+
+  static void ResolveFonts(PoDoFo::PdfMemDocument*,
+                           PoDoFo::PdfPage*,
+                           FontDecoderMap&);
+  static std::u32string FromUtf8(const std::string&);
+  static std::string ToUtf8(const std::u32string&);
+
+private:
+  std::string contents;
+  FontDecoderMap fonts;
+};
+}
+#endif // NPDF_TEXTEXTRACTOR_H
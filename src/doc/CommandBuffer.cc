@@ -0,0 +1,156 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CommandBuffer.h"
+#include <stdexcept>
+#include <string>
+
+namespace NoPoDoFo {
+
+using namespace PoDoFo;
+
+const uint8_t PaintOpArity[static_cast<size_t>(PaintOp::Count)] = {
+  2, 2, 6, 4, 4, 4, 3, 0, 0, 0, 0, 0, 0, 0, 0,
+  3, 3, 1, 1, 4, 4, 1, 1, 1, 1, 6, 1, 1, 4
+};
+
+void
+ReplayCommands(const uint8_t* ops,
+               size_t opCount,
+               const double* args,
+               size_t argCount,
+               CommandSink& sink)
+{
+  size_t needed = 0;
+  for (size_t i = 0; i < opCount; ++i) {
+    if (ops[i] >= static_cast<uint8_t>(PaintOp::Count)) {
+      throw std::invalid_argument("Unknown paint opcode " +
+                                  std::to_string(ops[i]) + " at " +
+                                  std::to_string(i));
+    }
+    needed += PaintOpArity[ops[i]];
+  }
+  if (needed > argCount) {
+    throw std::invalid_argument("Command buffer needs " +
+                                std::to_string(needed) +
+                                " arguments but received " +
+                                std::to_string(argCount));
+  }
+  for (size_t i = 0; i < opCount; ++i) {
+    sink.Command(static_cast<PaintOp>(ops[i]), args);
+    args += PaintOpArity[ops[i]];
+  }
+}
+
+void
+PainterSink::Command(PaintOp op, const double* a)
+{
+  switch (op) {
+    case PaintOp::MoveTo:
+      painter->MoveTo(a[0], a[1]);
+      break;
+    case PaintOp::LineTo:
+      painter->LineTo(a[0], a[1]);
+      break;
+    case PaintOp::CubicBezierTo:
+      painter->CubicBezierTo(a[0], a[1], a[2], a[3], a[4], a[5]);
+      break;
+    case PaintOp::QuadCurveTo:
+      painter->QuadCurveTo(a[0], a[1], a[2], a[3]);
+      break;
+    case PaintOp::Rectangle:
+      painter->Rectangle(a[0], a[1], a[2], a[3]);
+      break;
+    case PaintOp::Ellipse:
+      painter->Ellipse(a[0], a[1], a[2], a[3]);
+      break;
+    case PaintOp::Circle:
+      painter->Circle(a[0], a[1], a[2]);
+      break;
+    case PaintOp::ClosePath:
+      painter->ClosePath();
+      break;
+    case PaintOp::Stroke:
+      painter->Stroke();
+      break;
+    case PaintOp::Fill:
+      painter->Fill();
+      break;
+    case PaintOp::FillAndStroke:
+      painter->FillAndStroke();
+      break;
+    case PaintOp::EndPath:
+      painter->EndPath();
+      break;
+    case PaintOp::Clip:
+      painter->Clip();
+      break;
+    case PaintOp::Save:
+      painter->Save();
+      break;
+    case PaintOp::Restore:
+      painter->Restore();
+      break;
+    case PaintOp::SetColor:
+      painter->SetColor(a[0], a[1], a[2]);
+      break;
+    case PaintOp::SetStrokingColor:
+      painter->SetStrokingColor(a[0], a[1], a[2]);
+      break;
+    case PaintOp::SetGrey:
+      painter->SetGray(a[0]);
+      break;
+    case PaintOp::SetStrokingGrey:
+      painter->SetStrokingGray(a[0]);
+      break;
+    case PaintOp::SetColorCMYK:
+      painter->SetColorCMYK(a[0], a[1], a[2], a[3]);
+      break;
+    case PaintOp::SetStrokingColorCMYK:
+      painter->SetStrokingColorCMYK(a[0], a[1], a[2], a[3]);
+      break;
+    case PaintOp::SetStrokeWidth:
+      painter->SetStrokeWidth(a[0]);
+      break;
+    case PaintOp::SetLineCapStyle:
+      painter->SetLineCapStyle(static_cast<EPdfLineCapStyle>(a[0]));
+      break;
+    case PaintOp::SetLineJoinStyle:
+      painter->SetLineJoinStyle(static_cast<EPdfLineJoinStyle>(a[0]));
+      break;
+    case PaintOp::SetMiterLimit:
+      painter->SetMiterLimit(a[0]);
+      break;
+    case PaintOp::Transform:
+      painter->SetTransformationMatrix(a[0], a[1], a[2], a[3], a[4], a[5]);
+      break;
+    case PaintOp::HorizontalLineTo:
+      painter->HorizontalLineTo(a[0]);
+      break;
+    case PaintOp::VerticalLineTo:
+      painter->VerticalLineTo(a[0]);
+      break;
+    case PaintOp::DrawLine:
+      painter->DrawLine(a[0], a[1], a[2], a[3]);
+      break;
+    case PaintOp::Count:
+      break;
+  }
+}
+}
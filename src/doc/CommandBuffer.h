@@ -0,0 +1,107 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NPDF_COMMANDBUFFER_H
+#define NPDF_COMMANDBUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <podofo/podofo.h>
+#include <stdexcept>
+
+namespace NoPoDoFo {
+
+/**
+ * Opcodes of a recorded drawing command buffer. The values are shared with
+ * NPDFPaintOp in lib/painter.ts, append new opcodes at the end only.
+ */
+enum class PaintOp : uint8_t
+{
+  MoveTo,               // x y
+  LineTo,               // x y
+  CubicBezierTo,        // x1 y1 x2 y2 x3 y3
+  QuadCurveTo,          // x1 y1 x3 y3
+  Rectangle,            // x y width height
+  Ellipse,              // x y width height
+  Circle,               // x y radius
+  ClosePath,            //
+  Stroke,               //
+  Fill,                 //
+  FillAndStroke,        //
+  EndPath,              //
+  Clip,                 //
+  Save,                 //
+  Restore,              //
+  SetColor,             // r g b, 0.0 - 1.0
+  SetStrokingColor,     // r g b
+  SetGrey,              // grey
+  SetStrokingGrey,      // grey
+  SetColorCMYK,         // c m y k
+  SetStrokingColorCMYK, // c m y k
+  SetStrokeWidth,       // width
+  SetLineCapStyle,      // NPDFLineCapStyle
+  SetLineJoinStyle,     // NPDFLineJoinStyle
+  SetMiterLimit,        // limit
+  Transform,            // a b c d e f
+  HorizontalLineTo,     // x
+  VerticalLineTo,       // y
+  DrawLine,             // x1 y1 x2 y2
+  Count
+};
+
+// Number of arguments each opcode consumes
+extern const uint8_t PaintOpArity[static_cast<size_t>(PaintOp::Count)];
+
+/**
+ * Receives the commands of a buffer one at a time, args points at
+ * PaintOpArity[op] values
+ */
+class CommandSink
+{
+public:
+  virtual ~CommandSink() = default;
+  virtual void Command(PaintOp op, const double* args) = 0;
+};
+
+/**
+ * Replays commands into a PdfPainter
+ */
+class PainterSink : public CommandSink
+{
+public:
+  explicit PainterSink(PoDoFo::PdfPainter* painter)
+    : painter(painter)
+  {}
+  void Command(PaintOp op, const double* args) override;
+
+private:
+  PoDoFo::PdfPainter* painter;
+};
+
+/**
+ * Validates a whole buffer up front, throwing std::invalid_argument for an
+ * unknown opcode or too few arguments, then feeds every command to the sink
+ */
+void
+ReplayCommands(const uint8_t* ops,
+               size_t opCount,
+               const double* args,
+               size_t argCount,
+               CommandSink& sink);
+}
+#endif // NPDF_COMMANDBUFFER_H
@@ -0,0 +1,297 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ContentsWriter.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace NoPoDoFo {
+
+// 4/3 * (sqrt(2) - 1), control point distance of a quarter circle bezier
+static const double Kappa = 0.5522847498;
+
+ContentsWriter::ContentsWriter(unsigned short precision)
+{
+  buffer.reserve(1 << 16);
+  SetPrecision(precision);
+}
+
+void
+ContentsWriter::SetPrecision(unsigned short value)
+{
+  precision = std::min<unsigned short>(value, 9);
+  scaleInt = 1;
+  for (unsigned short i = 0; i < precision; ++i) {
+    scaleInt *= 10;
+  }
+  scale = static_cast<double>(scaleInt);
+}
+
+void
+ContentsWriter::Clear()
+{
+  buffer.clear();
+  x = y = startX = startY = 0;
+}
+
+void
+ContentsWriter::Number(double value)
+{
+  // beyond ~9e15 the scaled value no longer fits exactly, leave those to printf
+  if (!(std::fabs(value) * scale < 9e15)) {
+    char fallback[64];
+    int n = std::snprintf(fallback,
+                          sizeof(fallback),
+                          "%.*f ",
+                          precision,
+                          std::isfinite(value) ? value : 0.0);
+    buffer.append(fallback, static_cast<size_t>(n));
+    return;
+  }
+  long long scaled = std::llround(value * scale);
+  if (scaled < 0) {
+    buffer.push_back('-');
+    scaled = -scaled;
+  }
+  auto integer = static_cast<unsigned long long>(scaled / scaleInt);
+  auto fraction = static_cast<unsigned long long>(scaled % scaleInt);
+  char digits[24];
+  int n = 0;
+  do {
+    digits[n++] = static_cast<char>('0' + integer % 10);
+    integer /= 10;
+  } while (integer);
+  while (n) {
+    buffer.push_back(digits[--n]);
+  }
+  if (fraction) {
+    buffer.push_back('.');
+    int width = precision;
+    while (fraction % 10 == 0) {
+      fraction /= 10;
+      --width;
+    }
+    for (int i = width - 1; i >= 0; --i) {
+      digits[i] = static_cast<char>('0' + fraction % 10);
+      fraction /= 10;
+    }
+    buffer.append(digits, static_cast<size_t>(width));
+  }
+  buffer.push_back(' ');
+}
+
+void
+ContentsWriter::Operator(const char* op)
+{
+  buffer.append(op);
+  buffer.push_back('\n');
+}
+
+void
+ContentsWriter::Ellipse(double left, double bottom, double width, double height)
+{
+  const double rx = width / 2, ry = height / 2;
+  const double cx = left + rx, cy = bottom + ry;
+  const double kx = rx * Kappa, ky = ry * Kappa;
+  Number(cx + rx);
+  Number(cy);
+  Operator("m");
+  const double curves[4][6] = {
+    { cx + rx, cy + ky, cx + kx, cy + ry, cx, cy + ry },
+    { cx - kx, cy + ry, cx - rx, cy + ky, cx - rx, cy },
+    { cx - rx, cy - ky, cx - kx, cy - ry, cx, cy - ry },
+    { cx + kx, cy - ry, cx + rx, cy - ky, cx + rx, cy },
+  };
+  for (auto& curve : curves) {
+    for (double v : curve) {
+      Number(v);
+    }
+    Operator("c");
+  }
+  Operator("h");
+  x = startX = cx + rx;
+  y = startY = cy;
+}
+
+void
+ContentsWriter::Command(PaintOp op, const double* a)
+{
+  switch (op) {
+    case PaintOp::MoveTo:
+      Number(a[0]);
+      Number(a[1]);
+      Operator("m");
+      x = startX = a[0];
+      y = startY = a[1];
+      break;
+    case PaintOp::LineTo:
+      Number(a[0]);
+      Number(a[1]);
+      Operator("l");
+      x = a[0];
+      y = a[1];
+      break;
+    case PaintOp::CubicBezierTo:
+      for (int i = 0; i < 6; ++i) {
+        Number(a[i]);
+      }
+      Operator("c");
+      x = a[4];
+      y = a[5];
+      break;
+    case PaintOp::QuadCurveTo: {
+      // raise the quadratic to a cubic with the same shape
+      const double c1x = x + 2.0 / 3.0 * (a[0] - x);
+      const double c1y = y + 2.0 / 3.0 * (a[1] - y);
+      const double c2x = a[2] + 2.0 / 3.0 * (a[0] - a[2]);
+      const double c2y = a[3] + 2.0 / 3.0 * (a[1] - a[3]);
+      Number(c1x);
+      Number(c1y);
+      Number(c2x);
+      Number(c2y);
+      Number(a[2]);
+      Number(a[3]);
+      Operator("c");
+      x = a[2];
+      y = a[3];
+      break;
+    }
+    case PaintOp::Rectangle:
+      for (int i = 0; i < 4; ++i) {
+        Number(a[i]);
+      }
+      Operator("re");
+      x = startX = a[0];
+      y = startY = a[1];
+      break;
+    case PaintOp::Ellipse:
+      Ellipse(a[0], a[1], a[2], a[3]);
+      break;
+    case PaintOp::Circle:
+      Ellipse(a[0] - a[2], a[1] - a[2], a[2] * 2, a[2] * 2);
+      break;
+    case PaintOp::ClosePath:
+      Operator("h");
+      x = startX;
+      y = startY;
+      break;
+    case PaintOp::Stroke:
+      Operator("S");
+      break;
+    case PaintOp::Fill:
+      Operator("f");
+      break;
+    case PaintOp::FillAndStroke:
+      Operator("B");
+      break;
+    case PaintOp::EndPath:
+      Operator("n");
+      break;
+    case PaintOp::Clip:
+      Operator("W n");
+      break;
+    case PaintOp::Save:
+      Operator("q");
+      break;
+    case PaintOp::Restore:
+      Operator("Q");
+      break;
+    case PaintOp::SetColor:
+      Number(a[0]);
+      Number(a[1]);
+      Number(a[2]);
+      Operator("rg");
+      break;
+    case PaintOp::SetStrokingColor:
+      Number(a[0]);
+      Number(a[1]);
+      Number(a[2]);
+      Operator("RG");
+      break;
+    case PaintOp::SetGrey:
+      Number(a[0]);
+      Operator("g");
+      break;
+    case PaintOp::SetStrokingGrey:
+      Number(a[0]);
+      Operator("G");
+      break;
+    case PaintOp::SetColorCMYK:
+      for (int i = 0; i < 4; ++i) {
+        Number(a[i]);
+      }
+      Operator("k");
+      break;
+    case PaintOp::SetStrokingColorCMYK:
+      for (int i = 0; i < 4; ++i) {
+        Number(a[i]);
+      }
+      Operator("K");
+      break;
+    case PaintOp::SetStrokeWidth:
+      Number(a[0]);
+      Operator("w");
+      break;
+    case PaintOp::SetLineCapStyle:
+      Number(std::floor(a[0]));
+      Operator("J");
+      break;
+    case PaintOp::SetLineJoinStyle:
+      Number(std::floor(a[0]));
+      Operator("j");
+      break;
+    case PaintOp::SetMiterLimit:
+      Number(a[0]);
+      Operator("M");
+      break;
+    case PaintOp::Transform:
+      for (int i = 0; i < 6; ++i) {
+        Number(a[i]);
+      }
+      Operator("cm");
+      break;
+    case PaintOp::HorizontalLineTo:
+      Number(a[0]);
+      Number(y);
+      Operator("l");
+      x = a[0];
+      break;
+    case PaintOp::VerticalLineTo:
+      Number(x);
+      Number(a[0]);
+      Operator("l");
+      y = a[0];
+      break;
+    case PaintOp::DrawLine:
+      Number(a[0]);
+      Number(a[1]);
+      Operator("m");
+      Number(a[2]);
+      Number(a[3]);
+      Operator("l");
+      Operator("S");
+      x = a[2];
+      y = a[3];
+      break;
+    case PaintOp::Count:
+      break;
+  }
+}
+}
@@ -0,0 +1,60 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NPDF_CONTENTSWRITER_H
+#define NPDF_CONTENTSWRITER_H
+
+#include "CommandBuffer.h"
+#include <string>
+
+namespace NoPoDoFo {
+
+/**
+ * Serializes drawing commands straight into content stream syntax. Numbers
+ * are written with a fixed number of decimals by integer arithmetic rather
+ * than through a stream, and the output is a single growable buffer that is
+ * handed to the page canvas in one piece. Holds no document state so writers
+ * for different pages can run concurrently.
+ */
+class ContentsWriter : public CommandSink
+{
+public:
+  explicit ContentsWriter(unsigned short precision = 3);
+  void Command(PaintOp op, const double* args) override;
+
+  void SetPrecision(unsigned short);
+  unsigned short GetPrecision() const { return precision; }
+  void Number(double);
+  void Operator(const char*);
+  void Raw(const char* data, size_t length) { buffer.append(data, length); }
+  const std::string& GetBuffer() const { return buffer; }
+  std::string& GetBuffer() { return buffer; }
+  void Clear();
+
+private:
+  std::string buffer;
+  unsigned short precision;
+  double scale;
+  long long scaleInt;
+  // current point and subpath start, for curves and lines relative to them
+  double x = 0, y = 0, startX = 0, startY = 0;
+
+  void Ellipse(double x, double y, double width, double height);
+};
+}
+#endif // NPDF_CONTENTSWRITER_H
@@ -19,11 +19,19 @@
 
 #include "Document.h"
 #include "../ErrorHandler.h"
+#include "../Parallel.h"
 #include "../ValidateArguments.h"
+#include "../base/ContentsRewriter.h"
+#include "../base/ImageOptimizer.h"
 #include "../base/Obj.h"
 #include "../base/Ref.h"
+#include "../base/SpatialIndex.h"
+#include "../base/TableExtractor.h"
+#include "ContentsWriter.h"
 #include "Font.h"
+#include "FontCache.h"
 #include "Page.h"
+#include "TextSearch.h"
 
 using namespace Napi;
 using namespace PoDoFo;
@@ -60,7 +68,13 @@ Document::Initialize(Napi::Env& env, Napi::Object& target)
                   InstanceMethod("getTrailer", &Document::GetTrailer),
                   InstanceMethod("getCatalog", &Document::GetCatalog),
                   InstanceMethod("isAllowed", &Document::IsAllowed),
-                  InstanceMethod("createFont", &Document::CreateFont) });
+                  InstanceMethod("createFont", &Document::CreateFont),
+                  InstanceMethod("search", &Document::Search),
+                  InstanceMethod("filterContents", &Document::FilterContents),
+                  InstanceMethod("extractTables", &Document::ExtractTables),
+                  InstanceMethod("renderPages", &Document::RenderPages),
+                  InstanceMethod("optimizeImages",
+                                 &Document::OptimizeImages) });
   constructor = Persistent(ctor);
   constructor.SuppressDestruct();
   target.Set("Document", ctor);
@@ -158,9 +172,11 @@ void
 Document::DeletePage(const CallbackInfo& info)
 {
   AssertFunctionArgs(info, 1, { napi_valuetype::napi_number });
+  AssertIdle(info.Env());
   int pageIndex = info[0].As<Number>();
   try {
     document->GetPagesTree()->DeletePage(pageIndex);
+    InvalidateTextIndex();
   } catch (PdfError& err) {
     ErrorHandler(err, info);
   }
@@ -170,6 +186,7 @@ void
 Document::MergeDocument(const CallbackInfo& info)
 {
   AssertFunctionArgs(info, 1, { napi_valuetype::napi_string });
+  AssertIdle(info.Env());
   string docPath = info[0].As<String>().Utf8Value();
   PdfMemDocument mergedDoc;
   try {
@@ -187,6 +204,7 @@ Document::MergeDocument(const CallbackInfo& info)
   }
   try {
     document->Append(mergedDoc);
+    InvalidateTextIndex();
   } catch (PdfError& err) {
     ErrorHandler(err, info);
   }
@@ -421,49 +439,67 @@ Document::IsAllowed(const CallbackInfo& info)
   return Napi::Boolean::New(info.Env(), is);
 }
 
+// Fonts with equal encodings are interchangeable, identity encodings are
+// allocated per font
+static string
+EncodingKey(const PdfEncoding* encoding)
+{
+  if (dynamic_cast<const PdfIdentityEncoding*>(encoding)) {
+    return "Identity";
+  }
+  if (auto simple = dynamic_cast<const PdfSimpleEncoding*>(encoding)) {
+    return simple->GetName().GetName();
+  }
+  return std::to_string(reinterpret_cast<uintptr_t>(encoding));
+}
+
 Value
 Document::CreateFont(const CallbackInfo& info)
 {
   AssertFunctionArgs(info, 1, { napi_valuetype::napi_string });
+  AssertIdle(info.Env());
   auto fontName = info[0].As<String>().Utf8Value();
   bool bold = false;
   bool italic = false;
-  const PdfEncoding* encoding = nullptr;
+  const PdfEncoding* encoding =
+    PdfEncodingFactory::GlobalWinAnsiEncodingInstance();
   bool embed = false;
-  const char* filename = nullptr;
+  string filename;
   if (info.Length() >= 2 && info[1].IsBoolean())
     bold = info[1].As<Boolean>();
   if (info.Length() >= 3 && info[2].IsBoolean())
     italic = info[2].As<Boolean>();
   if (info.Length() >= 4 && info[3].IsNumber()) {
     int n = info[3].As<Number>();
+    // the single byte encodings are process wide singletons, the font only
+    // deletes encodings flagged auto delete (identity)
     switch (n) {
       case 1:
-        encoding = new PdfWinAnsiEncoding();
+        encoding = PdfEncodingFactory::GlobalWinAnsiEncodingInstance();
         break;
       case 2:
-        encoding = new PdfStandardEncoding();
+        encoding = PdfEncodingFactory::GlobalStandardEncodingInstance();
         break;
       case 3:
-        encoding = new PdfDocEncoding();
+        encoding = PdfEncodingFactory::GlobalPdfDocEncodingInstance();
         break;
       case 4:
-        encoding = new PdfMacRomanEncoding();
+        encoding = PdfEncodingFactory::GlobalMacRomanEncodingInstance();
         break;
       case 5:
-        encoding = new PdfMacExpertEncoding();
+        encoding = PdfEncodingFactory::GlobalMacExpertEncodingInstance();
         break;
       case 6:
-        encoding = new PdfSymbolEncoding();
+        encoding = PdfEncodingFactory::GlobalSymbolEncodingInstance();
         break;
       case 7:
-        encoding = new PdfZapfDingbatsEncoding();
+        encoding = PdfEncodingFactory::GlobalZapfDingbatsEncodingInstance();
         break;
       case 8:
-        encoding = new PdfWin1250Encoding();
+        encoding = PdfEncodingFactory::GlobalWin1250EncodingInstance();
         break;
       case 9:
-        encoding = new PdfIso88592Encoding();
+        encoding = PdfEncodingFactory::GlobalIso88592EncodingInstance();
         break;
       default:
         encoding = new PdfIdentityEncoding(0, 0xffff, true);
@@ -472,18 +508,75 @@ Document::CreateFont(const CallbackInfo& info)
   if (info.Length() >= 5 && info[4].IsBoolean())
     embed = info[4].As<Boolean>();
   if (info.Length() >= 6 && info[5].IsString())
-    filename = info[5].As<String>().Utf8Value().c_str();
+    filename = info[5].As<String>().Utf8Value();
+  bool subset = false;
+  if (info.Length() >= 7 && info[6].IsBoolean())
+    subset = info[6].As<Boolean>();
   try {
-    PdfFont* font =
-      document->CreateFont(fontName.c_str(),
-                           bold,
-                           italic,
-                           false,
-                           encoding,
-                           PdfFontCache::eFontCreationFlags_AutoSelectBase14,
-                           embed,
-                           filename);
-    return Font::constructor.New({ External<PdfFont>::New(info.Env(), font) });
+    PdfFont* font = nullptr;
+    std::shared_ptr<const FontFace> face;
+    bool fromData = info.Length() >= 6 && info[5].IsBuffer();
+    if (fromData) {
+      auto data = info[5].As<Buffer<char>>();
+      face = FontCache::Instance().Load(data.Data(), data.Length());
+    } else {
+      // resolved and parsed once per process, shared by every document
+      face = FontCache::Instance().Get(fontName, bold, italic, filename);
+    }
+    if (face && !face->path.empty()) {
+      filename = face->path;
+    }
+    // only CID fonts can be subset, glyphs drawn through PdfPainter and
+    // Font::WriteToStream are recorded and the subset is embedded on write.
+    // PoDoFo subsets from a file only, font data is embedded whole
+    if (!fromData && embed && subset &&
+        dynamic_cast<const PdfIdentityEncoding*>(encoding)) {
+      font = document->CreateFontSubset(fontName.c_str(),
+                                        bold,
+                                        italic,
+                                        false,
+                                        encoding,
+                                        filename.empty() ? nullptr
+                                                         : filename.c_str());
+    } else if (face && !face->base14) {
+      // one font dictionary per document for each face, style and encoding
+      FontKey key(face.get(), bold, italic, EncodingKey(encoding), embed);
+      auto it = fonts.find(key);
+      if (it != fonts.end()) {
+        if (encoding->IsAutoDelete()) {
+          delete encoding;
+        }
+        font = it->second.font.get();
+      } else {
+        font = FontCache::Instance().CreateFont(
+          *face, bold, italic, embed, encoding, document->GetObjects());
+        if (font) {
+          fonts[key] = CachedFont{ face, std::unique_ptr<PdfFont>(font) };
+        }
+      }
+    }
+    if (!font && fromData) {
+      throw Error::New(info.Env(),
+                       "unable to create a font from this data, only "
+                       "TrueType outlines are supported");
+    }
+    if (!font) {
+      font =
+        document->CreateFont(fontName.c_str(),
+                             bold,
+                             italic,
+                             false,
+                             encoding,
+                             PdfFontCache::eFontCreationFlags_AutoSelectBase14,
+                             embed,
+                             filename.empty() ? nullptr : filename.c_str());
+    }
+    auto instance =
+      Font::constructor.New({ External<PdfFont>::New(info.Env(), font) });
+    if (face) {
+      Font::Unwrap(instance)->SetFace(face);
+    }
+    return instance;
   } catch (PdfError& err) {
     ErrorHandler(err, info);
   }
@@ -496,7 +589,9 @@ public:
     : Napi::AsyncWorker(cb)
     , doc(doc)
     , arg(std::move(arg))
-  {}
+  {
+    doc.Acquire();
+  }
 
 private:
   Document& doc;
@@ -507,6 +602,7 @@ protected:
   void Execute() override
   {
     try {
+      std::lock_guard<std::mutex> guard(doc.GetLock());
       PdfOutputDevice device(arg.c_str());
       doc.GetDocument()->Write(&device);
     } catch (PdfError& err) {
@@ -515,9 +611,15 @@ protected:
       SetError(String::New(Env(), ErrorHandler::WriteMsg(err)));
     }
   }
+  void OnError(const Napi::Error& e) override
+  {
+    doc.Release();
+    AsyncWorker::OnError(e);
+  }
   void OnOK() override
   {
     HandleScope scope(Env());
+    doc.Release();
     Callback().Call({ Env().Null(), String::New(Env(), arg) });
   }
 };
@@ -556,7 +658,9 @@ public:
     , doc(doc)
     , arg(std::move(arg))
     , refBuffer(refBuffer)
-  {}
+  {
+    doc.Acquire();
+  }
 
   void ForUpdate(bool v) { update = v; }
   void SetPassword(string v) { pwd = std::move(v); }
@@ -574,6 +678,7 @@ private:
 protected:
   void Execute() override
   {
+    std::lock_guard<std::mutex> guard(doc.GetLock());
     try {
       if (!useBuffer)
         doc.GetDocument()->Load(arg.c_str(), update);
@@ -601,9 +706,19 @@ protected:
       }
     }
   }
+  void OnError(const Napi::Error& e) override
+  {
+    doc.Release();
+    doc.InvalidateTextIndex();
+    AsyncWorker::OnError(e);
+  }
   void OnOK() override
   {
     HandleScope scope(Env());
+    doc.Release();
+    doc.ClearImageCache();
+    doc.ClearFontCache();
+    doc.InvalidateTextIndex();
     Callback().Call({ Env().Null(), String::New(Env(), arg) });
   }
 };
@@ -617,6 +732,7 @@ protected:
 Napi::Value
 Document::Load(const CallbackInfo& info)
 {
+  AssertIdle(info.Env());
   Function cb;
   bool forUpdate, useBuffer = false;
   string source, pwd;
@@ -650,7 +766,9 @@ public:
   DocumentWriteBufferAsync(Function& cb, Document& doc)
     : AsyncWorker(cb)
     , doc(doc)
-  {}
+  {
+    doc.Acquire();
+  }
 
 private:
   Document& doc;
@@ -659,12 +777,19 @@ private:
 protected:
   void Execute() override
   {
+    std::lock_guard<std::mutex> guard(doc.GetLock());
     PdfOutputDevice device(&output);
     doc.GetDocument()->Write(&device);
   }
+  void OnError(const Napi::Error& e) override
+  {
+    doc.Release();
+    AsyncWorker::OnError(e);
+  }
   void OnOK() override
   {
     HandleScope scope(Env());
+    doc.Release();
     if (output.GetSize() == 0) {
       SetError("Error, failed to write to buffer");
     }
@@ -684,6 +809,627 @@ Document::WriteBuffer(const CallbackInfo& info)
   return info.Env().Undefined();
 }
 
+class DocumentSearchAsync : public AsyncWorker
+{
+public:
+  DocumentSearchAsync(Function& cb,
+                      Document& doc,
+                      string query,
+                      SearchOptions options,
+                      bool useIndex,
+                      std::shared_ptr<TextIndex> index)
+    : AsyncWorker(cb)
+    , doc(doc)
+    , query(std::move(query))
+    , options(options)
+    , useIndex(useIndex)
+    , generation(doc.GetTextGeneration())
+    , index(std::move(index))
+  {
+    doc.Acquire();
+  }
+
+private:
+  Document& doc;
+  string query;
+  SearchOptions options;
+  bool useIndex;
+  bool built = false;
+  uint64_t generation;
+  std::shared_ptr<TextIndex> index;
+  vector<PageText> pages;
+  vector<SearchHit> hits;
+
+protected:
+  void Execute() override
+  {
+    try {
+      if (!index) {
+        // reading the contents and resolving the fonts touches the document
+        std::lock_guard<std::mutex> guard(doc.GetLock());
+        PdfMemDocument* pdf = doc.GetDocument();
+        vector<TextExtractor> extractors;
+        for (int i = 0; i < pdf->GetPageCount(); ++i) {
+          extractors.emplace_back(pdf, pdf->GetPage(i));
+        }
+        pages.resize(extractors.size());
+        ParallelFor(extractors.size(), [&](size_t i) {
+          pages[i] = TextSearch::Layout(extractors[i].Extract());
+        });
+        if (useIndex) {
+          index = std::make_shared<TextIndex>(std::move(pages));
+          built = true;
+        }
+      }
+      const vector<PageText>& source = index ? index->GetPages() : pages;
+      const std::u32string needle = TextExtractor::FromUtf8(query);
+      vector<size_t> candidates;
+      if (index && !options.regex) {
+        candidates = index->Candidates(TextSearch::Fold(needle));
+      } else {
+        for (size_t i = 0; i < source.size(); ++i) {
+          candidates.push_back(i);
+        }
+      }
+      vector<vector<SearchHit>> found(candidates.size());
+      ParallelFor(candidates.size(), [&](size_t i) {
+        TextSearch::Find(source[candidates[i]],
+                         needle,
+                         options,
+                         static_cast<int>(candidates[i]),
+                         found[i]);
+      });
+      for (auto& pageHits : found) {
+        std::move(pageHits.begin(), pageHits.end(), std::back_inserter(hits));
+      }
+    } catch (PdfError& err) {
+      SetError(ErrorHandler::WriteMsg(err));
+    } catch (std::exception& err) {
+      SetError(err.what());
+    }
+  }
+  void OnError(const Napi::Error& e) override
+  {
+    doc.Release();
+    AsyncWorker::OnError(e);
+  }
+  void OnOK() override
+  {
+    HandleScope scope(Env());
+    doc.Release();
+    // pages changed since the text was captured, the index is stale
+    if (built && doc.GetTextGeneration() == generation) {
+      doc.SetTextIndex(index);
+    }
+    auto js = Array::New(Env());
+    uint32_t n = 0;
+    for (auto& hit : hits) {
+      auto item = Object::New(Env());
+      item.Set("page", Number::New(Env(), hit.page));
+      item.Set("text", String::New(Env(), hit.text));
+      auto rects = Array::New(Env());
+      uint32_t r = 0;
+      for (auto& box : hit.rects) {
+        auto rect = Object::New(Env());
+        rect.Set("left", Number::New(Env(), box.left));
+        rect.Set("bottom", Number::New(Env(), box.bottom));
+        rect.Set("width", Number::New(Env(), box.right - box.left));
+        rect.Set("height", Number::New(Env(), box.top - box.bottom));
+        rects.Set(r++, rect);
+      }
+      item.Set("rects", rects);
+      js.Set(n++, item);
+    }
+    Callback().Call({ Env().Null(), js });
+  }
+};
+
+/**
+ * @details Javascript parameters: (query: string, regex: boolean, caseFold:
+ * boolean, wholeWord: boolean, index: boolean, cb: Function)
+ */
+Napi::Value
+Document::Search(const CallbackInfo& info)
+{
+  AssertFunctionArgs(info,
+                     6,
+                     { napi_string,
+                       napi_boolean,
+                       napi_boolean,
+                       napi_boolean,
+                       napi_boolean,
+                       napi_function });
+  SearchOptions options;
+  string query = info[0].As<String>().Utf8Value();
+  options.regex = info[1].As<Boolean>();
+  options.caseFold = info[2].As<Boolean>();
+  options.wholeWord = info[3].As<Boolean>();
+  bool useIndex = info[4].As<Boolean>();
+  auto cb = info[5].As<Function>();
+  std::shared_ptr<TextIndex> index = useIndex ? textIndex : nullptr;
+  auto* worker =
+    new DocumentSearchAsync(cb, *this, query, options, useIndex, index);
+  worker->Queue();
+  return info.Env().Undefined();
+}
+
+class DocumentFilterContentsAsync : public AsyncWorker
+{
+public:
+  DocumentFilterContentsAsync(Function& cb,
+                              Document& doc,
+                              vector<int> pageIndices,
+                              std::set<string> operators,
+                              std::set<string> xobjects,
+                              std::unique_ptr<Box> clip)
+    : AsyncWorker(cb)
+    , doc(doc)
+    , pageIndices(std::move(pageIndices))
+    , operators(std::move(operators))
+    , xobjects(std::move(xobjects))
+    , clip(std::move(clip))
+  {
+    doc.Acquire();
+  }
+
+private:
+  Document& doc;
+  vector<int> pageIndices;
+  std::set<string> operators;
+  std::set<string> xobjects;
+  std::unique_ptr<Box> clip;
+
+protected:
+  void Execute() override
+  {
+    try {
+      std::lock_guard<std::mutex> guard(doc.GetLock());
+      PdfMemDocument* pdf = doc.GetDocument();
+      if (pageIndices.empty()) {
+        for (int i = 0; i < pdf->GetPageCount(); ++i) {
+          pageIndices.push_back(i);
+        }
+      }
+      // reading and writing back touch the document and stay serial, only the
+      // rewrite itself runs on the captured bytes in parallel
+      vector<string> contents;
+      for (int index : pageIndices) {
+        if (index < 0 || index >= pdf->GetPageCount()) {
+          SetError("Page index out of range");
+          return;
+        }
+        contents.push_back(ContentsState::ReadContents(pdf->GetPage(index)));
+      }
+      ParallelFor(contents.size(), [&](size_t i) {
+        ContentsRewriter rewriter(std::move(contents[i]));
+        if (!operators.empty()) {
+          rewriter.AddFilter(std::make_shared<OperatorFilter>(operators));
+        }
+        if (!xobjects.empty()) {
+          rewriter.AddFilter(std::make_shared<XObjectFilter>(xobjects));
+        }
+        if (clip) {
+          rewriter.AddFilter(std::make_shared<ClipFilter>(*clip));
+        }
+        contents[i] = rewriter.Run();
+      });
+      vector<PdfReference> dropped;
+      for (size_t i = 0; i < contents.size(); ++i) {
+        vector<PdfReference> refs = ContentsState::WriteContents(
+          pdf->GetPage(pageIndices[i]), contents[i].data(), contents[i].size());
+        dropped.insert(dropped.end(), refs.begin(), refs.end());
+      }
+      ContentsState::RemoveUnreferenced(pdf, dropped);
+    } catch (PdfError& err) {
+      SetError(ErrorHandler::WriteMsg(err));
+    } catch (std::exception& err) {
+      SetError(err.what());
+    }
+  }
+  void OnError(const Napi::Error& e) override
+  {
+    doc.Release();
+    AsyncWorker::OnError(e);
+  }
+  void OnOK() override
+  {
+    HandleScope scope(Env());
+    doc.Release();
+    doc.InvalidateTextIndex();
+    Callback().Call({ Env().Null(), Number::New(Env(), pageIndices.size()) });
+  }
+};
+
+/**
+ * @details Javascript parameters: (pages: number[], operators: string[],
+ * xobjects: string[], clip: number[], cb: Function)
+ * An empty pages array rewrites every page, clip is either empty or
+ * [left, bottom, width, height].
+ */
+Napi::Value
+Document::FilterContents(const CallbackInfo& info)
+{
+  AssertFunctionArgs(info,
+                     5,
+                     { napi_object,
+                       napi_object,
+                       napi_object,
+                       napi_object,
+                       napi_function });
+  vector<int> pageIndices;
+  std::set<string> operators;
+  std::set<string> xobjects;
+  std::unique_ptr<Box> clip;
+  auto pages = info[0].As<Array>();
+  for (uint32_t i = 0; i < pages.Length(); ++i) {
+    pageIndices.push_back(pages.Get(i).As<Number>());
+  }
+  auto ops = info[1].As<Array>();
+  for (uint32_t i = 0; i < ops.Length(); ++i) {
+    operators.insert(ops.Get(i).As<String>().Utf8Value());
+  }
+  auto names = info[2].As<Array>();
+  for (uint32_t i = 0; i < names.Length(); ++i) {
+    xobjects.insert(names.Get(i).As<String>().Utf8Value());
+  }
+  auto rect = info[3].As<Array>();
+  if (rect.Length() == 4) {
+    double left = rect.Get(0u).As<Number>();
+    double bottom = rect.Get(1u).As<Number>();
+    double width = rect.Get(2u).As<Number>();
+    double height = rect.Get(3u).As<Number>();
+    clip.reset(new Box{ left, bottom, left + width, bottom + height });
+  } else if (rect.Length() != 0) {
+    throw Error::New(info.Env(), "clip must be [left, bottom, width, height]");
+  }
+  auto cb = info[4].As<Function>();
+  auto* worker = new DocumentFilterContentsAsync(
+    cb, *this, pageIndices, operators, xobjects, std::move(clip));
+  worker->Queue();
+  return info.Env().Undefined();
+}
+
+class DocumentExtractTablesAsync : public AsyncWorker
+{
+public:
+  DocumentExtractTablesAsync(Function& cb, Document& doc, vector<int> pageIndices)
+    : AsyncWorker(cb)
+    , doc(doc)
+    , pageIndices(std::move(pageIndices))
+  {
+    doc.Acquire();
+  }
+
+private:
+  Document& doc;
+  vector<int> pageIndices;
+  vector<vector<ExtractedTable>> tables;
+
+protected:
+  void Execute() override
+  {
+    try {
+      std::lock_guard<std::mutex> guard(doc.GetLock());
+      PdfMemDocument* pdf = doc.GetDocument();
+      if (pageIndices.empty()) {
+        for (int i = 0; i < pdf->GetPageCount(); ++i) {
+          pageIndices.push_back(i);
+        }
+      }
+      vector<TableExtractor> extractors;
+      for (int index : pageIndices) {
+        if (index < 0 || index >= pdf->GetPageCount()) {
+          SetError("Page index out of range");
+          return;
+        }
+        extractors.emplace_back(pdf, pdf->GetPage(index));
+      }
+      tables.resize(extractors.size());
+      ParallelFor(extractors.size(),
+                  [&](size_t i) { tables[i] = extractors[i].Extract(); });
+    } catch (PdfError& err) {
+      SetError(ErrorHandler::WriteMsg(err));
+    } catch (std::exception& err) {
+      SetError(err.what());
+    }
+  }
+  void OnError(const Napi::Error& e) override
+  {
+    doc.Release();
+    AsyncWorker::OnError(e);
+  }
+  void OnOK() override
+  {
+    HandleScope scope(Env());
+    doc.Release();
+    auto js = Array::New(Env());
+    uint32_t n = 0;
+    for (size_t i = 0; i < tables.size(); ++i) {
+      for (auto& table : tables[i]) {
+        auto item = Object::New(Env());
+        item.Set("page", Number::New(Env(), pageIndices[i]));
+        item.Set("left", Number::New(Env(), table.box.left));
+        item.Set("bottom", Number::New(Env(), table.box.bottom));
+        item.Set("width", Number::New(Env(), table.box.right - table.box.left));
+        item.Set("height", Number::New(Env(), table.box.top - table.box.bottom));
+        auto columns = Array::New(Env());
+        for (uint32_t c = 0; c < table.columns.size(); ++c) {
+          columns.Set(c, Number::New(Env(), table.columns[c]));
+        }
+        item.Set("columns", columns);
+        auto rowEdges = Array::New(Env());
+        for (uint32_t r = 0; r < table.rows.size(); ++r) {
+          rowEdges.Set(r, Number::New(Env(), table.rows[r]));
+        }
+        item.Set("rowEdges", rowEdges);
+        auto rows = Array::New(Env());
+        for (uint32_t r = 0; r < table.cells.size(); ++r) {
+          auto row = Array::New(Env());
+          for (uint32_t c = 0; c < table.cells[r].size(); ++c) {
+            row.Set(c, String::New(Env(), table.cells[r][c]));
+          }
+          rows.Set(r, row);
+        }
+        item.Set("rows", rows);
+        js.Set(n++, item);
+      }
+    }
+    Callback().Call({ Env().Null(), js });
+  }
+};
+
+/**
+ * @details Javascript parameters: (pages: number[], cb: Function)
+ * An empty pages array scans every page.
+ */
+Napi::Value
+Document::ExtractTables(const CallbackInfo& info)
+{
+  AssertFunctionArgs(info, 2, { napi_object, napi_function });
+  vector<int> pageIndices;
+  auto pages = info[0].As<Array>();
+  for (uint32_t i = 0; i < pages.Length(); ++i) {
+    pageIndices.push_back(pages.Get(i).As<Number>());
+  }
+  auto cb = info[1].As<Function>();
+  auto* worker = new DocumentExtractTablesAsync(cb, *this, pageIndices);
+  worker->Queue();
+  return info.Env().Undefined();
+}
+
+class DocumentOptimizeImagesAsync : public AsyncWorker
+{
+public:
+  DocumentOptimizeImagesAsync(Function& cb,
+                              Document& doc,
+                              ImageOptimizerOptions options)
+    : AsyncWorker(cb)
+    , doc(doc)
+    , options(options)
+  {
+    doc.Acquire();
+  }
+
+private:
+  Document& doc;
+  ImageOptimizerOptions options;
+  ImageOptimizerResult result;
+
+protected:
+  void Execute() override
+  {
+    try {
+      std::lock_guard<std::mutex> guard(doc.GetLock());
+      ImageOptimizer optimizer(doc.GetDocument(), options);
+      result = optimizer.Run();
+    } catch (PdfError& err) {
+      SetError(ErrorHandler::WriteMsg(err));
+    } catch (std::exception& err) {
+      SetError(err.what());
+    }
+  }
+  void OnError(const Napi::Error& e) override
+  {
+    doc.Release();
+    AsyncWorker::OnError(e);
+  }
+  void OnOK() override
+  {
+    HandleScope scope(Env());
+    doc.Release();
+    auto js = Object::New(Env());
+    js.Set("images", Number::New(Env(), result.images));
+    js.Set("optimized", Number::New(Env(), result.optimized));
+    js.Set("bytesBefore", Number::New(Env(), result.bytesBefore));
+    js.Set("bytesAfter", Number::New(Env(), result.bytesAfter));
+    Callback().Call({ Env().Null(), js });
+  }
+};
+
+/**
+ * @details Javascript parameters: (maxDpi: number, jpegQuality: number,
+ * grayscaleDetect: boolean, cb: Function)
+ * A maxDpi of 0 disables downsampling.
+ */
+Napi::Value
+Document::OptimizeImages(const CallbackInfo& info)
+{
+  AssertFunctionArgs(
+    info, 4, { napi_number, napi_number, napi_boolean, napi_function });
+  ImageOptimizerOptions options;
+  options.maxDpi = info[0].As<Number>();
+  options.jpegQuality = info[1].As<Number>();
+  options.grayscaleDetect = info[2].As<Boolean>();
+  if (options.jpegQuality < 0 || options.jpegQuality > 100) {
+    throw Napi::Error::New(info.Env(), "jpegQuality must be 0 - 100");
+  }
+  auto cb = info[3].As<Function>();
+  auto* worker = new DocumentOptimizeImagesAsync(cb, *this, options);
+  worker->Queue();
+  return info.Env().Undefined();
+}
+
+struct RenderJob
+{
+  int page;
+  std::vector<uint8_t> ops;
+  std::vector<double> args;
+};
+
+class DocumentRenderPagesAsync : public AsyncWorker
+{
+public:
+  DocumentRenderPagesAsync(Function& cb,
+                           Document& doc,
+                           vector<RenderJob> jobs,
+                           unsigned short precision)
+    : AsyncWorker(cb)
+    , doc(doc)
+    , jobs(std::move(jobs))
+    , precision(precision)
+  {
+    doc.Acquire();
+  }
+
+private:
+  Document& doc;
+  vector<RenderJob> jobs;
+  unsigned short precision;
+
+protected:
+  void Execute() override
+  {
+    try {
+      std::lock_guard<std::mutex> guard(doc.GetLock());
+      PdfMemDocument* pdf = doc.GetDocument();
+      for (auto& job : jobs) {
+        if (job.page < 0 || job.page >= pdf->GetPageCount()) {
+          SetError("Page index out of range");
+          return;
+        }
+      }
+      // serialization only touches the command buffers and runs in parallel,
+      // the streams are attached to the pages in order afterwards
+      vector<string> contents(jobs.size());
+      ParallelFor(jobs.size(), [&](size_t i) {
+        ContentsWriter writer(precision);
+        ReplayCommands(jobs[i].ops.data(),
+                       jobs[i].ops.size(),
+                       jobs[i].args.data(),
+                       jobs[i].args.size(),
+                       writer);
+        contents[i] = std::move(writer.GetBuffer());
+      });
+      for (size_t i = 0; i < jobs.size(); ++i) {
+        ContentsState::AppendContents(
+          pdf->GetPage(jobs[i].page), contents[i].data(), contents[i].size());
+      }
+    } catch (PdfError& err) {
+      SetError(ErrorHandler::WriteMsg(err));
+    } catch (std::exception& err) {
+      SetError(err.what());
+    }
+  }
+  void OnError(const Napi::Error& e) override
+  {
+    doc.Release();
+    AsyncWorker::OnError(e);
+  }
+  void OnOK() override
+  {
+    HandleScope scope(Env());
+    doc.Release();
+    doc.InvalidateTextIndex();
+    Callback().Call({ Env().Null(), Number::New(Env(), jobs.size()) });
+  }
+};
+
+/**
+ * @details Javascript parameters: (pages: number[], opcodes: Uint8Array[],
+ * args: Float64Array[], precision: number, cb: Function)
+ * The buffers are copied before returning so the caller may reuse them.
+ */
+Napi::Value
+Document::RenderPages(const CallbackInfo& info)
+{
+  AssertFunctionArgs(
+    info,
+    5,
+    { napi_object, napi_object, napi_object, napi_number, napi_function });
+  auto pages = info[0].As<Array>();
+  auto ops = info[1].As<Array>();
+  auto args = info[2].As<Array>();
+  if (ops.Length() != pages.Length() || args.Length() != pages.Length()) {
+    throw Error::New(info.Env(), "pages, opcodes and args lengths differ");
+  }
+  vector<RenderJob> jobs(pages.Length());
+  for (uint32_t i = 0; i < pages.Length(); ++i) {
+    Napi::Value op = ops.Get(i);
+    Napi::Value arg = args.Get(i);
+    if (!op.IsTypedArray() ||
+        op.As<TypedArray>().TypedArrayType() != napi_uint8_array ||
+        !arg.IsTypedArray() ||
+        arg.As<TypedArray>().TypedArrayType() != napi_float64_array) {
+      throw TypeError::New(info.Env(),
+                           "each page requires a Uint8Array of opcodes and a "
+                           "Float64Array of args");
+    }
+    auto opArray = op.As<Uint8Array>();
+    auto argArray = arg.As<Float64Array>();
+    jobs[i].page = pages.Get(i).As<Number>();
+    jobs[i].ops.assign(opArray.Data(),
+                       opArray.Data() + opArray.ElementLength());
+    jobs[i].args.assign(argArray.Data(),
+                        argArray.Data() + argArray.ElementLength());
+  }
+  auto precision =
+    static_cast<unsigned short>(info[3].As<Number>().Uint32Value());
+  auto cb = info[4].As<Function>();
+  auto* worker =
+    new DocumentRenderPagesAsync(cb, *this, std::move(jobs), precision);
+  worker->Queue();
+  return info.Env().Undefined();
+}
+
+void
+Document::AssertIdle(Napi::Env env)
+{
+  if (workers > 0) {
+    throw Error::New(env, "Document is busy with an asynchronous operation");
+  }
+}
+
+std::shared_ptr<SpatialIndex>
+Document::GetSpatialIndex(PdfPage* page, bool create)
+{
+  const PdfReference& ref = page->GetObject()->Reference();
+  auto it = spatialIndices.find(ref);
+  if (it != spatialIndices.end()) {
+    return it->second;
+  }
+  if (!create) {
+    return nullptr;
+  }
+  auto index = std::make_shared<SpatialIndex>(page);
+  spatialIndices[ref] = index;
+  return index;
+}
+
+PdfObject*
+Document::GetCachedImage(const string& hash)
+{
+  std::lock_guard<std::mutex> guard(imagesLock);
+  auto it = images.find(hash);
+  if (it == images.end()) {
+    return nullptr;
+  }
+  PdfObject* image = document->GetObjects().GetObject(it->second);
+  if (!image) {
+    images.erase(it);
+  }
+  return image;
+}
+
 class GCAsync : public AsyncWorker
 {
 public:
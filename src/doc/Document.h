@@ -20,10 +20,20 @@
 #ifndef NPDF_DOCUMENT_H
 #define NPDF_DOCUMENT_H
 
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <napi.h>
 #include <podofo/podofo.h>
+#include <string>
+#include <tuple>
+#include <vector>
 
 namespace NoPoDoFo {
+class TextIndex;
+class SpatialIndex;
+struct FontFace;
 class Document : public Napi::ObjectWrap<Document>
 {
 public:
@@ -49,14 +59,82 @@ public:
   Napi::Value GetCatalog(const Napi::CallbackInfo&);
   Napi::Value IsAllowed(const Napi::CallbackInfo&);
   Napi::Value CreateFont(const Napi::CallbackInfo&);
+  Napi::Value Search(const Napi::CallbackInfo&);
+  Napi::Value FilterContents(const Napi::CallbackInfo&);
+  Napi::Value ExtractTables(const Napi::CallbackInfo&);
+  Napi::Value RenderPages(const Napi::CallbackInfo&);
+  Napi::Value OptimizeImages(const Napi::CallbackInfo&);
   static Napi::Value GC(const Napi::CallbackInfo&);
 
   PoDoFo::PdfMemDocument* GetDocument() { return document; }
+  // Held by workers that read or modify the document off the main thread
+  std::mutex& GetLock() { return lock; }
+  // Counts the workers queued on the document, taken when a worker is
+  // created and released once it completes
+  void Acquire() { ++workers; }
+  void Release() { --workers; }
+  // Throws while a worker holds the document, guards the main thread calls
+  // that modify it
+  void AssertIdle(Napi::Env);
   bool LoadedForIncrementalUpdates() { return loadForIncrementalUpdates; }
+  std::shared_ptr<TextIndex> GetTextIndex() { return textIndex; }
+  void SetTextIndex(std::shared_ptr<TextIndex> index) { textIndex = index; }
+  // Per page index of annotations, only built when create is set
+  std::shared_ptr<SpatialIndex> GetSpatialIndex(PoDoFo::PdfPage*, bool create);
+  // Drop the search and spatial indices, call whenever page content changes
+  void InvalidateTextIndex()
+  {
+    textIndex.reset();
+    spatialIndices.clear();
+    ++textGeneration;
+  }
+  // Changes on every InvalidateTextIndex, an index built from text captured
+  // under an older generation is stale
+  uint64_t GetTextGeneration() const { return textGeneration; }
+  // Image XObject already embedded from a source with this hash, or null
+  PoDoFo::PdfObject* GetCachedImage(const std::string& hash);
+  void CacheImage(const std::string& hash, const PoDoFo::PdfReference& ref)
+  {
+    std::lock_guard<std::mutex> guard(imagesLock);
+    images[hash] = ref;
+  }
+  void ClearImageCache()
+  {
+    std::lock_guard<std::mutex> guard(imagesLock);
+    images.clear();
+  }
+  // Fonts created from cached faces belong to the contents they were created
+  // in, a reload stops handing them out (Font instances may still use them)
+  void ClearFontCache()
+  {
+    for (auto& item : fonts) {
+      retiredFonts.push_back(std::move(item.second.font));
+    }
+    fonts.clear();
+  }
 
 private:
   bool loadForIncrementalUpdates = false;
   PoDoFo::PdfMemDocument* document;
+  std::mutex lock;
+  // only touched on the main thread, see Acquire
+  int workers = 0;
+  std::shared_ptr<TextIndex> textIndex;
+  uint64_t textGeneration = 0;
+  std::map<PoDoFo::PdfReference, std::shared_ptr<SpatialIndex>> spatialIndices;
+  // images are also looked up from load workers
+  std::mutex imagesLock;
+  std::map<std::string, PoDoFo::PdfReference> images;
+  // fonts created from a FontCache face, keyed by (face, bold, italic,
+  // encoding, embed), the face is kept so its address stays unique
+  struct CachedFont
+  {
+    std::shared_ptr<const FontFace> face;
+    std::unique_ptr<PoDoFo::PdfFont> font;
+  };
+  typedef std::tuple<const FontFace*, bool, bool, std::string, bool> FontKey;
+  std::map<FontKey, CachedFont> fonts;
+  std::vector<std::unique_ptr<PoDoFo::PdfFont>> retiredFonts;
 };
 }
 #endif // NPDF_PDFMEMDOCUMENT_H
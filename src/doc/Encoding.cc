@@ -24,6 +24,8 @@
 #include "../ValidateArguments.h"
 #include "../base/Dictionary.h"
 #include "Font.h"
+#include <map>
+#include <mutex>
 
 namespace NoPoDoFo {
 
@@ -39,6 +41,101 @@ Encoding::Encoding(const Napi::CallbackInfo& info)
 {
   AssertFunctionArgs(info, 1, { napi_valuetype::napi_external });
   encoding = info[0].As<External<PdfEncoding>>().Data();
+  table = SingleByteTable::Get(encoding);
+}
+
+// PoDoFo keeps UTF-16 in big endian order, swaps to and from host order
+static char16_t
+SwapBigEndian(char16_t c)
+{
+#ifdef PODOFO_IS_LITTLE_ENDIAN
+  return static_cast<char16_t>(((c & 0xff00) >> 8) | ((c & 0xff) << 8));
+#else
+  return c;
+#endif
+}
+
+std::shared_ptr<const SingleByteTable>
+SingleByteTable::Get(const PdfEncoding* encoding)
+{
+  auto simple = dynamic_cast<const PdfSimpleEncoding*>(encoding);
+  if (!simple) {
+    return nullptr;
+  }
+  // keyed by name, fonts may own their own instance of the same encoding
+  static std::mutex lock;
+  static std::map<string, std::shared_ptr<const SingleByteTable>> tables;
+  std::lock_guard<std::mutex> guard(lock);
+  string name = simple->GetName().GetName();
+  auto it = tables.find(name);
+  if (it != tables.end()) {
+    return it->second;
+  }
+  auto table = std::make_shared<SingleByteTable>();
+  table->fromUnicode.assign(0x10000, -1);
+  for (int i = 0; i < 256; ++i) {
+    char16_t c = 0;
+    if (i >= simple->GetFirstChar() && i <= simple->GetLastChar()) {
+      c = SwapBigEndian(static_cast<char16_t>(simple->GetCharCode(i)));
+    }
+    table->toUnicode[i] = c;
+    if ((c || i == 0) && table->fromUnicode[c] < 0) {
+      table->fromUnicode[c] = static_cast<int16_t>(i);
+    }
+  }
+  tables.emplace(name, table);
+  return table;
+}
+
+/**
+ * Code units the encoding can not represent are left out
+ */
+string
+Encoding::Encode(const std::u16string& text, PdfFont* font)
+{
+  string out;
+  if (table) {
+    out.resize(text.size());
+    size_t n = 0;
+    for (char16_t c : text) {
+      int16_t b = table->fromUnicode[c];
+      if (b >= 0) {
+        out[n++] = static_cast<char>(b);
+      }
+    }
+    out.resize(n);
+    return out;
+  }
+  std::u16string copy(text);
+  for (char16_t& c : copy) {
+    c = SwapBigEndian(c);
+  }
+  PdfString unicode(reinterpret_cast<const pdf_utf16be*>(copy.data()),
+                    static_cast<pdf_long>(copy.size()));
+  PdfRefCountedBuffer buffer = encoding->ConvertToEncoding(unicode, font);
+  out.assign(buffer.GetBuffer(), buffer.GetSize());
+  return out;
+}
+
+std::u16string
+Encoding::Decode(const char* data, size_t length, PdfFont* font)
+{
+  std::u16string out;
+  if (table) {
+    out.resize(length);
+    for (size_t i = 0; i < length; ++i) {
+      out[i] = table->toUnicode[static_cast<unsigned char>(data[i])];
+    }
+    return out;
+  }
+  PdfString encoded(data, static_cast<pdf_long>(length));
+  PdfString unicode = encoding->ConvertToUnicode(encoded, font);
+  const pdf_utf16be* units = unicode.GetUnicode();
+  out.resize(static_cast<size_t>(unicode.GetUnicodeLength()));
+  for (size_t i = 0; i < out.size(); ++i) {
+    out[i] = SwapBigEndian(static_cast<char16_t>(units[i]));
+  }
+  return out;
 }
 void
 Encoding::Initialize(Napi::Env& env, Napi::Object& target)
@@ -65,38 +162,102 @@ Encoding::AddToDictionary(const Napi::CallbackInfo& info)
   encoding->AddToDictionary(dict);
   return info.Env().Undefined();
 }
+static PdfFont*
+OptionalFont(const Napi::CallbackInfo& info)
+{
+  if (info.Length() < 2 || !info[1].IsObject()) {
+    return nullptr;
+  }
+  return Font::Unwrap(info[1].As<Object>())->GetPoDoFoFont();
+}
+
+/**
+ * @details Javascript parameters: (content: Buffer | string | Array, font?:
+ * Font). Encoded bytes to a string, arrays are converted element by element.
+ * Strings are taken as one byte per code unit. Single byte encodings are
+ * decoded from a table and need no font.
+ */
 Napi::Value
 Encoding::ConvertToUnicode(const Napi::CallbackInfo& info)
 {
-  AssertFunctionArgs(
-    info, 2, { napi_valuetype::napi_string, napi_valuetype::napi_object });
-  string content = info[0].As<String>().Utf8Value();
-  Font* font = Font::Unwrap(info[1].As<Object>());
-  PdfString buffer =
-    encoding->ConvertToUnicode(PdfString(content), font->GetPoDoFoFont());
-  return String::New(info.Env(), buffer.GetStringUtf8());
+  if (info.Length() < 1) {
+    throw TypeError::New(info.Env(), "content is required");
+  }
+  PdfFont* font = OptionalFont(info);
+  if (!table && !font) {
+    throw Error::New(info.Env(), "a font is required for this encoding");
+  }
+  auto decode = [&](const Napi::Value& value) -> Napi::Value {
+    std::u16string text;
+    if (value.IsBuffer()) {
+      auto bytes = value.As<Buffer<char>>();
+      text = Decode(bytes.Data(), bytes.Length(), font);
+    } else if (value.IsString()) {
+      std::u16string units = value.As<String>().Utf16Value();
+      string bytes(units.begin(), units.end());
+      text = Decode(bytes.data(), bytes.size(), font);
+    } else {
+      throw TypeError::New(info.Env(), "content must be a Buffer or string");
+    }
+    return String::New(info.Env(), text);
+  };
+  try {
+    if (info[0].IsArray()) {
+      auto items = info[0].As<Array>();
+      auto out = Array::New(info.Env(), items.Length());
+      for (uint32_t i = 0; i < items.Length(); ++i) {
+        out.Set(i, decode(items.Get(i)));
+      }
+      return out;
+    }
+    return decode(info[0]);
+  } catch (PdfError& err) {
+    ErrorHandler(err, info);
+  }
+  return info.Env().Undefined();
 }
+
+/**
+ * @details Javascript parameters: (content: string | Array<string>, font?:
+ * Font). Returns the encoded bytes as a Buffer, or an array of Buffers.
+ * Single byte encodings encode from a table and need no font.
+ */
 Napi::Value
 Encoding::ConvertToEncoding(const Napi::CallbackInfo& info)
 {
-  AssertFunctionArgs(
-    info, 2, { napi_valuetype::napi_string, napi_valuetype::napi_object });
-  string content = info[0].As<String>().Utf8Value();
-  Font* font = Font::Unwrap(info[1].As<Object>());
-  PdfRefCountedBuffer buffer =
-    encoding->ConvertToEncoding(PdfString(content), font->GetPoDoFoFont());
-  return String::New(info.Env(), buffer.GetBuffer());
+  if (info.Length() < 1) {
+    throw TypeError::New(info.Env(), "content is required");
+  }
+  PdfFont* font = OptionalFont(info);
+  if (!table && !font) {
+    throw Error::New(info.Env(), "a font is required for this encoding");
+  }
+  auto encode = [&](const Napi::Value& value) -> Napi::Value {
+    if (!value.IsString()) {
+      throw TypeError::New(info.Env(), "content must be a string");
+    }
+    string bytes = Encode(value.As<String>().Utf16Value(), font);
+    return Buffer<char>::Copy(info.Env(), bytes.data(), bytes.size());
+  };
+  try {
+    if (info[0].IsArray()) {
+      auto items = info[0].As<Array>();
+      auto out = Array::New(info.Env(), items.Length());
+      for (uint32_t i = 0; i < items.Length(); ++i) {
+        out.Set(i, encode(items.Get(i)));
+      }
+      return out;
+    }
+    return encode(info[0]);
+  } catch (PdfError& err) {
+    ErrorHandler(err, info);
+  }
+  return info.Env().Undefined();
 }
 Napi::Value
 Encoding::GetData(const Napi::CallbackInfo& info)
 {
   return info.Env().Undefined();
 }
-Encoding::~Encoding()
-{
-  if (encoding != nullptr) {
-    HandleScope scope(Env());
-    delete encoding;
-  }
-}
+Encoding::~Encoding() = default;
 }
@@ -22,10 +22,28 @@
 #ifndef NPDF_ENCODING_H
 #define NPDF_ENCODING_H
 
+#include <memory>
 #include <napi.h>
 #include <podofo/podofo.h>
+#include <string>
+#include <vector>
 
 namespace NoPoDoFo {
+
+/**
+ * Both directions of a single byte encoding as lookup tables, built once per
+ * encoding name and shared by the process
+ */
+struct SingleByteTable
+{
+  char16_t toUnicode[256];
+  // byte for every UTF-16 code unit, -1 when the encoding has none
+  std::vector<int16_t> fromUnicode;
+
+  static std::shared_ptr<const SingleByteTable> Get(
+    const PoDoFo::PdfEncoding*);
+};
+
 class Encoding: public Napi::ObjectWrap<Encoding> {
 public:
   explicit Encoding(const Napi::CallbackInfo &callbackInfo);
@@ -38,7 +56,13 @@ public:
   Napi::Value GetData(const Napi::CallbackInfo &);
 
 private:
+  // owned by the font (or PoDoFo's encoding factory), never deleted here
   PoDoFo::PdfEncoding *encoding;
+  // null unless encoding is a simple (single byte) encoding
+  std::shared_ptr<const SingleByteTable> table;
+
+  std::string Encode(const std::u16string&, PoDoFo::PdfFont*);
+  std::u16string Decode(const char*, size_t, PoDoFo::PdfFont*);
 };
 }
 #endif //NPDF_ENCODING_H
@@ -22,6 +22,7 @@
 #include "../ValidateArguments.h"
 #include "../base/Stream.h"
 #include "Encoding.h"
+#include "TextLayout.h"
 
 
 namespace NoPoDoFo {
@@ -56,12 +57,15 @@ Font::Initialize(Napi::Env& env, Napi::Object& target)
       InstanceAccessor("strikeOut", &Font::IsStrikeOut, &Font::SetStrikeOut),
       InstanceMethod("isBold", &Font::IsBold),
       InstanceMethod("isItalic", &Font::IsItalic),
+      InstanceMethod("isSubsetting", &Font::IsSubsetting),
       InstanceMethod("getIdentifier", &Font::GetIdentifier),
       InstanceMethod("getMetrics", &Font::GetFontMetric),
       InstanceMethod("getEncoding", &Font::GetEncoding),
       InstanceMethod("write", &Font::WriteToStream),
       InstanceMethod("embed", &Font::EmbedFont),
-      InstanceMethod("stringWidth", &Font::StringWidth) });
+      InstanceMethod("stringWidth", &Font::StringWidth),
+      InstanceMethod("measure", &Font::Measure),
+      InstanceMethod("shape", &Font::Shape) });
   constructor = Persistent(ctor);
   constructor.SuppressDestruct();
   target.Set("Font", ctor);
@@ -171,7 +175,12 @@ Font::GetFontMetric(const Napi::CallbackInfo& info)
           Number::New(info.Env(), metrics->GetStrikeOutPosition()));
   obj.Set("strikeOutThickness",
           Number::New(info.Env(), metrics->GetStrikeoutThickness()));
-  obj.Set("fileName", String::New(info.Env(), metrics->GetFilename()));
+  // fonts made from cached bytes have no file name of their own
+  string file = metrics->GetFilename() ? metrics->GetFilename() : "";
+  if (file.empty() && face) {
+    file = face->path;
+  }
+  obj.Set("fileName", String::New(info.Env(), file));
   //  obj.Set("fontData", String::New(info.Env(), metrics->GetFontData()));
   obj.Set("fontName", String::New(info.Env(), metrics->GetFontname()));
   obj.Set("fontWeight", Number::New(info.Env(), metrics->GetWeight()));
@@ -189,6 +198,12 @@ Font::GetFontMetric(const Napi::CallbackInfo& info)
   //    obj.Set("fontType", metrics->GetFontType());
   return obj;
 }
+Napi::Value
+Font::IsSubsetting(const Napi::CallbackInfo& info)
+{
+  return Boolean::New(info.Env(), font->IsSubsetting());
+}
+
 Napi::Value
 Font::IsBold(const Napi::CallbackInfo& info)
 {
@@ -207,6 +222,138 @@ Font::StringWidth(const CallbackInfo& info)
   string text = info[0].As<String>().Utf8Value();
   return Number::New(info.Env(), font->GetFontMetrics()->StringWidth(text));
 }
+/**
+ * Width of every string in the array at the font's size and spacing, or the
+ * size, charSpace and wordSpace given in the options. All strings are looked
+ * up in the advance cache under one lock, then summed per string.
+ */
+Napi::Value
+Font::Measure(const CallbackInfo& info)
+{
+  AssertFunctionArgs(info, 1, { napi_object });
+  const auto strings = info[0].As<Array>();
+  double size = font->GetFontSize();
+  double charSpace = font->GetFontCharSpace();
+  double wordSpace = font->GetWordSpace();
+  if (info.Length() >= 2 && info[1].IsObject()) {
+    auto opts = info[1].As<Object>();
+    if (opts.Has("size")) {
+      size = opts.Get("size").As<Number>();
+    }
+    if (opts.Has("charSpace")) {
+      charSpace = opts.Get("charSpace").As<Number>();
+    }
+    if (opts.Has("wordSpace")) {
+      wordSpace = opts.Get("wordSpace").As<Number>();
+    }
+  }
+  const uint32_t count = strings.Length();
+  std::u32string text;
+  std::vector<size_t> offsets(count + 1, 0);
+  for (uint32_t i = 0; i < count; ++i) {
+    auto value = strings.Get(i);
+    if (!value.IsString()) {
+      throw Error::New(info.Env(), "measure expects an array of strings");
+    }
+    text += TextLayout::DecodeUtf8(value.As<String>().Utf8Value());
+    offsets[i + 1] = text.size();
+  }
+  std::vector<double> advances(text.size());
+  GetAdvanceCache()->Measure(text.data(), text.size(), advances.data(), nullptr);
+
+  const double scale = font->GetFontScale() / 100.0;
+  const double glyphScale = size / 1000.0 * scale;
+  auto widths = Float64Array::New(info.Env(), count);
+  for (uint32_t i = 0; i < count; ++i) {
+    double sum = 0.0;
+    size_t spaces = 0;
+    for (size_t k = offsets[i]; k < offsets[i + 1]; ++k) {
+      sum += advances[k];
+      spaces += text[k] == ' ';
+    }
+    // char space is a percentage of the font size, as in PdfFontMetrics
+    widths[i] = sum * glyphScale +
+                (offsets[i + 1] - offsets[i]) * charSpace * size / 100.0 *
+                  scale +
+                spaces * wordSpace * scale;
+  }
+  return widths;
+}
+std::shared_ptr<TextShaper>
+Font::GetShaper()
+{
+  if (!shaper) {
+    shaper = std::make_shared<TextShaper>(GetAdvanceCache());
+  }
+  return shaper;
+}
+
+/**
+ * Javascript parameters: { kerning?: boolean, ligatures?: boolean,
+ * direction?: 'auto' | 'ltr' | 'rtl' }, anything else is the default
+ */
+ShapeOptions
+Font::ParseShapeOptions(const Napi::Value& value)
+{
+  ShapeOptions options;
+  if (!value.IsObject()) {
+    return options;
+  }
+  auto opts = value.As<Object>();
+  if (opts.Has("kerning")) {
+    options.kerning = opts.Get("kerning").ToBoolean();
+  }
+  if (opts.Has("ligatures")) {
+    options.ligatures = opts.Get("ligatures").ToBoolean();
+  }
+  if (opts.Has("direction") && opts.Get("direction").IsString()) {
+    string direction = opts.Get("direction").As<String>().Utf8Value();
+    if (direction == "ltr") {
+      options.direction = TextDirection::LeftToRight;
+    } else if (direction == "rtl") {
+      options.direction = TextDirection::RightToLeft;
+    }
+  }
+  return options;
+}
+
+/**
+ * @details Javascript parameters: (text: string, options?: ShapeOptions)
+ * Returns the shaped text in visual order, the TJ adjustment after every
+ * glyph and the width at the font's size
+ */
+Napi::Value
+Font::Shape(const CallbackInfo& info)
+{
+  AssertFunctionArgs(info, 1, { napi_valuetype::napi_string });
+  ShapeOptions options =
+    ParseShapeOptions(info.Length() >= 2 ? info[1] : info.Env().Undefined());
+  std::shared_ptr<const ShapedRun> run;
+  try {
+    run = GetShaper()->Shape(
+      info[0].As<String>().Utf8Value(), options, font->GetEncoding());
+  } catch (PdfError& err) {
+    ErrorHandler(err, info);
+  }
+  auto adjustments = Float64Array::New(info.Env(), run->adjustments.size());
+  for (size_t i = 0; i < run->adjustments.size(); ++i) {
+    adjustments[i] = run->adjustments[i];
+  }
+  auto result = Object::New(info.Env());
+  result.Set("text", TextLayout::EncodeUtf8(run->glyphs));
+  result.Set("adjustments", adjustments);
+  result.Set("width", run->Width(font));
+  result.Set("rtl", run->rtl);
+  return result;
+}
+std::shared_ptr<GlyphAdvanceCache>
+Font::GetAdvanceCache()
+{
+  if (!advances) {
+    advances = std::make_shared<GlyphAdvanceCache>(font->GetFontMetrics());
+  }
+  return advances;
+}
 void
 Font::WriteToStream(const Napi::CallbackInfo& info)
 {
@@ -219,7 +366,11 @@ Font::WriteToStream(const Napi::CallbackInfo& info)
   }
   Stream* stream = Stream::Unwrap(streamWrap);
   try {
-    font->WriteStringToStream(PdfString(content), stream->GetStream());
+    PdfString text(content);
+    if (font->IsSubsetting()) {
+      font->AddUsedSubsettingGlyphs(text, static_cast<long>(text.GetLength()));
+    }
+    font->WriteStringToStream(text, stream->GetStream());
   } catch (PdfError& err) {
     ErrorHandler(err, info);
   }
@@ -228,15 +379,22 @@ void
 Font::EmbedFont(const Napi::CallbackInfo& info)
 {
   try {
+    // a subset is embedded when the document is written, once every glyph
+    // is known
+    if (font->IsSubsetting()) {
+      return;
+    }
     font->EmbedFont();
   } catch (PdfError& err) {
     ErrorHandler(err, info);
   }
 }
+// The font belongs to its document, either PoDoFo's font cache or the fonts
+// Document::CreateFont made from a cached face, several Font instances may
+// wrap it
 Font::~Font()
 {
   Napi::HandleScope scope(Env());
-  delete font;
-  //  font = nullptr;
+  font = nullptr;
 }
 }
@@ -20,6 +20,9 @@
 #ifndef NPDF_FONT_H
 #define NPDF_FONT_H
 
+#include "FontCache.h"
+#include "GlyphAdvanceCache.h"
+#include <memory>
 #include <napi.h>
 #include <podofo/podofo.h>
 
@@ -50,15 +53,33 @@ public:
   Napi::Value GetFontMetric(const Napi::CallbackInfo&);
   Napi::Value IsBold(const Napi::CallbackInfo&);
   Napi::Value IsItalic(const Napi::CallbackInfo&);
+  Napi::Value IsSubsetting(const Napi::CallbackInfo&);
   Napi::Value StringWidth(const Napi::CallbackInfo&);
+  Napi::Value Measure(const Napi::CallbackInfo&);
+  Napi::Value Shape(const Napi::CallbackInfo&);
 
   void WriteToStream(const Napi::CallbackInfo&);
   void EmbedFont(const Napi::CallbackInfo&);
 
   PoDoFo::PdfFont* GetPoDoFoFont() { return font; }
+  std::shared_ptr<GlyphAdvanceCache> GetAdvanceCache();
+  // the face this font was created from in the process font cache
+  void SetFace(std::shared_ptr<const FontFace> value)
+  {
+    face = value;
+    advances = face->advances;
+    shaper = face->shaper;
+  }
+  std::shared_ptr<TextShaper> GetShaper();
+  static ShapeOptions ParseShapeOptions(const Napi::Value&);
 
 private:
   PoDoFo::PdfFont* font;
+  // created on first measure, lives as long as the font
+  std::shared_ptr<GlyphAdvanceCache> advances;
+  std::shared_ptr<const FontFace> face;
+  // shaped runs of this font, created on first use like advances
+  std::shared_ptr<TextShaper> shaper;
 };
 }
 #endif // NPDF_FONT_H
@@ -0,0 +1,176 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FontCache.h"
+#include "ImageCache.h"
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include <cstring>
+
+namespace NoPoDoFo {
+
+using namespace PoDoFo;
+using std::string;
+
+FontCache&
+FontCache::Instance()
+{
+  static FontCache* cache = new FontCache();
+  return *cache;
+}
+
+// OpenType with CFF outlines, PoDoFo would write it as a TrueType font
+static bool
+IsCffOpenType(const char* data, size_t length)
+{
+  return length >= 4 && std::memcmp(data, "OTTO", 4) == 0;
+}
+
+FontCache::FontCache()
+  : resolver(&objects)
+{
+  if (FT_Init_FreeType(&library)) {
+    library = nullptr;
+  }
+}
+
+std::shared_ptr<const FontFace>
+FontCache::Get(const string& family, bool bold, bool italic, const string& file)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  Key key(family, bold, italic, file);
+  auto it = faces.find(key);
+  if (it != faces.end()) {
+    return it->second;
+  }
+  PdfFont* font =
+    resolver.GetFont(family.c_str(),
+                     bold,
+                     italic,
+                     false,
+                     PdfEncodingFactory::GlobalWinAnsiEncodingInstance(),
+                     PdfFontCache::eFontCreationFlags_AutoSelectBase14,
+                     false,
+                     file.empty() ? nullptr : file.c_str());
+  if (!font) {
+    return nullptr;
+  }
+  const PdfFontMetrics* metrics = font->GetFontMetrics();
+  auto face = std::make_shared<FontFace>();
+  face->type = metrics->GetFontType();
+  face->base14 = dynamic_cast<const PdfFontMetricsBase14*>(metrics) != nullptr;
+  if (!face->base14) {
+    face->path = metrics->GetFilename() ? metrics->GetFilename() : file;
+    if (face->type == ePdfFontType_TrueType && metrics->GetFontData() &&
+        !IsCffOpenType(metrics->GetFontData(),
+                       static_cast<size_t>(metrics->GetFontDataLen()))) {
+      face->data.assign(metrics->GetFontData(),
+                        static_cast<size_t>(metrics->GetFontDataLen()));
+    }
+  }
+  face->advances = std::make_shared<GlyphAdvanceCache>(metrics);
+  face->shaper = std::make_shared<TextShaper>(face->advances);
+  faces.emplace(key, face);
+  return face;
+}
+
+std::shared_ptr<const FontFace>
+FontCache::Load(const char* data, size_t length)
+{
+  if (IsCffOpenType(data, length)) {
+    return nullptr;
+  }
+  string hash =
+    ImageCache::Hash(reinterpret_cast<const unsigned char*>(data), length);
+  std::lock_guard<std::mutex> guard(lock);
+  auto it = loadedIndex.find(hash);
+  if (it != loadedIndex.end()) {
+    loaded.splice(loaded.begin(), loaded, it->second);
+    return it->second->second;
+  }
+  if (!library) {
+    return nullptr;
+  }
+  auto face = std::make_shared<FontFace>();
+  face->type = ePdfFontType_TrueType;
+  face->data.assign(data, length);
+  face->metrics = std::make_shared<PdfFontMetricsFreetype>(
+    &library, data, static_cast<unsigned int>(length));
+  face->advances = std::make_shared<GlyphAdvanceCache>(face->metrics.get());
+  face->shaper = std::make_shared<TextShaper>(face->advances);
+  if (length > capacity) {
+    return face;
+  }
+  loadedSize += length;
+  loaded.emplace_front(hash, face);
+  loadedIndex[hash] = loaded.begin();
+  Evict();
+  return face;
+}
+
+void
+FontCache::SetCapacity(size_t bytes)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  capacity = bytes;
+  Evict();
+}
+
+// Fonts created from an evicted face keep it, and its metrics, alive
+void
+FontCache::Evict()
+{
+  while (loadedSize > capacity && !loaded.empty()) {
+    loadedSize -= loaded.back().second->data.size();
+    loadedIndex.erase(loaded.back().first);
+    loaded.pop_back();
+  }
+}
+
+PdfFont*
+FontCache::CreateFont(const FontFace& face,
+                      bool bold,
+                      bool italic,
+                      bool embed,
+                      const PdfEncoding* encoding,
+                      PdfVecObjects* target)
+{
+  if (face.data.empty() || !library) {
+    return nullptr;
+  }
+  PdfFontMetrics* metrics;
+  {
+    // faces are opened through the shared library, serialize that part
+    std::lock_guard<std::mutex> guard(lock);
+    metrics = new PdfFontMetricsFreetype(
+      &library, face.data.data(), static_cast<unsigned int>(face.data.size()));
+  }
+  int flags = ePdfFont_Normal;
+  if (embed) {
+    flags |= ePdfFont_Embedded;
+  }
+  if (bold) {
+    flags |= ePdfFont_Bold;
+  }
+  if (italic) {
+    flags |= ePdfFont_Italic;
+  }
+  return PdfFontFactory::CreateFontObject(metrics, flags, encoding, target);
+}
+}
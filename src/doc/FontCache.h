@@ -0,0 +1,111 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NPDF_FONTCACHE_H
+#define NPDF_FONTCACHE_H
+
+#include "GlyphAdvanceCache.h"
+#include "TextShaper.h"
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <podofo/podofo.h>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+
+namespace NoPoDoFo {
+
+/**
+ * A font as resolved once for the process: the file fontconfig (or the
+ * platform lookup PoDoFo uses) found, its bytes and a glyph advance cache
+ * every document measuring with this face can share.
+ */
+struct FontFace
+{
+  std::string path;
+  PoDoFo::EPdfFontType type;
+  bool base14 = false;
+  // file contents, only kept for TrueType outline faces
+  std::string data;
+  // loaded faces only, the parsed data backing advances
+  std::shared_ptr<PoDoFo::PdfFontMetrics> metrics;
+  std::shared_ptr<GlyphAdvanceCache> advances;
+  std::shared_ptr<TextShaper> shaper;
+};
+
+/**
+ * Process wide cache of font faces keyed by (family, bold, italic, file).
+ * Font lookup and parsing happen once per key, documents only create their
+ * own font dictionaries from the cached bytes. Faces loaded from data are
+ * kept in an LRU bounded by the size of the data. Safe to use from any
+ * thread. The instance is never destroyed, faces handed out may outlive
+ * static destruction and their metrics need the FreeType library.
+ */
+class FontCache
+{
+public:
+  static FontCache& Instance();
+
+  /**
+   * Resolve a font, returns null when PoDoFo can not find it
+   */
+  std::shared_ptr<const FontFace> Get(const std::string& family,
+                                      bool bold,
+                                      bool italic,
+                                      const std::string& file);
+  /**
+   * Parse TrueType font data, cached by the SHA-256 of the data. Returns
+   * null for OpenType fonts with CFF outlines, which PoDoFo can only embed
+   * as TrueType
+   */
+  std::shared_ptr<const FontFace> Load(const char* data, size_t length);
+  /**
+   * Create a font in objects from a cached TrueType face, the returned font
+   * owns its metrics and is independent of the cache
+   */
+  PoDoFo::PdfFont* CreateFont(const FontFace& face,
+                              bool bold,
+                              bool italic,
+                              bool embed,
+                              const PoDoFo::PdfEncoding* encoding,
+                              PoDoFo::PdfVecObjects* objects);
+  void SetCapacity(size_t bytes);
+
+private:
+  FontCache();
+  typedef std::tuple<std::string, bool, bool, std::string> Key;
+  typedef std::pair<std::string, std::shared_ptr<const FontFace>> Entry;
+  std::mutex lock;
+  FT_Library library = nullptr;
+  // fonts created while resolving live here, their metrics back the shared
+  // advance caches
+  PoDoFo::PdfVecObjects objects;
+  PoDoFo::PdfFontCache resolver;
+  std::map<Key, std::shared_ptr<const FontFace>> faces;
+  std::list<Entry> loaded; // most recently used first
+  std::unordered_map<std::string, std::list<Entry>::iterator> loadedIndex;
+  size_t loadedSize = 0;
+  size_t capacity = 32 * 1024 * 1024;
+
+  void Evict();
+};
+}
+#endif // NPDF_FONTCACHE_H
@@ -0,0 +1,130 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "GlyphAdvanceCache.h"
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+namespace NoPoDoFo {
+
+using namespace PoDoFo;
+
+GlyphAdvanceCache::GlyphAdvanceCache(const PdfFontMetrics* metrics)
+  : metrics(metrics)
+  , ascent(metrics->GetPdfAscent())
+  , descent(metrics->GetPdfDescent())
+{
+  for (double& a : ascii) {
+    a = -1.0;
+  }
+  auto ft = dynamic_cast<const PdfFontMetricsFreetype*>(metrics);
+  if (ft) {
+    FT_Face f = const_cast<PdfFontMetricsFreetype*>(ft)->GetFace();
+    if (f && FT_HAS_KERNING(f) && f->units_per_EM) {
+      face = f;
+      unitsPerEm = f->units_per_EM;
+    }
+  }
+}
+
+double
+GlyphAdvanceCache::LookupAdvance(char32_t c)
+{
+  if (c < 128 && ascii[c] >= 0.0) {
+    return ascii[c];
+  }
+  if (c >= 128) {
+    auto it = advances.find(c);
+    if (it != advances.end()) {
+      return it->second;
+    }
+  }
+  long glyph = metrics->GetGlyphId(static_cast<long>(c));
+  double width = metrics->GetGlyphWidth(static_cast<int>(glyph));
+  if (width < 0.0) {
+    width = 0.0;
+  }
+  if (c < 128) {
+    ascii[c] = width;
+  } else {
+    advances.emplace(c, width);
+  }
+  return width;
+}
+
+double
+GlyphAdvanceCache::LookupKerning(char32_t left, char32_t right)
+{
+  if (!face) {
+    return 0.0;
+  }
+  uint64_t key = (static_cast<uint64_t>(left) << 32) | right;
+  auto it = kerning.find(key);
+  if (it != kerning.end()) {
+    return it->second;
+  }
+  double value = 0.0;
+  FT_Vector delta;
+  FT_UInt l = static_cast<FT_UInt>(metrics->GetGlyphId(static_cast<long>(left)));
+  FT_UInt r =
+    static_cast<FT_UInt>(metrics->GetGlyphId(static_cast<long>(right)));
+  if (l && r &&
+      FT_Get_Kerning(face, l, r, FT_KERNING_UNSCALED, &delta) == 0) {
+    value = delta.x * 1000.0 / unitsPerEm;
+  }
+  kerning.emplace(key, value);
+  return value;
+}
+
+double
+GlyphAdvanceCache::Advance(char32_t c)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return LookupAdvance(c);
+}
+
+double
+GlyphAdvanceCache::Kerning(char32_t left, char32_t right)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return LookupKerning(left, right);
+}
+
+bool
+GlyphAdvanceCache::HasGlyph(char32_t c)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return metrics->GetGlyphId(static_cast<long>(c)) != 0;
+}
+
+void
+GlyphAdvanceCache::Measure(const char32_t* text,
+                           size_t n,
+                           double* widths,
+                           double* kerns)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  for (size_t i = 0; i < n; ++i) {
+    widths[i] = LookupAdvance(text[i]);
+    if (kerns) {
+      kerns[i] = i + 1 < n ? LookupKerning(text[i], text[i + 1]) : 0.0;
+    }
+  }
+}
+}
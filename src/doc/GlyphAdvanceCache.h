@@ -0,0 +1,74 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NPDF_GLYPHADVANCECACHE_H
+#define NPDF_GLYPHADVANCECACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <podofo/podofo.h>
+#include <unordered_map>
+
+namespace NoPoDoFo {
+
+/**
+ * Per font cache of glyph advances and kerning pairs, in unscaled PDF glyph
+ * space units (1/1000 em). Lookups go through PdfFontMetrics once per
+ * codepoint, after that layout and measuring only hit the cache. Kerning is
+ * read from the FreeType face (the kern table, no GPOS) when the font has
+ * one. Shared between threads, every lookup is made under the cache lock.
+ */
+class GlyphAdvanceCache
+{
+public:
+  explicit GlyphAdvanceCache(const PoDoFo::PdfFontMetrics* metrics);
+
+  double Advance(char32_t);
+  double Kerning(char32_t left, char32_t right);
+  /**
+   * Batch lookup under a single lock. advances receives n values, kerns
+   * (optional) n values where kerns[i] is the adjustment between text[i] and
+   * text[i + 1], the last one always 0
+   */
+  void Measure(const char32_t* text, size_t n, double* advances, double* kerns);
+  bool HasGlyph(char32_t);
+  bool HasKerning() const { return face != nullptr; }
+  double GetAscent() const { return ascent; }
+  double GetDescent() const { return descent; }
+  const PoDoFo::PdfFontMetrics* GetMetrics() const { return metrics; }
+
+private:
+  const PoDoFo::PdfFontMetrics* metrics;
+  // FreeType face with a kern table, null when kerning is unavailable
+  FT_Face face = nullptr;
+  double unitsPerEm = 1000.0;
+  double ascent;
+  double descent;
+  std::mutex lock;
+  // ascii advances are looked up by index, < 0 until first use
+  double ascii[128];
+  std::unordered_map<char32_t, double> advances;
+  std::unordered_map<uint64_t, double> kerning;
+
+  double LookupAdvance(char32_t);
+  double LookupKerning(char32_t, char32_t);
+};
+}
+#endif // NPDF_GLYPHADVANCECACHE_H
@@ -20,6 +20,10 @@
 #include "Image.h"
 #include "../ErrorHandler.h"
 #include "../ValidateArguments.h"
+#include "ImageCache.h"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
 
 
 namespace NoPoDoFo {
@@ -34,28 +38,24 @@ FunctionReference Image::constructor; // NOLINT
 Image::Image(const CallbackInfo& info)
   : ObjectWrap(info)
 {
-
-#ifdef PODOFO_HAVE_JPEG_LIB
   try {
     if (info.Length() < 1) {
       throw Napi::Error::New(info.Env(), "Image requires the document.");
     }
     auto docObj = info[0].As<Object>();
     _doc = Document::Unwrap(docObj);
-    PdfMemDocument* doc = _doc->GetDocument();
-    img = new PdfImage(doc);
+    if (info.Length() == 2) {
+      _doc->AssertIdle(info.Env());
+    }
     if (info.Length() == 2 && info[1].IsString()) {
-      string imgFile = info[1].As<String>().Utf8Value();
-      img->LoadFromFile(imgFile.c_str());
-      loaded = true;
+      LoadFile(info[1].As<String>().Utf8Value());
+    } else if (info.Length() == 2 && info[1].IsBuffer()) {
+      auto buffer = info[1].As<Buffer<unsigned char>>();
+      Load(buffer.Data(), buffer.Length());
     }
   } catch (PdfError& err) {
     ErrorHandler(err, info);
   }
-#else
-  throw Napi::Error::New(info.Env(),
-                         "NPdf PoDoFo requires libjpeg for images.");
-#endif
 }
 void
 Image::Initialize(Napi::Env& env, Napi::Object& target)
@@ -69,7 +69,8 @@ Image::Initialize(Napi::Env& env, Napi::Object& target)
                   InstanceMethod("loadFromFile", &Image::LoadFromFile),
                   InstanceAccessor("isLoaded", &Image::IsLoaded, nullptr),
                   InstanceMethod("setInterpolate", &Image::SetInterpolate),
-                  InstanceMethod("setData", &Image::LoadFromBuffer) });
+                  InstanceMethod("setData", &Image::LoadFromBuffer),
+                  InstanceMethod("loadAsync", &Image::LoadAsync) });
   constructor = Napi::Persistent(ctor);
   constructor.SuppressDestruct();
 
@@ -78,13 +79,10 @@ Image::Initialize(Napi::Env& env, Napi::Object& target)
 void
 Image::LoadFromFile(const CallbackInfo& info)
 {
-
-#ifdef PODOFO_HAVE_JPEG_LIB
+  _doc->AssertIdle(info.Env());
   try {
     if (info[0].IsString()) {
-      string file = info[0].As<String>().Utf8Value();
-      img->LoadFromFile(file.c_str());
-      loaded = true;
+      LoadFile(info[0].As<String>().Utf8Value());
     } else {
       throw Napi::Error::New(
         info.Env(), "LoadFromFile takes a single argument of type string.");
@@ -94,38 +92,226 @@ Image::LoadFromFile(const CallbackInfo& info)
     msg << "PoDoFo fail code: " << err.GetError() << endl;
     throw Napi::Error::New(info.Env(), msg.str());
   }
-#else
-  throw Napi::Error::New(info.Env(),
-                         "NPdf PoDoFo requires libjpeg for images.");
-#endif
 }
 
+/**
+ * @details Javascript parameters: (data: Buffer)
+ * Decodes straight from the Buffer's memory, nothing is copied before the
+ * image is embedded.
+ */
 void
 Image::LoadFromBuffer(const CallbackInfo& info)
 {
-#ifdef PODOFO_HAVE_JPEG_LIB
+  if (info.Length() < 1 || !info[0].IsBuffer()) {
+    throw Napi::Error::New(
+      info.Env(), "LoadFromBuffer requires a single argument of type Buffer");
+  }
+  _doc->AssertIdle(info.Env());
+  auto buffer = info[0].As<Buffer<unsigned char>>();
   try {
-    if (info.Length() < 1 || !info[0].IsBuffer()) {
-      throw Napi::Error::New(
-        info.Env(), "LoadFromBuffer requires a single argument of type Buffer");
-    }
-    string jsValue = info[0].As<String>().Utf8Value();
-    auto* value = new unsigned char[jsValue.length()];
-    strcpy(reinterpret_cast<char*>(value), jsValue.c_str());
-    img->LoadFromData(value, static_cast<long>(jsValue.length()));
+    Load(buffer.Data(), buffer.Length());
   } catch (PdfError& err) {
-    stringstream msg;
-    msg << "PoDoFo error. Code= " << err.GetError() << endl;
-    throw Napi::Error::New(info.Env(), msg.str());
-  } catch (Error& err) {
-    stringstream msg;
-    msg << "JS error: " << err.Message() << endl;
-    throw Napi::Error::New(info.Env(), msg.str());
+    ErrorHandler(err, info);
+  }
+}
+
+ImageFormat
+Image::DetectFormat(const unsigned char* data, size_t length)
+{
+  static const unsigned char png[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A,
+                                       '\n' };
+  if (length >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF) {
+    return ImageFormat::Jpeg;
   }
+  if (length >= sizeof(png) && std::equal(png, png + sizeof(png), data)) {
+    return ImageFormat::Png;
+  }
+  if (length >= 4 &&
+      ((data[0] == 'I' && data[1] == 'I' && data[2] == 42 && data[3] == 0) ||
+       (data[0] == 'M' && data[1] == 'M' && data[2] == 0 && data[3] == 42))) {
+    return ImageFormat::Tiff;
+  }
+  return ImageFormat::Unknown;
+}
+
+/**
+ * Embed the image in data into doc. The same bytes are embedded once per
+ * document, later loads reuse the existing XObject. Across documents the
+ * encoded stream comes from the process wide ImageCache so the image is not
+ * decoded again. Does not touch javascript, safe to call from a worker.
+ */
+PdfImage*
+Image::Resolve(Document* doc, const unsigned char* data, size_t length)
+{
+  string hash = ImageCache::Hash(data, length);
+  if (PdfObject* existing = doc->GetCachedImage(hash)) {
+    return new PdfImage(existing);
+  }
+  PdfImage* image;
+  if (auto payload = ImageCache::Instance().Get(hash)) {
+    image = ImageCache::Embed(doc->GetDocument(), *payload);
+  } else {
+    ImageFormat format = DetectFormat(data, length);
+    if (format == ImageFormat::Unknown) {
+      PODOFO_RAISE_ERROR_INFO(ePdfError_UnsupportedImageFormat,
+                              "Image data is not JPEG, PNG or TIFF");
+    }
+    image = new PdfImage(doc->GetDocument());
+    auto len = static_cast<pdf_long>(length);
+    try {
+      switch (format) {
+        case ImageFormat::Jpeg:
+#ifdef PODOFO_HAVE_JPEG_LIB
+          image->LoadFromJpegData(data, len);
+          break;
+#else
+          PODOFO_RAISE_ERROR_INFO(ePdfError_NotCompiled,
+                                  "PoDoFo was built without libjpeg");
+#endif
+        case ImageFormat::Png:
+#ifdef PODOFO_HAVE_PNG_LIB
+          image->LoadFromPngData(data, len);
+          break;
+#else
+          PODOFO_RAISE_ERROR_INFO(ePdfError_NotCompiled,
+                                  "PoDoFo was built without libpng");
+#endif
+        case ImageFormat::Tiff:
+#ifdef PODOFO_HAVE_TIFF_LIB
+          image->LoadFromTiffData(data, len);
+          break;
 #else
-  throw Napi::Error::New(info.Env(),
-                         "NPdf PoDoFo requires libjpeg for images.");
+          PODOFO_RAISE_ERROR_INFO(ePdfError_NotCompiled,
+                                  "PoDoFo was built without libtiff");
 #endif
+        default:
+          break;
+      }
+    } catch (PdfError&) {
+      delete image;
+      throw;
+    }
+    ImageCache::Instance().Put(hash, ImageCache::Capture(image->GetObject()));
+  }
+  doc->CacheImage(hash, image->GetObject()->Reference());
+  return image;
+}
+
+void
+Image::Load(const unsigned char* data, size_t length)
+{
+  SetImage(Resolve(_doc, data, length));
+}
+
+void
+Image::SetImage(PdfImage* image)
+{
+  delete img;
+  img = image;
+  loaded = true;
+}
+
+void
+Image::LoadFile(const string& file)
+{
+  std::ifstream in(file, std::ios::binary);
+  if (!in) {
+    PODOFO_RAISE_ERROR_INFO(ePdfError_FileNotFound, file.c_str());
+  }
+  string bytes((std::istreambuf_iterator<char>(in)),
+               std::istreambuf_iterator<char>());
+  Load(reinterpret_cast<const unsigned char*>(bytes.data()), bytes.size());
+}
+
+/**
+ * Reads (for a path) and decodes the image on a worker thread. A Buffer is
+ * referenced until the worker completes and decoded in place.
+ */
+class ImageLoadAsync : public AsyncWorker
+{
+public:
+  ImageLoadAsync(Function& cb, Image& image, Document* doc)
+    : AsyncWorker(cb)
+    , image(image)
+    , self(Persistent(image.Value()))
+    , doc(doc)
+  {
+    doc->Acquire();
+  }
+  void SetFile(string value) { file = std::move(value); }
+  void SetBuffer(const Buffer<unsigned char>& value)
+  {
+    buffer = Persistent(value);
+    data = value.Data();
+    length = value.Length();
+  }
+
+private:
+  Image& image;
+  ObjectReference self; // keeps the Image alive until the load completes
+  Document* doc;
+  string file;
+  Reference<Buffer<unsigned char>> buffer;
+  const unsigned char* data = nullptr;
+  size_t length = 0;
+  PdfImage* result = nullptr;
+
+protected:
+  void Execute() override
+  {
+    try {
+      string bytes;
+      if (!file.empty()) {
+        std::ifstream in(file, std::ios::binary);
+        if (!in) {
+          PODOFO_RAISE_ERROR_INFO(ePdfError_FileNotFound, file.c_str());
+        }
+        bytes.assign(std::istreambuf_iterator<char>(in),
+                     std::istreambuf_iterator<char>());
+        data = reinterpret_cast<const unsigned char*>(bytes.data());
+        length = bytes.size();
+      }
+      std::lock_guard<std::mutex> guard(doc->GetLock());
+      result = Image::Resolve(doc, data, length);
+    } catch (PdfError& err) {
+      SetError(ErrorHandler::WriteMsg(err));
+    } catch (std::exception& err) {
+      SetError(err.what());
+    }
+  }
+  void OnError(const Napi::Error& e) override
+  {
+    doc->Release();
+    AsyncWorker::OnError(e);
+  }
+  void OnOK() override
+  {
+    HandleScope scope(Env());
+    doc->Release();
+    image.SetImage(result);
+    Callback().Call({ Env().Null(), Env().Undefined() });
+  }
+};
+
+/**
+ * @details Javascript parameters: (source: string | Buffer, cb: Function)
+ */
+void
+Image::LoadAsync(const CallbackInfo& info)
+{
+  if (info.Length() < 2 || !info[1].IsFunction() ||
+      !(info[0].IsString() || info[0].IsBuffer())) {
+    throw TypeError::New(info.Env(),
+                         "loadAsync requires (source: string | Buffer, cb)");
+  }
+  auto cb = info[1].As<Function>();
+  auto worker = new ImageLoadAsync(cb, *this, _doc);
+  if (info[0].IsString()) {
+    worker->SetFile(info[0].As<String>().Utf8Value());
+  } else {
+    worker->SetBuffer(info[0].As<Buffer<unsigned char>>());
+  }
+  worker->Queue();
 }
 
 Napi::Value
@@ -170,6 +356,11 @@ void
 Image::SetInterpolate(const CallbackInfo& info)
 {
   AssertFunctionArgs(info, 1, { napi_valuetype::napi_boolean });
+  if (!img) {
+    throw Napi::Error::New(info.Env(),
+                           "Can not call setInterpolate before setting "
+                           "file/data.");
+  }
   img->SetInterpolate(info[0].As<Boolean>());
 }
 Image::~Image()
@@ -24,6 +24,14 @@
 #include <napi.h>
 #include <podofo/podofo.h>
 namespace NoPoDoFo {
+enum class ImageFormat
+{
+  Unknown,
+  Jpeg,
+  Png,
+  Tiff
+};
+
 class Image : public Napi::ObjectWrap<Image>
 {
 public:
@@ -36,14 +44,25 @@ public:
   Napi::Value GetHeight(const Napi::CallbackInfo&);
   void LoadFromFile(const Napi::CallbackInfo&);
   void LoadFromBuffer(const Napi::CallbackInfo&);
+  void LoadAsync(const Napi::CallbackInfo&);
   Napi::Value IsLoaded(const Napi::CallbackInfo&);
   void SetInterpolate(const Napi::CallbackInfo&);
   PoDoFo::PdfImage GetImage() { return *img; }
+  bool Loaded() { return loaded; }
+  void SetImage(PoDoFo::PdfImage*);
+
+  static ImageFormat DetectFormat(const unsigned char* data, size_t length);
+  static PoDoFo::PdfImage* Resolve(Document* doc,
+                                   const unsigned char* data,
+                                   size_t length);
 
 private:
   Document* _doc;
-  PoDoFo::PdfImage* img;
+  // created on load, possibly wrapping an XObject shared with other images
+  PoDoFo::PdfImage* img = nullptr;
   bool loaded = false;
+  void LoadFile(const std::string& file);
+  void Load(const unsigned char* data, size_t length);
 };
 }
 #endif // NPDF_IMAGE_H
@@ -0,0 +1,159 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ImageCache.h"
+#include <openssl/sha.h>
+
+namespace NoPoDoFo {
+
+using namespace PoDoFo;
+using std::string;
+
+ImageCache&
+ImageCache::Instance()
+{
+  static ImageCache cache;
+  return cache;
+}
+
+string
+ImageCache::Hash(const unsigned char* data, size_t length)
+{
+  unsigned char digest[SHA256_DIGEST_LENGTH];
+  SHA256(data, length, digest);
+  static const char hex[] = "0123456789abcdef";
+  string out;
+  out.reserve(SHA256_DIGEST_LENGTH * 2);
+  for (unsigned char c : digest) {
+    out.push_back(hex[c >> 4]);
+    out.push_back(hex[c & 0xF]);
+  }
+  return out;
+}
+
+static bool
+IsDirect(const PdfObject& value)
+{
+  if (value.IsReference()) {
+    return false;
+  }
+  if (value.IsArray()) {
+    for (auto& item : value.GetArray()) {
+      if (!IsDirect(item)) {
+        return false;
+      }
+    }
+  }
+  if (value.IsDictionary()) {
+    for (auto& key : value.GetDictionary().GetKeys()) {
+      if (!IsDirect(*key.second)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+std::shared_ptr<ImagePayload>
+ImageCache::Capture(PdfObject* xobject)
+{
+  if (!xobject || !xobject->HasStream() || !IsDirect(*xobject)) {
+    return nullptr;
+  }
+  auto payload = std::make_shared<ImagePayload>();
+  for (auto& key : xobject->GetDictionary().GetKeys()) {
+    if (key.first == PdfName::KeyLength) {
+      continue;
+    }
+    payload->dictionary.AddKey(key.first, *key.second);
+  }
+  char* buffer = nullptr;
+  pdf_long length = 0;
+  xobject->GetStream()->GetCopy(&buffer, &length);
+  payload->data.assign(buffer, static_cast<size_t>(length));
+  podofo_free(buffer);
+  return payload;
+}
+
+PdfImage*
+ImageCache::Embed(PdfMemDocument* document, const ImagePayload& payload)
+{
+  auto image = new PdfImage(document);
+  PdfObject* object = image->GetObject();
+  for (auto& key : payload.dictionary.GetKeys()) {
+    object->GetDictionary().AddKey(key.first, *key.second);
+  }
+  // the payload is still encoded, the Filter key copied above describes it
+  PdfMemoryInputStream input(payload.data.data(),
+                             static_cast<pdf_long>(payload.data.size()));
+  object->GetStream()->SetRawData(&input,
+                                  static_cast<pdf_long>(payload.data.size()));
+  // rewrap so width and height are read back from the dictionary
+  delete image;
+  return new PdfImage(object);
+}
+
+std::shared_ptr<const ImagePayload>
+ImageCache::Get(const string& hash)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  auto it = index.find(hash);
+  if (it == index.end()) {
+    return nullptr;
+  }
+  entries.splice(entries.begin(), entries, it->second);
+  return it->second->second;
+}
+
+void
+ImageCache::Put(const string& hash, std::shared_ptr<const ImagePayload> payload)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  if (!payload || payload->data.size() > capacity) {
+    return;
+  }
+  auto it = index.find(hash);
+  if (it != index.end()) {
+    size -= it->second->second->data.size();
+    entries.erase(it->second);
+  }
+  size += payload->data.size();
+  entries.emplace_front(hash, std::move(payload));
+  index[hash] = entries.begin();
+  Evict();
+}
+
+void
+ImageCache::SetCapacity(size_t bytes)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  capacity = bytes;
+  Evict();
+}
+
+void
+ImageCache::Evict()
+{
+  while (size > capacity && !entries.empty()) {
+    size -= entries.back().second->data.size();
+    index.erase(entries.back().first);
+    entries.pop_back();
+  }
+}
+}
@@ -0,0 +1,79 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NPDF_IMAGECACHE_H
+#define NPDF_IMAGECACHE_H
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <podofo/podofo.h>
+#include <string>
+#include <unordered_map>
+
+namespace NoPoDoFo {
+
+/**
+ * An embedded image as PoDoFo produced it: the image dictionary and the
+ * encoded stream bytes. Enough to embed the same image into any document
+ * without decoding the source file again.
+ */
+struct ImagePayload
+{
+  PoDoFo::PdfDictionary dictionary;
+  std::string data;
+};
+
+/**
+ * Process wide LRU of image payloads keyed by the SHA-256 of the source
+ * file, bounded by the total size of the payloads. Shared by every document
+ * and safe to use from any thread.
+ */
+class ImageCache
+{
+public:
+  static ImageCache& Instance();
+  static std::string Hash(const unsigned char* data, size_t length);
+  /**
+   * Copy the dictionary and encoded stream of an image XObject, returns
+   * null when the image refers to other objects (e.g. an ICC profile) and
+   * can not be moved between documents
+   */
+  static std::shared_ptr<ImagePayload> Capture(PoDoFo::PdfObject* xobject);
+  static PoDoFo::PdfImage* Embed(PoDoFo::PdfMemDocument* document,
+                                 const ImagePayload& payload);
+
+  std::shared_ptr<const ImagePayload> Get(const std::string& hash);
+  void Put(const std::string& hash, std::shared_ptr<const ImagePayload>);
+  void SetCapacity(size_t bytes);
+
+private:
+  ImageCache() = default;
+  typedef std::pair<std::string, std::shared_ptr<const ImagePayload>> Entry;
+  std::mutex lock;
+  std::list<Entry> entries; // most recently used first
+  std::unordered_map<std::string, std::list<Entry>::iterator> index;
+  size_t size = 0;
+  size_t capacity = 64 * 1024 * 1024;
+
+  void Evict();
+};
+}
+#endif // NPDF_IMAGECACHE_H
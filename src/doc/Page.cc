@@ -20,6 +20,8 @@
 #include "Page.h"
 #include "../ErrorHandler.h"
 #include "../base/Obj.h"
+#include "../base/Redactor.h"
+#include "../base/SpatialIndex.h"
 #include "Annotation.h"
 #include "Field.h"
 
@@ -76,7 +78,10 @@ Page::Initialize(Napi::Env& env, Napi::Object& target)
       InstanceMethod("createAnnotation", &Page::CreateAnnotation),
       InstanceMethod("getAnnotation", &Page::GetAnnotation),
       InstanceMethod("getNumAnnots", &Page::GetNumAnnots),
-      InstanceMethod("deleteAnnotation", &Page::DeleteAnnotation) });
+      InstanceMethod("deleteAnnotation", &Page::DeleteAnnotation),
+      InstanceMethod("redact", &Page::Redact),
+      InstanceMethod("hitTest", &Page::HitTest),
+      InstanceMethod("query", &Page::Query) });
   constructor = Persistent(ctor);
   constructor.SuppressDestruct();
   target.Set("Page", ctor);
@@ -387,13 +392,128 @@ void
 Page::DeleteAnnotation(const CallbackInfo& info)
 {
   AssertFunctionArgs(info, 1, { napi_valuetype::napi_number });
+  doc->AssertIdle(info.Env());
   int index = info[0].As<Number>();
   try {
+    auto spatial = doc->GetSpatialIndex(page, false);
+    if (spatial) {
+      spatial->RemoveAnnotation(index,
+                                page->GetAnnotation(index)->GetObject());
+    }
     page->DeleteAnnotation(index);
   } catch (PdfError& err) {
     ErrorHandler(err, info);
   }
 }
+
+/**
+ * @details Javascript parameters: (rects: Rect[]), returns the number of
+ * glyphs removed
+ */
+Napi::Value
+Page::Redact(const CallbackInfo& info)
+{
+  AssertFunctionArgs(info, 1, { napi_valuetype::napi_object });
+  doc->AssertIdle(info.Env());
+  auto js = info[0].As<Array>();
+  vector<Box> rects;
+  for (uint32_t i = 0; i < js.Length(); ++i) {
+    PdfRect* rect = Rect::Unwrap(js.Get(i).As<Object>())->GetRect();
+    rects.push_back(Box{ rect->GetLeft(),
+                         rect->GetBottom(),
+                         rect->GetLeft() + rect->GetWidth(),
+                         rect->GetBottom() + rect->GetHeight() });
+  }
+  size_t removed = 0;
+  try {
+    Redactor redactor(doc->GetDocument(), page);
+    removed = redactor.Redact(rects);
+    doc->InvalidateTextIndex();
+  } catch (PdfError& err) {
+    ErrorHandler(err, info);
+  }
+  return Number::New(info.Env(), removed);
+}
+
+Napi::Value
+Page::QueryIndex(const CallbackInfo& info, const Box& area, bool text)
+{
+  vector<SpatialHit> hits;
+  try {
+    auto spatial = doc->GetSpatialIndex(page, true);
+    if (text && !spatial->HasText()) {
+      spatial->AddText(TextExtractor(doc->GetDocument(), page).Extract());
+    }
+    hits = spatial->Query(area);
+  } catch (PdfError& err) {
+    ErrorHandler(err, info);
+  }
+  auto js = Array::New(info.Env());
+  for (uint32_t i = 0; i < hits.size(); ++i) {
+    const SpatialHit& hit = hits[i];
+    auto item = Object::New(info.Env());
+    switch (hit.kind) {
+      case SpatialEntry::Annotation:
+        item.Set("type", String::New(info.Env(), "annotation"));
+        break;
+      case SpatialEntry::Widget:
+        item.Set("type", String::New(info.Env(), "field"));
+        item.Set("field", Number::New(info.Env(), hit.field));
+        break;
+      case SpatialEntry::Text:
+        item.Set("type", String::New(info.Env(), "text"));
+        item.Set("text", String::New(info.Env(), hit.text));
+        break;
+    }
+    if (hit.annotation >= 0) {
+      item.Set("annotation", Number::New(info.Env(), hit.annotation));
+    }
+    item.Set("left", Number::New(info.Env(), hit.box.left));
+    item.Set("bottom", Number::New(info.Env(), hit.box.bottom));
+    item.Set("width", Number::New(info.Env(), hit.box.right - hit.box.left));
+    item.Set("height", Number::New(info.Env(), hit.box.top - hit.box.bottom));
+    js.Set(i, item);
+  }
+  return js;
+}
+
+/**
+ * @details Javascript parameters: (x: number, y: number, text: boolean)
+ */
+Napi::Value
+Page::HitTest(const CallbackInfo& info)
+{
+  AssertFunctionArgs(info,
+                     3,
+                     { napi_valuetype::napi_number,
+                       napi_valuetype::napi_number,
+                       napi_valuetype::napi_boolean });
+  double x = info[0].As<Number>();
+  double y = info[1].As<Number>();
+  return QueryIndex(info, Box{ x, y, x, y }, info[2].As<Boolean>());
+}
+
+/**
+ * @details Javascript parameters: (left: number, bottom: number, width:
+ * number, height: number, text: boolean)
+ */
+Napi::Value
+Page::Query(const CallbackInfo& info)
+{
+  AssertFunctionArgs(info,
+                     5,
+                     { napi_valuetype::napi_number,
+                       napi_valuetype::napi_number,
+                       napi_valuetype::napi_number,
+                       napi_valuetype::napi_number,
+                       napi_valuetype::napi_boolean });
+  double left = info[0].As<Number>();
+  double bottom = info[1].As<Number>();
+  double width = info[2].As<Number>();
+  double height = info[3].As<Number>();
+  return QueryIndex(
+    info, Box{ left, bottom, left + width, bottom + height }, info[4].As<Boolean>());
+}
 Napi::Value
 Page::GetAnnotation(const CallbackInfo& info)
 {
@@ -409,12 +529,17 @@ Page::CreateAnnotation(const CallbackInfo& info)
 {
   AssertFunctionArgs(
     info, 2, { napi_valuetype::napi_number, napi_valuetype::napi_object });
+  doc->AssertIdle(info.Env());
   EscapableHandleScope scope(info.Env());
   int flag = info[0].As<Number>();
   auto type = static_cast<EPdfAnnotation>(flag);
   auto obj = info[1].As<Object>();
   Rect* rect = Rect::Unwrap(obj);
   PdfAnnotation* annot = page->CreateAnnotation(type, *rect->GetRect());
+  auto spatial = doc->GetSpatialIndex(page, false);
+  if (spatial) {
+    spatial->AddAnnotation(annot->GetObject());
+  }
   auto instance = Annotation::constructor.New(
     { External<PdfAnnotation>::New(scope.Env(), annot) });
   return instance;
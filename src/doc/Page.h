@@ -24,6 +24,7 @@
 
 #include <napi.h>
 #include <podofo/podofo.h>
+#include "../base/ContentsState.h"
 #include "Document.h"
 
 namespace NoPoDoFo {
@@ -60,6 +61,9 @@ public:
   Napi::Value GetAnnotation(const Napi::CallbackInfo&);
   Napi::Value GetNumAnnots(const Napi::CallbackInfo&);
   void DeleteAnnotation(const Napi::CallbackInfo&);
+  Napi::Value Redact(const Napi::CallbackInfo&);
+  Napi::Value HitTest(const Napi::CallbackInfo&);
+  Napi::Value Query(const Napi::CallbackInfo&);
 
   PoDoFo::PdfPage* GetPage() { return page; }
 
@@ -69,6 +73,7 @@ private:
   void GetFieldObject(const Napi::CallbackInfo& info,
                       Napi::Object&,
                       PoDoFo::PdfField&);
+  Napi::Value QueryIndex(const Napi::CallbackInfo&, const Box&, bool text);
   Napi::Object ExtractAndApplyRectValues(const Napi::CallbackInfo&,
                                          PoDoFo::PdfRect&);
 };
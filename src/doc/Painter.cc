@@ -19,13 +19,17 @@
 
 #include "Painter.h"
 #include "../ErrorHandler.h"
+#include "../Parallel.h"
 #include "../ValidateArguments.h"
+#include "../base/Obj.h"
 #include "../base/Stream.h"
+#include "CommandBuffer.h"
 #include "Document.h"
 #include "ExtGState.h"
 #include "Font.h"
 #include "Image.h"
 #include "Page.h"
+#include "PathKernel.h"
 #include "Rect.h"
 
 
@@ -33,6 +37,8 @@ namespace NoPoDoFo {
 
 using namespace Napi;
 using namespace PoDoFo;
+using std::string;
+using std::vector;
 
 FunctionReference Painter::constructor; // NOLINT
 Painter::Painter(const Napi::CallbackInfo& info)
@@ -52,6 +58,9 @@ Painter::~Painter()
 {
   Napi::HandleScope scope(Env());
   delete painter;
+  delete pagePainter;
+  delete writer;
+  delete xobject;
   document = nullptr;
 }
 void
@@ -66,8 +75,15 @@ Painter::Initialize(Napi::Env& env, Napi::Object& target)
         "tabWidth", &Painter::GetTabWidth, &Painter::SetTabWidth),
       InstanceAccessor(
         "precision", &Painter::GetPrecision, &Painter::SetPrecision),
+      InstanceAccessor("shaping", &Painter::GetShaping, &Painter::SetShaping),
       InstanceAccessor("canvas", &Painter::GetCanvas, nullptr),
       InstanceAccessor("font", &Painter::GetFont, &Painter::SetFont),
+      InstanceAccessor(
+        "fastMode", &Painter::GetFastMode, &Painter::SetFastMode),
+      InstanceMethod("flush", &Painter::Flush),
+      InstanceMethod("beginTemplate", &Painter::BeginTemplate),
+      InstanceMethod("endTemplate", &Painter::EndTemplate),
+      InstanceMethod("drawTemplate", &Painter::DrawTemplate),
       InstanceMethod("finishPage", &Painter::FinishPage),
       InstanceMethod("setColor", &Painter::SetColor),
       InstanceMethod("setStrokeWidth", &Painter::SetStrokeWidth),
@@ -108,11 +124,18 @@ Painter::Initialize(Napi::Env& env, Napi::Object& target)
       InstanceMethod("endText", &Painter::EndText),
       InstanceMethod("beginText", &Painter::BeginText),
       InstanceMethod("getMultiLineText", &Painter::GetMultiLineText),
+      InstanceMethod("layoutText", &Painter::LayoutText),
+      InstanceMethod("drawTextLayout", &Painter::DrawTextLayout),
       InstanceMethod("drawTextAligned", &Painter::DrawTextAligned),
       InstanceMethod("drawLine", &Painter::DrawLine),
       InstanceMethod("drawMultiLineText", &Painter::DrawMultiLineText),
       InstanceMethod("drawText", &Painter::DrawText),
-      InstanceMethod("drawImage", &Painter::DrawImage) });
+      InstanceMethod("drawImage", &Painter::DrawImage),
+      InstanceMethod("drawImageAsync", &Painter::DrawImageAsync),
+      InstanceMethod("drawMultiLineTextAsync",
+                     &Painter::DrawMultiLineTextAsync),
+      InstanceMethod("exec", &Painter::Exec),
+      InstanceMethod("drawPath", &Painter::DrawPath) });
   constructor = Napi::Persistent(ctor);
   constructor.SuppressDestruct();
   target.Set("Painter", ctor);
@@ -120,6 +143,7 @@ Painter::Initialize(Napi::Env& env, Napi::Object& target)
 void
 Painter::SetPage(const Napi::CallbackInfo& info, const Napi::Value& value)
 {
+  AssertWritable(info.Env());
   if (!value.IsObject()) {
     throw Napi::Error::New(info.Env(), "Page must be an instance of Page.");
   }
@@ -130,12 +154,18 @@ Painter::SetPage(const Napi::CallbackInfo& info, const Napi::Value& value)
   }
   PoDoFo::PdfPage* page = pagePtr->GetPage();
   //  document = pagePtr->GetDocument();
+  try {
+    FlushWriter();
+  } catch (PdfError& err) {
+    ErrorHandler(err, info);
+  }
   painter->SetPage(page);
   pageSize = page->GetPageSize();
 }
 Napi::Value
 Painter::GetPage(const CallbackInfo& info)
 {
+  AssertIdle(info.Env());
   auto* page = dynamic_cast<PdfPage*>(painter->GetPage());
   auto pagePtr = Napi::External<PdfPage>::New(info.Env(), page);
   auto docPtr =
@@ -147,6 +177,7 @@ Painter::GetPage(const CallbackInfo& info)
 void
 Painter::SetColor(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   if (info[0].IsArray()) {
     auto jsValue = info[0].As<Array>();
     int rgb[3];
@@ -161,6 +192,7 @@ Painter::SetColor(const CallbackInfo& info)
 void
 Painter::SetColorCMYK(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   if (info.Length() < 1 || !info[0].IsArray()) {
     throw TypeError::New(
       info.Env(), "Requires CMYK color: [number, number, number, number]");
@@ -174,6 +206,7 @@ Painter::SetColorCMYK(const CallbackInfo& info)
 Napi::Value
 Painter::GetCanvas(const CallbackInfo& info)
 {
+  AssertIdle(info.Env());
   PdfStream* instance = painter->GetCanvas();
   if (!instance) {
     return info.Env().Null();
@@ -185,6 +218,7 @@ Painter::GetCanvas(const CallbackInfo& info)
 void
 Painter::SetStrokingGrey(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   AssertFunctionArgs(info, 1, { napi_valuetype::napi_number });
   double value = info[0].As<Number>();
   if (value < 0.0 || value > 1.0) {
@@ -196,6 +230,7 @@ Painter::SetStrokingGrey(const CallbackInfo& info)
 void
 Painter::SetGrey(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   AssertFunctionArgs(info, 1, { napi_valuetype::napi_number });
   double value = info[0].As<Number>();
   if (value < 0.0 || value > 1.0) {
@@ -207,6 +242,7 @@ Painter::SetGrey(const CallbackInfo& info)
 void
 Painter::SetStrokingColorCMYK(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   if (info.Length() < 1 || !info[0].IsArray()) {
     throw TypeError::New(
       info.Env(), "Requires CMYK color: [number, number, number, number]");
@@ -220,6 +256,7 @@ Painter::SetStrokingColorCMYK(const CallbackInfo& info)
 void
 Painter::SetStrokeWidth(const Napi::CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   AssertFunctionArgs(info, 1, { napi_valuetype::napi_number });
   double value = info[0].As<Number>();
   painter->SetStrokeWidth(value);
@@ -228,7 +265,9 @@ Painter::SetStrokeWidth(const Napi::CallbackInfo& info)
 void
 Painter::FinishPage(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   try {
+    FlushWriter();
     painter->FinishPage();
   } catch (PdfError& err) {
     ErrorHandler(err, info);
@@ -237,6 +276,7 @@ Painter::FinishPage(const CallbackInfo& info)
 void
 Painter::DrawText(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   AssertFunctionArgs(
     info, 2, { napi_valuetype::napi_object, napi_valuetype::napi_string });
   double x, y;
@@ -245,7 +285,13 @@ Painter::DrawText(const CallbackInfo& info)
   x = d.Get("x").As<Number>();
   y = d.Get("y").As<Number>();
   try {
-    painter->DrawText(x, y, text.c_str());
+    if (shaping) {
+      painter->BeginText(x, y);
+      AddShapedText(info.Env(), text);
+      painter->EndText();
+    } else {
+      painter->DrawText(x, y, text.c_str());
+    }
   } catch (PdfError& err) {
     ErrorHandler(err, info);
   }
@@ -253,10 +299,7 @@ Painter::DrawText(const CallbackInfo& info)
 void
 Painter::DrawMultiLineText(const CallbackInfo& info)
 {
-// For some reason windows builds break with unresolved external symbol on
-// podofo's DrawMultiLineText method
-#ifndef WIN32
-
+  AssertWritable(info.Env());
   AssertFunctionArgs(info,
                      6,
                      { napi_object,
@@ -273,58 +316,424 @@ Painter::DrawMultiLineText(const CallbackInfo& info)
     static_cast<EPdfVerticalAlignment>(info[3].As<Number>().Int32Value());
   bool clip = info[4].As<Boolean>();
   bool skipSpaces = info[5].As<Boolean>();
+  auto advances = CurrentAdvances(info.Env());
   try {
-    painter->DrawMultiLineText(rect.GetBottom(),
-                               rect.GetLeft(),
-                               rect.GetWidth(),
-                               rect.GetHeight(),
-                               PdfString(text),
-                               alignment,
-                               verticalAlignment);
-
+    DrawMultiLine(rect,
+                  text,
+                  alignment,
+                  verticalAlignment,
+                  clip,
+                  skipSpaces,
+                  advances);
   } catch (PdfError& err) {
     ErrorHandler(err, info);
   }
+}
 
-#endif
+/**
+ * @details Javascript parameters: (rect: Rect, text: string, alignment: number,
+ * verticalAlignment: number, clip: boolean, skipSpaces: boolean, cb: Function)
+ * Same as drawMultiLineText, the layout and drawing run on a worker.
+ */
+void
+Painter::DrawMultiLineTextAsync(const CallbackInfo& info)
+{
+  AssertNotDrawing(info.Env());
+  AssertFunctionArgs(info,
+                     7,
+                     { napi_object,
+                       napi_string,
+                       napi_number,
+                       napi_number,
+                       napi_boolean,
+                       napi_boolean,
+                       napi_function });
+  PdfRect rect = *Rect::Unwrap(info[0].As<Object>())->GetRect();
+  string text = info[1].As<String>().Utf8Value();
+  auto alignment =
+    static_cast<EPdfAlignment>(info[2].As<Number>().Int32Value());
+  auto verticalAlignment =
+    static_cast<EPdfVerticalAlignment>(info[3].As<Number>().Int32Value());
+  bool clip = info[4].As<Boolean>();
+  bool skipSpaces = info[5].As<Boolean>();
+  auto cb = info[6].As<Function>();
+  auto advances = CurrentAdvances(info.Env());
+  Acquire();
+  auto* worker = new PainterAsync(cb, *this, [=]() {
+    DrawMultiLine(
+      rect, text, alignment, verticalAlignment, clip, skipSpaces, advances);
+  });
+  worker->Queue();
 }
+
 void
-Painter::DrawImage(const CallbackInfo& info)
+Painter::DrawMultiLine(const PdfRect& rect,
+                       const string& text,
+                       EPdfAlignment alignment,
+                       EPdfVerticalAlignment verticalAlignment,
+                       bool clip,
+                       bool skipSpaces,
+                       std::shared_ptr<GlyphAdvanceCache> advances)
 {
-  try {
-    if (info.Length() < 3) {
-      throw Napi::Error::New(
-        info.Env(),
-        "DrawImage requires a minimum of three parameters: Image, x, y");
+  PdfFont* font = painter->GetFont();
+  TextLayoutOptions options;
+  options.width = rect.GetWidth();
+  options.alignment = alignment;
+  options.collapseSpaces = skipSpaces;
+  double size = font->GetFontSize();
+  double spacing = font->GetFontMetrics()->GetLineSpacing();
+  if (size > 0 && spacing > 0) {
+    options.lineHeight = spacing / size;
+  }
+  TextLayout layout({ { font, advances, size, text } }, options);
+  layout.Run();
+  double height = layout.GetHeight();
+  double top = rect.GetBottom() + rect.GetHeight();
+  if (verticalAlignment == ePdfVerticalAlignment_Center) {
+    top -= (rect.GetHeight() - height) / 2;
+  } else if (verticalAlignment == ePdfVerticalAlignment_Bottom) {
+    top = rect.GetBottom() + height;
+  }
+  if (clip) {
+    painter->Save();
+    painter->SetClipRect(rect);
+  }
+  layout.Draw(painter, rect.GetLeft(), top);
+  if (clip) {
+    painter->Restore();
+  }
+}
+
+/**
+ * Runs are an array of { font: Font, size?: number, text: string }, size
+ * defaults to the font's current size
+ */
+static vector<TextRun>
+ParseTextRuns(const CallbackInfo& info, const Napi::Array& js)
+{
+  vector<TextRun> runs;
+  runs.reserve(js.Length());
+  for (uint32_t i = 0; i < js.Length(); ++i) {
+    Napi::Value item = js.Get(i);
+    if (!item.IsObject()) {
+      throw Error::New(info.Env(), "text run must be an object");
     }
-    // Image
-    auto imgObj = info[0].As<Object>();
-    Image* imgInstance = Image::Unwrap(imgObj);
-    PdfImage img = imgInstance->GetImage();
-
-    // Coordinates
-    double x, y;
-    if (!info[1].IsNumber() || !info[2].IsNumber()) {
-      throw Napi::Error::New(info.Env(), "coorindates must be of type number");
+    auto run = item.As<Object>();
+    Napi::Value fontValue = run.Get("font");
+    if (!fontValue.IsObject() ||
+        !fontValue.As<Object>().InstanceOf(Font::constructor.Value())) {
+      throw Error::New(info.Env(), "text run font must be a Font");
     }
-    x = info[1].As<Number>().DoubleValue();
-    y = info[2].As<Number>().DoubleValue();
-
-    // Scaling
-    double width = 0.0, height = 0.0;
-    if (info.Length() == 5) {
-      if (!info[3].IsNumber() || !info[4].IsNumber()) {
-        throw Napi::Error::New(info.Env(),
-                               "scaling width & height must be of type number");
-      }
-      width = info[3].As<Number>().DoubleValue();
-      height = info[4].As<Number>().DoubleValue();
+    if (!run.Get("text").IsString()) {
+      throw Error::New(info.Env(), "text run text must be a string");
+    }
+    Font* font = Font::Unwrap(fontValue.As<Object>());
+    double size = font->GetPoDoFoFont()->GetFontSize();
+    if (run.Get("size").IsNumber()) {
+      size = run.Get("size").As<Number>();
     }
-    if (width != 0.0 && height != 0.0)
-      painter->DrawImage(x, y, &img, width, height);
-    else
-      painter->DrawImage(x, y, &img);
+    runs.push_back({ font->GetPoDoFoFont(),
+                     font->GetAdvanceCache(),
+                     size,
+                     run.Get("text").As<String>().Utf8Value() });
+  }
+  return runs;
+}
 
+static TextLayoutOptions
+ParseLayoutOptions(const CallbackInfo& info, double width, const Object& js)
+{
+  TextLayoutOptions options;
+  options.width = width;
+  if (js.Get("alignment").IsNumber()) {
+    options.alignment =
+      static_cast<EPdfAlignment>(js.Get("alignment").As<Number>().Int32Value());
+  }
+  if (js.Get("justify").IsBoolean()) {
+    options.justify = js.Get("justify").As<Boolean>();
+  }
+  if (js.Get("breaking").IsString()) {
+    string breaking = js.Get("breaking").As<String>().Utf8Value();
+    if (breaking == "optimal") {
+      options.breaking = LineBreaking::Optimal;
+    } else if (breaking != "greedy") {
+      throw Error::New(info.Env(), "breaking must be greedy or optimal");
+    }
+  }
+  if (js.Get("kerning").IsBoolean()) {
+    options.kerning = js.Get("kerning").As<Boolean>();
+  }
+  if (js.Get("lineHeight").IsNumber()) {
+    options.lineHeight = js.Get("lineHeight").As<Number>();
+  }
+  if (js.Get("collapseSpaces").IsBoolean()) {
+    options.collapseSpaces = js.Get("collapseSpaces").As<Boolean>();
+  }
+  if (js.Get("hyphenPenalty").IsNumber()) {
+    options.hyphenPenalty = js.Get("hyphenPenalty").As<Number>();
+  }
+  return options;
+}
+
+static Napi::Object
+LayoutToObject(Napi::Env env, const TextLayout& layout)
+{
+  auto js = Object::New(env);
+  auto lines = Array::New(env);
+  uint32_t n = 0;
+  for (auto& line : layout.GetLines()) {
+    auto l = Object::New(env);
+    l.Set("top", line.top);
+    l.Set("baseline", line.baseline);
+    l.Set("width", line.width);
+    l.Set("height", line.height);
+    l.Set("hyphenated", line.hyphenated);
+    l.Set("text", line.Text());
+    auto segments = Array::New(env);
+    uint32_t m = 0;
+    for (auto& segment : line.segments) {
+      auto s = Object::New(env);
+      s.Set("run", static_cast<double>(segment.run));
+      s.Set("x", segment.x);
+      s.Set("width", segment.width);
+      s.Set("text", TextLayout::EncodeUtf8(segment.text));
+      segments.Set(m++, s);
+    }
+    l.Set("segments", segments);
+    lines.Set(n++, l);
+  }
+  js.Set("height", layout.GetHeight());
+  js.Set("lines", lines);
+  return js;
+}
+
+Napi::Value
+Painter::LayoutText(const CallbackInfo& info)
+{
+  AssertIdle(info.Env());
+  AssertFunctionArgs(
+    info, 3, { napi_object, napi_valuetype::napi_number, napi_object });
+  vector<TextRun> runs = ParseTextRuns(info, info[0].As<Array>());
+  TextLayoutOptions options =
+    ParseLayoutOptions(info, info[1].As<Number>(), info[2].As<Object>());
+  try {
+    TextLayout layout(std::move(runs), options);
+    layout.Run();
+    return LayoutToObject(info.Env(), layout);
+  } catch (PdfError& err) {
+    ErrorHandler(err, info);
+  }
+  return info.Env().Undefined();
+}
+
+Napi::Value
+Painter::DrawTextLayout(const CallbackInfo& info)
+{
+  AssertWritable(info.Env());
+  AssertFunctionArgs(info,
+                     4,
+                     { napi_object,
+                       napi_object,
+                       napi_valuetype::napi_number,
+                       napi_object });
+  vector<TextRun> runs = ParseTextRuns(info, info[0].As<Array>());
+  auto point = info[1].As<Object>();
+  double x = point.Get("x").As<Number>();
+  double y = point.Get("y").As<Number>();
+  TextLayoutOptions options =
+    ParseLayoutOptions(info, info[2].As<Number>(), info[3].As<Object>());
+  try {
+    TextLayout layout(std::move(runs), options);
+    layout.Run();
+    layout.Draw(painter, x, y);
+    return LayoutToObject(info.Env(), layout);
+  } catch (PdfError& err) {
+    ErrorHandler(err, info);
+  }
+  return info.Env().Undefined();
+}
+
+void
+Painter::AssertNotDrawing(Napi::Env env)
+{
+  if (busy) {
+    throw Error::New(env, "Painter is busy with an asynchronous draw");
+  }
+}
+
+void
+Painter::AssertIdle(Napi::Env env)
+{
+  AssertNotDrawing(env);
+  document->AssertIdle(env);
+}
+
+void
+Painter::AssertWritable(Napi::Env env)
+{
+  AssertIdle(env);
+  document->InvalidateTextIndex();
+  // operators buffered by fast mode reach the canvas before anything written
+  // through the PdfPainter, the drawing keeps the order of the calls
+  try {
+    FlushWriter();
+  } catch (PdfError& err) {
+    throw Error::New(env, ErrorHandler::WriteMsg(err));
+  }
+}
+
+PainterAsync::PainterAsync(Function& cb,
+                           Painter& painter,
+                           std::function<void()> task)
+  : AsyncWorker(cb)
+  , painter(painter)
+  , task(std::move(task))
+{
+  refs.push_back(Persistent(painter.Value()));
+  painter.GetDocumentWrap()->Acquire();
+}
+
+void
+PainterAsync::Execute()
+{
+  try {
+    std::lock_guard<std::mutex> guard(
+      painter.GetDocumentWrap()->GetLock());
+    painter.FlushWriter();
+    task();
+  } catch (PdfError& err) {
+    SetError(ErrorHandler::WriteMsg(err));
+  } catch (std::exception& err) {
+    SetError(err.what());
+  }
+}
+
+void
+PainterAsync::OnOK()
+{
+  HandleScope scope(Env());
+  painter.Release();
+  painter.GetDocumentWrap()->Release();
+  painter.GetDocumentWrap()->InvalidateTextIndex();
+  Callback().Call({ Env().Null(), Env().Undefined() });
+}
+
+void
+PainterAsync::OnError(const Napi::Error& e)
+{
+  painter.Release();
+  painter.GetDocumentWrap()->Release();
+  AsyncWorker::OnError(e);
+}
+
+std::shared_ptr<GlyphAdvanceCache>
+Painter::CurrentAdvances(Napi::Env env)
+{
+  PdfFont* font = painter->GetFont();
+  if (!font) {
+    throw Error::New(env, "Set a font before measuring text");
+  }
+  if (!fontAdvances || fontAdvances->GetMetrics() != font->GetFontMetrics()) {
+    fontAdvances = std::make_shared<GlyphAdvanceCache>(font->GetFontMetrics());
+  }
+  return fontAdvances;
+}
+
+std::shared_ptr<TextShaper>
+Painter::CurrentShaper(Napi::Env env)
+{
+  auto advances = CurrentAdvances(env);
+  if (!fontShaper || fontShaper->GetAdvances() != advances) {
+    fontShaper = std::make_shared<TextShaper>(advances);
+  }
+  return fontShaper;
+}
+
+void
+Painter::AddShapedText(Napi::Env env, const string& text)
+{
+  auto run = CurrentShaper(env)->Shape(
+    text, shapeOptions, painter->GetFont()->GetEncoding());
+  if (run->glyphs.empty()) {
+    return;
+  }
+  ContentsWriter local(painter->GetPrecision());
+  run->Write(painter->GetFont(), local);
+  painter->GetCanvas()->Append(local.GetBuffer().data(),
+                               local.GetBuffer().size());
+}
+
+/**
+ * Javascript parameters: (image: Image, x: number, y: number, width?: number,
+ * height?: number), width and height scale the image when both are set
+ */
+static void
+ParseDrawImage(const CallbackInfo& info,
+               size_t count,
+               Image*& image,
+               double& x,
+               double& y,
+               double& width,
+               double& height)
+{
+  if (count < 3) {
+    throw Napi::Error::New(
+      info.Env(),
+      "DrawImage requires a minimum of three parameters: Image, x, y");
+  }
+  // Image
+  auto imgObj = info[0].As<Object>();
+  if (!imgObj.InstanceOf(Image::constructor.Value())) {
+    throw Napi::Error::New(info.Env(), "Image must be an instance of Image");
+  }
+  image = Image::Unwrap(imgObj);
+  if (!image->Loaded()) {
+    throw Napi::Error::New(info.Env(), "Image has no file/data loaded");
+  }
+
+  // Coordinates
+  if (!info[1].IsNumber() || !info[2].IsNumber()) {
+    throw Napi::Error::New(info.Env(), "coorindates must be of type number");
+  }
+  x = info[1].As<Number>().DoubleValue();
+  y = info[2].As<Number>().DoubleValue();
+
+  // Scaling
+  width = 0.0;
+  height = 0.0;
+  if (count == 5) {
+    if (!info[3].IsNumber() || !info[4].IsNumber()) {
+      throw Napi::Error::New(info.Env(),
+                             "scaling width & height must be of type number");
+    }
+    width = info[3].As<Number>().DoubleValue();
+    height = info[4].As<Number>().DoubleValue();
+  }
+}
+
+static void
+DrawImageAt(PdfPainter* painter,
+            PdfImage img,
+            double x,
+            double y,
+            double width,
+            double height)
+{
+  if (width != 0.0 && height != 0.0)
+    painter->DrawImage(x, y, &img, width, height);
+  else
+    painter->DrawImage(x, y, &img);
+}
+
+void
+Painter::DrawImage(const CallbackInfo& info)
+{
+  AssertWritable(info.Env());
+  try {
+    Image* image;
+    double x, y, width, height;
+    ParseDrawImage(info, info.Length(), image, x, y, width, height);
+    DrawImageAt(painter, image->GetImage(), x, y, width, height);
   } catch (PdfError& err) {
     ErrorHandler(err, info);
   } catch (Napi::Error& err) {
@@ -332,26 +741,97 @@ Painter::DrawImage(const CallbackInfo& info)
   }
 }
 
+/**
+ * @details Javascript parameters: (image: Image, x: number, y: number,
+ * width?: number, height?: number, cb: Function), the callback is always last
+ */
+void
+Painter::DrawImageAsync(const CallbackInfo& info)
+{
+  AssertNotDrawing(info.Env());
+  if (info.Length() < 4 || !info[info.Length() - 1].IsFunction()) {
+    throw Napi::Error::New(info.Env(), "drawImageAsync requires a callback");
+  }
+  Image* image;
+  double x, y, width, height;
+  ParseDrawImage(info, info.Length() - 1, image, x, y, width, height);
+  auto cb = info[info.Length() - 1].As<Function>();
+  PdfPainter* target = painter;
+  PdfImage img = image->GetImage();
+  Acquire();
+  auto* worker = new PainterAsync(cb, *this, [=]() {
+    DrawImageAt(target, img, x, y, width, height);
+  });
+  worker->Keep(info[0].As<Object>());
+  worker->Queue();
+}
+
+Napi::Value
+Painter::GetShaping(const CallbackInfo& info)
+{
+  AssertIdle(info.Env());
+  if (!shaping) {
+    return Boolean::New(info.Env(), false);
+  }
+  auto opts = Object::New(info.Env());
+  opts.Set("kerning", shapeOptions.kerning);
+  opts.Set("ligatures", shapeOptions.ligatures);
+  opts.Set("direction",
+           shapeOptions.direction == TextDirection::LeftToRight
+             ? "ltr"
+             : shapeOptions.direction == TextDirection::RightToLeft ? "rtl"
+                                                                     : "auto");
+  return opts;
+}
+
+/**
+ * Shaping on (true or ShapeOptions) draws the text of drawText,
+ * drawTextAligned and addText as kerned TJ arrays with Arabic joining,
+ * ligatures and bidirectional reordering. Underline and strike out are not
+ * drawn for shaped text.
+ */
+void
+Painter::SetShaping(const CallbackInfo& info, const Napi::Value& value)
+{
+  AssertIdle(info.Env());
+  if (value.IsBoolean()) {
+    shaping = value.As<Boolean>();
+    shapeOptions = ShapeOptions();
+  } else if (value.IsObject()) {
+    shaping = true;
+    shapeOptions = Font::ParseShapeOptions(value);
+  } else {
+    throw TypeError::New(info.Env(),
+                         "shaping must be a boolean or shape options");
+  }
+}
+
 Napi::Value
 Painter::GetPrecision(const CallbackInfo& info)
 {
+  AssertIdle(info.Env());
   return Napi::Number::New(info.Env(),
                            static_cast<double>(painter->GetPrecision()));
 }
 void
 Painter::SetPrecision(const CallbackInfo& info, const Napi::Value& value)
 {
+  AssertIdle(info.Env());
   if (!value.IsNumber()) {
     throw Napi::Error::New(info.Env(), "Precision must be of type number");
   }
   unsigned short p =
     static_cast<unsigned short>(value.As<Number>().Uint32Value());
   painter->SetPrecision(p);
+  if (writer) {
+    writer->SetPrecision(p);
+  }
 }
 
 void
 Painter::SetStrokeStyle(const Napi::CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   AssertFunctionArgs(
     info, 2, { napi_valuetype::napi_number, napi_valuetype::napi_number });
   int styleIndex = info[0].As<Number>();
@@ -362,6 +842,7 @@ Painter::SetStrokeStyle(const Napi::CallbackInfo& info)
 void
 Painter::SetLineCapStyle(const Napi::CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   AssertFunctionArgs(info, 1, { napi_valuetype::napi_number });
   painter->SetLineCapStyle(
     static_cast<EPdfLineCapStyle>(info[0].As<Number>().Int32Value()));
@@ -369,6 +850,7 @@ Painter::SetLineCapStyle(const Napi::CallbackInfo& info)
 void
 Painter::SetLineJoinStyle(const Napi::CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   AssertFunctionArgs(info, 1, { napi_valuetype::napi_number });
   painter->SetLineJoinStyle(
     static_cast<EPdfLineJoinStyle>(info[0].As<Number>().Int32Value()));
@@ -376,9 +858,12 @@ Painter::SetLineJoinStyle(const Napi::CallbackInfo& info)
 void
 Painter::SetFont(const Napi::CallbackInfo& info, const Napi::Value& value)
 {
+  AssertIdle(info.Env());
   Font* font = Font::Unwrap(value.As<Object>());
   try {
     painter->SetFont(font->GetPoDoFoFont());
+    fontAdvances = font->GetAdvanceCache();
+    fontShaper = font->GetShaper();
   } catch (PdfError& err) {
     ErrorHandler(err, info);
   }
@@ -386,12 +871,14 @@ Painter::SetFont(const Napi::CallbackInfo& info, const Napi::Value& value)
 Napi::Value
 Painter::GetFont(const Napi::CallbackInfo& info)
 {
+  AssertIdle(info.Env());
   return Font::constructor.New(
     { External<PdfFont>::New(info.Env(), painter->GetFont()) });
 }
 void
 Painter::SetClipRect(const Napi::CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   AssertFunctionArgs(info, 1, { napi_valuetype::napi_object });
   Rect* r = Rect::Unwrap(info[0].As<Object>());
   painter->SetClipRect(*r->GetRect());
@@ -400,6 +887,7 @@ Painter::SetClipRect(const Napi::CallbackInfo& info)
 void
 Painter::SetMiterLimit(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   AssertFunctionArgs(info, 1, { napi_valuetype::napi_number });
   double limit = info[0].As<Number>();
   painter->SetMiterLimit(limit);
@@ -408,6 +896,7 @@ Painter::SetMiterLimit(const CallbackInfo& info)
 void
 Painter::Rectangle(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   AssertFunctionArgs(info, 1, { napi_valuetype::napi_object });
   Rect* r = Rect::Unwrap(info[0].As<Object>());
   try {
@@ -420,6 +909,7 @@ Painter::Rectangle(const CallbackInfo& info)
 void
 Painter::Ellipse(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   AssertFunctionArgs(info, 1, { napi_valuetype::napi_object });
   auto o = info[0].As<Object>();
   double x, y, width, height;
@@ -437,6 +927,7 @@ Painter::Ellipse(const CallbackInfo& info)
 void
 Painter::Circle(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   AssertFunctionArgs(info, 1, { napi_valuetype::napi_object });
   auto o = info[0].As<Object>();
   double x, y, radius;
@@ -449,6 +940,7 @@ Painter::Circle(const CallbackInfo& info)
 void
 Painter::ClosePath(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   try {
     painter->ClosePath();
   } catch (PdfError& err) {
@@ -459,6 +951,7 @@ Painter::ClosePath(const CallbackInfo& info)
 void
 Painter::LineTo(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   AssertFunctionArgs(info, 1, { napi_valuetype::napi_object });
   auto o = info[0].As<Object>();
   double x, y;
@@ -474,6 +967,7 @@ Painter::LineTo(const CallbackInfo& info)
 void
 Painter::MoveTo(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   AssertFunctionArgs(info, 1, { napi_valuetype::napi_object });
   double x, y;
   auto o = info[0].As<Object>();
@@ -489,6 +983,7 @@ Painter::MoveTo(const CallbackInfo& info)
 void
 Painter::CubicBezierTo(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   AssertFunctionArgs(info,
                      3,
                      { napi_valuetype::napi_object,
@@ -497,7 +992,7 @@ Painter::CubicBezierTo(const CallbackInfo& info)
   auto d1 = info[0].As<Object>();
   auto d2 = info[1].As<Object>();
   auto d3 = info[2].As<Object>();
-  int d1x, d1y, d2x, d2y, d3x, d3y;
+  double d1x, d1y, d2x, d2y, d3x, d3y;
   d1x = d1.Get("x").As<Number>();
   d1y = d1.Get("y").As<Number>();
   d2x = d2.Get("x").As<Number>();
@@ -514,6 +1009,7 @@ Painter::CubicBezierTo(const CallbackInfo& info)
 void
 Painter::HorizontalLineTo(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   AssertFunctionArgs(info, 1, { napi_valuetype::napi_number });
   double value = info[0].As<Number>();
   try {
@@ -526,6 +1022,7 @@ Painter::HorizontalLineTo(const CallbackInfo& info)
 void
 Painter::VerticalLineTo(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   AssertFunctionArgs(info, 1, { napi_valuetype::napi_number });
   double value = info[0].As<Number>();
   try {
@@ -538,6 +1035,7 @@ Painter::VerticalLineTo(const CallbackInfo& info)
 void
 Painter::SmoothCurveTo(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   AssertFunctionArgs(
     info, 2, { napi_valuetype::napi_object, napi_valuetype::napi_object });
   auto d1 = info[0].As<Object>();
@@ -557,11 +1055,12 @@ Painter::SmoothCurveTo(const CallbackInfo& info)
 void
 Painter::QuadCurveTo(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   AssertFunctionArgs(
     info, 2, { napi_valuetype::napi_object, napi_valuetype::napi_object });
   auto d1 = info[0].As<Object>();
   auto d2 = info[1].As<Object>();
-  int d1x, d1y, d2x, d2y;
+  double d1x, d1y, d2x, d2y;
   d1x = d1.Get("x").As<Number>();
   d1y = d1.Get("y").As<Number>();
   d2x = d2.Get("x").As<Number>();
@@ -576,6 +1075,7 @@ Painter::QuadCurveTo(const CallbackInfo& info)
 void
 Painter::ArcTo(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   AssertFunctionArgs(info,
                      5,
                      {
@@ -601,6 +1101,7 @@ Painter::ArcTo(const CallbackInfo& info)
 void
 Painter::Close(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   try {
     painter->Close();
   } catch (PdfError& err) {
@@ -611,6 +1112,7 @@ Painter::Close(const CallbackInfo& info)
 void
 Painter::Stroke(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   try {
     painter->Stroke();
   } catch (PdfError& err) {
@@ -621,6 +1123,7 @@ Painter::Stroke(const CallbackInfo& info)
 void
 Painter::FillAndStroke(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   try {
     painter->FillAndStroke();
   } catch (PdfError& err) {
@@ -631,6 +1134,7 @@ Painter::FillAndStroke(const CallbackInfo& info)
 void
 Painter::Fill(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   try {
     painter->Fill();
   } catch (PdfError& err) {
@@ -641,6 +1145,7 @@ Painter::Fill(const CallbackInfo& info)
 void
 Painter::EndPath(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   try {
     painter->EndPath();
   } catch (PdfError& err) {
@@ -651,6 +1156,7 @@ Painter::EndPath(const CallbackInfo& info)
 void
 Painter::Clip(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   try {
     painter->Clip();
   } catch (PdfError& err) {
@@ -661,6 +1167,7 @@ Painter::Clip(const CallbackInfo& info)
 void
 Painter::Save(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   try {
     painter->Save();
   } catch (PdfError& err) {
@@ -671,6 +1178,7 @@ Painter::Save(const CallbackInfo& info)
 void
 Painter::Restore(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   try {
     painter->Restore();
   } catch (PdfError& err) {
@@ -681,6 +1189,7 @@ Painter::Restore(const CallbackInfo& info)
 void
 Painter::SetExtGState(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   AssertFunctionArgs(info, 1, { napi_valuetype::napi_object });
   auto wrap = info[0].As<Object>();
   if (!wrap.InstanceOf(ExtGState::constructor.Value())) {
@@ -697,6 +1206,7 @@ Painter::SetExtGState(const CallbackInfo& info)
 void
 Painter::SetTabWidth(const CallbackInfo& info, const Napi::Value& value)
 {
+  AssertIdle(info.Env());
   int n = value.As<Number>();
   try {
     painter->SetTabWidth(static_cast<unsigned short>(n));
@@ -708,18 +1218,21 @@ Painter::SetTabWidth(const CallbackInfo& info, const Napi::Value& value)
 Napi::Value
 Painter::GetTabWidth(const CallbackInfo& info)
 {
+  AssertIdle(info.Env());
   return Number::New(info.Env(), painter->GetTabWidth());
 }
 
 Napi::Value
 Painter::GetCurrentPath(const CallbackInfo& info)
 {
+  AssertIdle(info.Env());
   return String::New(info.Env(), painter->GetCurrentPath().str());
 }
 
 void
 Painter::DrawLine(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   AssertFunctionArgs(
     info, 2, { napi_valuetype::napi_object, napi_valuetype::napi_object });
   auto start = info[0].As<Object>();
@@ -735,6 +1248,7 @@ Painter::DrawLine(const CallbackInfo& info)
 void
 Painter::DrawTextAligned(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   AssertFunctionArgs(info,
                      3,
                      { napi_valuetype::napi_object,
@@ -749,7 +1263,21 @@ Painter::DrawTextAligned(const CallbackInfo& info)
   y = o.Get("y").As<Number>();
   width = o.Get("width").As<Number>();
   try {
-    painter->DrawTextAligned(x, y, width, PdfString(text), alignment);
+    if (shaping) {
+      auto run = CurrentShaper(info.Env())
+                   ->Shape(text, shapeOptions, painter->GetFont()->GetEncoding());
+      double w = run->Width(painter->GetFont());
+      if (alignment == ePdfAlignment_Center) {
+        x += (width - w) / 2;
+      } else if (alignment == ePdfAlignment_Right) {
+        x += width - w;
+      }
+      painter->BeginText(x, y);
+      AddShapedText(info.Env(), text);
+      painter->EndText();
+    } else {
+      painter->DrawTextAligned(x, y, width, PdfString(text), alignment);
+    }
   } catch (PdfError& err) {
     ErrorHandler(err, info);
   }
@@ -758,8 +1286,8 @@ Painter::DrawTextAligned(const CallbackInfo& info)
 Napi::Value
 Painter::GetMultiLineText(const CallbackInfo& info)
 {
-  return info.Env().Undefined();
-  /*AssertFunctionArgs(info,
+  AssertIdle(info.Env());
+  AssertFunctionArgs(info,
                      3,
                      { napi_valuetype::napi_number,
                        napi_valuetype::napi_string,
@@ -767,25 +1295,33 @@ Painter::GetMultiLineText(const CallbackInfo& info)
   double width = info[0].As<Number>();
   string text = info[1].As<String>().Utf8Value();
   bool skipSpaces = info[2].As<Boolean>();
-  vector<PdfString> lines =
-#if PODOFO_VERSION_PATCH >= 6
-    painter->GetMultiLineTextAsLines(width, PdfString(text), skipSpaces);
-#else
-    painter->GetMultiLineTextAsLines(width, PdfString(text));
-#endif
-
+  PdfFont* font = painter->GetFont();
+  if (!font) {
+    throw Error::New(info.Env(), "Set a font before measuring text");
+  }
   auto js = Array::New(info.Env());
-  uint32_t count = 0;
-  for (auto& i : lines) {
-    js.Set(count, i.GetStringUtf8());
-    count++;
+  try {
+    TextLayoutOptions options;
+    options.width = width;
+    options.collapseSpaces = skipSpaces;
+    TextLayout layout(
+      { { font, CurrentAdvances(info.Env()), font->GetFontSize(), text } },
+      options);
+    layout.Run();
+    uint32_t count = 0;
+    for (auto& line : layout.GetLines()) {
+      js.Set(count++, line.Text());
+    }
+  } catch (PdfError& err) {
+    ErrorHandler(err, info);
   }
-  return js;*/
+  return js;
 }
 
 void
 Painter::BeginText(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   AssertFunctionArgs(info, 1, { napi_valuetype::napi_object });
   auto point = info[0].As<Object>();
   double x, y;
@@ -801,6 +1337,7 @@ Painter::BeginText(const CallbackInfo& info)
 void
 Painter::EndText(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   try {
     painter->EndText();
   } catch (PdfError& err) {
@@ -811,9 +1348,14 @@ Painter::EndText(const CallbackInfo& info)
 void
 Painter::AddText(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   AssertFunctionArgs(info, 1, { napi_valuetype::napi_string });
   try {
-    painter->AddText(PdfString(info[0].As<String>().Utf8Value()));
+    if (shaping) {
+      AddShapedText(info.Env(), info[0].As<String>().Utf8Value());
+    } else {
+      painter->AddText(PdfString(info[0].As<String>().Utf8Value()));
+    }
   } catch (PdfError& err) {
     ErrorHandler(err, info);
   }
@@ -822,6 +1364,7 @@ Painter::AddText(const CallbackInfo& info)
 void
 Painter::MoveTextPosition(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   AssertFunctionArgs(info, 1, { napi_valuetype::napi_object });
   auto point = info[0].As<Object>();
   double x, y;
@@ -837,6 +1380,7 @@ Painter::MoveTextPosition(const CallbackInfo& info)
 void
 Painter::DrawGlyph(const CallbackInfo& info)
 {
+  AssertWritable(info.Env());
   AssertFunctionArgs(
     info, 2, { napi_valuetype::napi_object, napi_valuetype::napi_string });
   auto point = info[0].As<Object>();
@@ -851,6 +1395,311 @@ Painter::DrawGlyph(const CallbackInfo& info)
   }
 }
 
+/**
+ * @details Javascript parameters: (opcodes: Uint8Array, args: Float64Array)
+ */
+void
+Painter::Exec(const CallbackInfo& info)
+{
+  AssertIdle(info.Env());
+  // joins the output of earlier exec and drawPath calls in the fast mode
+  // buffer, flushed by the next call writing through the PdfPainter
+  document->InvalidateTextIndex();
+  AssertFunctionArgs(info, 2, { napi_object, napi_object });
+  if (!info[0].IsTypedArray() ||
+      info[0].As<TypedArray>().TypedArrayType() != napi_uint8_array ||
+      !info[1].IsTypedArray() ||
+      info[1].As<TypedArray>().TypedArrayType() != napi_float64_array) {
+    throw TypeError::New(info.Env(),
+                         "exec requires (opcodes: Uint8Array, args: "
+                         "Float64Array)");
+  }
+  auto ops = info[0].As<Uint8Array>();
+  auto args = info[1].As<Float64Array>();
+  PainterSink sink(painter);
+  try {
+    ReplayCommands(ops.Data(),
+                   ops.ElementLength(),
+                   args.Data(),
+                   args.ElementLength(),
+                   writer ? static_cast<CommandSink&>(*writer) : sink);
+  } catch (PdfError& err) {
+    ErrorHandler(err, info);
+  } catch (std::invalid_argument& err) {
+    throw Error::New(info.Env(), err.what());
+  }
+}
+
+/**
+ * @details Javascript parameters: (points: Float64Array, options: {counts?:
+ * number[], transform?: number[], tolerance?: number, close?: boolean,
+ * operation?: string})
+ * points are interleaved x, y pairs, counts splits them into subpaths. The
+ * transform is applied to the points before simplifying, so tolerance is in
+ * page units. Returns the number of points drawn.
+ */
+Napi::Value
+Painter::DrawPath(const CallbackInfo& info)
+{
+  AssertIdle(info.Env());
+  // joins the output of earlier exec and drawPath calls in the fast mode
+  // buffer, flushed by the next call writing through the PdfPainter
+  document->InvalidateTextIndex();
+  AssertFunctionArgs(info, 2, { napi_object, napi_object });
+  if (!info[0].IsTypedArray() ||
+      info[0].As<TypedArray>().TypedArrayType() != napi_float64_array) {
+    throw TypeError::New(info.Env(), "drawPath requires a Float64Array");
+  }
+  if (!painter->GetCanvas()) {
+    throw Error::New(info.Env(), "Painter has no page or template to draw on");
+  }
+  auto points = info[0].As<Float64Array>();
+  auto options = info[1].As<Object>();
+  if (points.ElementLength() % 2) {
+    throw Error::New(info.Env(), "points must hold x, y pairs");
+  }
+  size_t count = points.ElementLength() / 2;
+
+  vector<size_t> counts;
+  if (options.Get("counts").IsArray()) {
+    auto js = options.Get("counts").As<Array>();
+    size_t total = 0;
+    for (uint32_t i = 0; i < js.Length(); ++i) {
+      counts.push_back(js.Get(i).As<Number>().Uint32Value());
+      total += counts.back();
+    }
+    if (total != count) {
+      throw Error::New(info.Env(), "counts must add up to the number of points");
+    }
+  } else {
+    counts.push_back(count);
+  }
+  double tolerance = 0;
+  if (options.Get("tolerance").IsNumber()) {
+    tolerance = options.Get("tolerance").As<Number>();
+  }
+  bool close = options.Get("close").IsBoolean() &&
+               options.Get("close").As<Boolean>().Value();
+  PaintOp operation = PaintOp::Stroke;
+  bool paint = true;
+  if (options.Get("operation").IsString()) {
+    string op = options.Get("operation").As<String>().Utf8Value();
+    if (op == "fill") {
+      operation = PaintOp::Fill;
+    } else if (op == "fillAndStroke") {
+      operation = PaintOp::FillAndStroke;
+    } else if (op == "clip") {
+      operation = PaintOp::Clip;
+    } else if (op == "none") {
+      paint = false;
+    } else if (op != "stroke") {
+      throw Error::New(info.Env(),
+                       "operation must be stroke, fill, fillAndStroke, clip "
+                       "or none");
+    }
+  }
+
+  const double* source = points.Data();
+  vector<double> transformed;
+  if (options.Get("transform").IsArray()) {
+    auto js = options.Get("transform").As<Array>();
+    if (js.Length() != 6) {
+      throw Error::New(info.Env(), "transform must be [a, b, c, d, e, f]");
+    }
+    double matrix[6];
+    for (uint32_t i = 0; i < 6; ++i) {
+      matrix[i] = js.Get(i).As<Number>();
+    }
+    transformed.resize(count * 2);
+    const size_t chunk = 1 << 16;
+    ParallelFor((count + chunk - 1) / chunk, [&](size_t i) {
+      size_t begin = i * chunk, n = std::min(chunk, count - begin);
+      TransformPoints(
+        source + begin * 2, transformed.data() + begin * 2, n, matrix);
+    });
+    source = transformed.data();
+  }
+
+  vector<size_t> offsets(counts.size(), 0);
+  for (size_t i = 1; i < counts.size(); ++i) {
+    offsets[i] = offsets[i - 1] + counts[i - 1];
+  }
+  vector<uint8_t> keep(count, 1);
+  std::atomic<size_t> kept(count);
+  if (tolerance > 0) {
+    ParallelFor(counts.size(), [&](size_t i) {
+      size_t k = SimplifyPolyline(
+        source + offsets[i] * 2, counts[i], tolerance, keep.data() + offsets[i]);
+      kept -= counts[i] - k;
+    });
+  }
+
+  try {
+    ContentsWriter local(painter->GetPrecision());
+    CommandSink& sink = writer ? static_cast<CommandSink&>(*writer) : local;
+    for (size_t i = 0; i < counts.size(); ++i) {
+      EmitPolyline(sink,
+                   source + offsets[i] * 2,
+                   counts[i],
+                   keep.data() + offsets[i],
+                   close);
+    }
+    if (paint) {
+      sink.Command(operation, nullptr);
+    }
+    if (!writer) {
+      painter->GetCanvas()->Append(local.GetBuffer().data(),
+                                   local.GetBuffer().size());
+    }
+  } catch (PdfError& err) {
+    ErrorHandler(err, info);
+  }
+  return Number::New(info.Env(), static_cast<double>(kept.load()));
+}
+
+Napi::Value
+Painter::GetFastMode(const CallbackInfo& info)
+{
+  AssertIdle(info.Env());
+  return Boolean::New(info.Env(), writer != nullptr);
+}
+
+/**
+ * In fast mode exec and drawPath write straight into a buffer that is
+ * appended to the page canvas on flush, finishPage, when the page changes or
+ * before any other drawing method writes to the canvas.
+ */
+void
+Painter::SetFastMode(const CallbackInfo& info, const Napi::Value& value)
+{
+  AssertWritable(info.Env());
+  if (!value.IsBoolean()) {
+    throw TypeError::New(info.Env(), "fastMode must be of type boolean");
+  }
+  if (value.As<Boolean>() && !writer) {
+    writer = new ContentsWriter(painter->GetPrecision());
+  } else if (!value.As<Boolean>() && writer) {
+    try {
+      FlushWriter();
+    } catch (PdfError& err) {
+      ErrorHandler(err, info);
+    }
+    delete writer;
+    writer = nullptr;
+  }
+}
+
+void
+Painter::Flush(const CallbackInfo& info)
+{
+  AssertWritable(info.Env());
+  try {
+    FlushWriter();
+  } catch (PdfError& err) {
+    ErrorHandler(err, info);
+  }
+}
+
+void
+Painter::FlushWriter()
+{
+  if (!writer || writer->GetBuffer().empty() || !painter->GetCanvas()) {
+    return;
+  }
+  std::string& buffer = writer->GetBuffer();
+  painter->GetCanvas()->Append(buffer.data(), buffer.size());
+  buffer.clear();
+}
+
+/**
+ * @details Javascript parameters: (bbox: Rect)
+ * Following drawing goes into a new Form XObject until endTemplate
+ */
+void
+Painter::BeginTemplate(const CallbackInfo& info)
+{
+  AssertWritable(info.Env());
+  AssertFunctionArgs(info, 1, { napi_valuetype::napi_object });
+  if (xobject) {
+    throw Error::New(info.Env(), "endTemplate must be called first");
+  }
+  Rect* rect = Rect::Unwrap(info[0].As<Object>());
+  try {
+    FlushWriter();
+    xobject = new PdfXObject(*rect->GetRect(), document->GetDocument());
+    auto* templatePainter = new PdfPainter();
+    templatePainter->SetPrecision(painter->GetPrecision());
+    templatePainter->SetPage(xobject);
+    pagePainter = painter;
+    painter = templatePainter;
+  } catch (PdfError& err) {
+    ErrorHandler(err, info);
+  }
+}
+
+/**
+ * @details Finishes the template and returns to the page painter as it was
+ * before beginTemplate. Returns the template object for drawTemplate.
+ */
+Napi::Value
+Painter::EndTemplate(const CallbackInfo& info)
+{
+  AssertWritable(info.Env());
+  if (!xobject) {
+    throw Error::New(info.Env(), "beginTemplate must be called first");
+  }
+  PdfObject* result = nullptr;
+  try {
+    FlushWriter();
+    painter->FinishPage();
+    result = new PdfObject(*xobject->GetObject());
+    delete xobject;
+    xobject = nullptr;
+    delete painter;
+    painter = pagePainter;
+    pagePainter = nullptr;
+  } catch (PdfError& err) {
+    ErrorHandler(err, info);
+  }
+  return Obj::constructor.New({ External<PdfObject>::New(info.Env(), result) });
+}
+
+/**
+ * @details Javascript parameters: (template: Obj, x: number, y: number,
+ * scale: number)
+ */
+void
+Painter::DrawTemplate(const CallbackInfo& info)
+{
+  AssertWritable(info.Env());
+  AssertFunctionArgs(info,
+                     4,
+                     { napi_valuetype::napi_object,
+                       napi_valuetype::napi_number,
+                       napi_valuetype::napi_number,
+                       napi_valuetype::napi_number });
+  auto wrap = info[0].As<Object>();
+  if (!wrap.InstanceOf(Obj::constructor.Value())) {
+    throw TypeError::New(info.Env(), "template must be an Obj from endTemplate");
+  }
+  // the Obj holds a copy, draw the template object owned by the document
+  PdfObject* target = document->GetDocument()->GetObjects().GetObject(
+    Obj::Unwrap(wrap)->GetObject()->Reference());
+  if (!target) {
+    throw Error::New(info.Env(), "template not found in this document");
+  }
+  double x = info[1].As<Number>();
+  double y = info[2].As<Number>();
+  double scale = info[3].As<Number>();
+  try {
+    FlushWriter();
+    PdfXObject form(target);
+    painter->DrawXObject(x, y, &form, scale, scale);
+  } catch (PdfError& err) {
+    ErrorHandler(err, info);
+  }
+}
+
 void
 Painter::GetCMYK(Napi::Value& value, int* cmyk)
 {
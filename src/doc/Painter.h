@@ -22,12 +22,47 @@
 
 #define CONVERSION_CONSTANT 0.002834645669291339
 
+#include "ContentsWriter.h"
 #include "Document.h"
+#include "TextLayout.h"
+#include "TextShaper.h"
 
+#include <functional>
 #include <napi.h>
 #include <podofo/podofo.h>
+#include <vector>
 
 namespace NoPoDoFo {
+class Painter;
+
+/**
+ * Runs a draw on the worker pool. The painter is claimed for the duration
+ * and the document lock is held while the task runs, the document counts the
+ * worker until it completes, references keep the
+ * painter and any inputs alive until the callback is called.
+ */
+class PainterAsync : public Napi::AsyncWorker
+{
+public:
+  PainterAsync(Napi::Function& cb,
+               Painter& painter,
+               std::function<void()> task);
+  void Keep(const Napi::Object& value)
+  {
+    refs.push_back(Napi::Persistent(value));
+  }
+
+private:
+  Painter& painter;
+  std::function<void()> task;
+  std::vector<Napi::ObjectReference> refs;
+
+protected:
+  void Execute() override;
+  void OnOK() override;
+  void OnError(const Napi::Error&) override;
+};
+
 class Painter : public Napi::ObjectWrap<Painter>
 {
 public:
@@ -82,24 +117,83 @@ public:
   void DrawText(const Napi::CallbackInfo&);
   void DrawImage(const Napi::CallbackInfo&);
   void DrawMultiLineText(const Napi::CallbackInfo&);
+  void DrawImageAsync(const Napi::CallbackInfo&);
+  void DrawMultiLineTextAsync(const Napi::CallbackInfo&);
   void DrawLine(const Napi::CallbackInfo&);
   void DrawTextAligned(const Napi::CallbackInfo&);
   Napi::Value GetMultiLineText(const Napi::CallbackInfo&);
+  Napi::Value LayoutText(const Napi::CallbackInfo&);
+  Napi::Value DrawTextLayout(const Napi::CallbackInfo&);
   void BeginText(const Napi::CallbackInfo& info);
   void EndText(const Napi::CallbackInfo& info);
   void AddText(const Napi::CallbackInfo&);
   void MoveTextPosition(const Napi::CallbackInfo&);
   void DrawGlyph(const Napi::CallbackInfo&);
+  Napi::Value GetShaping(const Napi::CallbackInfo&);
+  void SetShaping(const Napi::CallbackInfo&, const Napi::Value&);
   Napi::Value GetPrecision(const Napi::CallbackInfo&);
   void SetPrecision(const Napi::CallbackInfo&, const Napi::Value&);
+  void Exec(const Napi::CallbackInfo&);
+  Napi::Value DrawPath(const Napi::CallbackInfo&);
+  Napi::Value GetFastMode(const Napi::CallbackInfo&);
+  void SetFastMode(const Napi::CallbackInfo&, const Napi::Value&);
+  void Flush(const Napi::CallbackInfo&);
+  void BeginTemplate(const Napi::CallbackInfo&);
+  Napi::Value EndTemplate(const Napi::CallbackInfo&);
+  void DrawTemplate(const Napi::CallbackInfo&);
 
   PoDoFo::PdfMemDocument* GetDocument() { return document->GetDocument(); }
   PoDoFo::PdfPainter* GetPainter() { return painter; }
+  Document* GetDocumentWrap() { return document; }
+  // Claim the painter for an async draw, false when one is already running
+  bool Acquire()
+  {
+    if (busy) {
+      return false;
+    }
+    busy = true;
+    return true;
+  }
+  void Release() { busy = false; }
+  // Throws while an async draw owns the painter
+  void AssertNotDrawing(Napi::Env);
+  // Also throws while any worker holds the document, synchronous calls only
+  void AssertIdle(Napi::Env);
+  // AssertIdle for calls writing to the canvas, the text indices of the
+  // document go stale with the drawing
+  void AssertWritable(Napi::Env);
+  // Append the operators buffered by fast mode to the canvas
+  void FlushWriter();
 
 private:
   PoDoFo::PdfPainter* painter;
   //  PoDoFo::PdfMemDocument* document;
   Document* document;
+  // fast mode only, buffers exec output until the next flush
+  ContentsWriter* writer = nullptr;
+  // template being recorded, drawn through its own PdfPainter while the
+  // page painter and its graphics state wait in pagePainter
+  PoDoFo::PdfXObject* xobject = nullptr;
+  PoDoFo::PdfPainter* pagePainter = nullptr;
+  // glyph advances of the font set through the font accessor
+  std::shared_ptr<GlyphAdvanceCache> fontAdvances;
+  // text drawn through drawText, drawTextAligned and addText is shaped
+  bool shaping = false;
+  ShapeOptions shapeOptions;
+  std::shared_ptr<TextShaper> fontShaper;
+  // only touched on the main thread, see Acquire
+  bool busy = false;
+  std::shared_ptr<GlyphAdvanceCache> CurrentAdvances(Napi::Env);
+  std::shared_ptr<TextShaper> CurrentShaper(Napi::Env);
+  // a TJ operator for text, inside a text object
+  void AddShapedText(Napi::Env, const std::string& text);
+  void DrawMultiLine(const PoDoFo::PdfRect&,
+                     const std::string& text,
+                     PoDoFo::EPdfAlignment,
+                     PoDoFo::EPdfVerticalAlignment,
+                     bool clip,
+                     bool skipSpaces,
+                     std::shared_ptr<GlyphAdvanceCache>);
   void GetCMYK(Napi::Value&, int* cmyk);
   void GetRGB(Napi::Value&, int* rgb);
 };
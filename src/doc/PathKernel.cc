@@ -0,0 +1,150 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PathKernel.h"
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+  (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NPDF_SSE2
+#endif
+
+namespace NoPoDoFo {
+
+void
+TransformPoints(const double* in,
+                double* out,
+                size_t count,
+                const double* matrix)
+{
+#ifdef NPDF_SSE2
+  // one point per register: x' = a x + c y + e in the low lane,
+  // y' = b x + d y + f in the high lane
+  const __m128d ab = _mm_set_pd(matrix[1], matrix[0]);
+  const __m128d cd = _mm_set_pd(matrix[3], matrix[2]);
+  const __m128d ef = _mm_set_pd(matrix[5], matrix[4]);
+  for (size_t i = 0; i < count; ++i) {
+    __m128d p = _mm_loadu_pd(in + 2 * i);
+    __m128d x = _mm_unpacklo_pd(p, p);
+    __m128d y = _mm_unpackhi_pd(p, p);
+    __m128d r =
+      _mm_add_pd(_mm_add_pd(_mm_mul_pd(x, ab), _mm_mul_pd(y, cd)), ef);
+    _mm_storeu_pd(out + 2 * i, r);
+  }
+#else
+  const double a = matrix[0], b = matrix[1], c = matrix[2], d = matrix[3],
+               e = matrix[4], f = matrix[5];
+  for (size_t i = 0; i < count; ++i) {
+    double x = in[2 * i], y = in[2 * i + 1];
+    out[2 * i] = a * x + c * y + e;
+    out[2 * i + 1] = b * x + d * y + f;
+  }
+#endif
+}
+
+// squared distance from p to the segment s0 s1
+static double
+SegmentDistance2(const double* p, const double* s0, const double* s1)
+{
+  double dx = s1[0] - s0[0], dy = s1[1] - s0[1];
+  double px = p[0] - s0[0], py = p[1] - s0[1];
+  double length2 = dx * dx + dy * dy;
+  if (length2 > 0) {
+    double t = (px * dx + py * dy) / length2;
+    if (t > 1) {
+      px = p[0] - s1[0];
+      py = p[1] - s1[1];
+    } else if (t > 0) {
+      px -= t * dx;
+      py -= t * dy;
+    }
+  }
+  return px * px + py * py;
+}
+
+size_t
+SimplifyPolyline(const double* points,
+                 size_t count,
+                 double tolerance,
+                 uint8_t* keep)
+{
+  if (count <= 2 || tolerance <= 0) {
+    for (size_t i = 0; i < count; ++i) {
+      keep[i] = 1;
+    }
+    return count;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    keep[i] = 0;
+  }
+  keep[0] = keep[count - 1] = 1;
+  size_t kept = 2;
+  double tolerance2 = tolerance * tolerance;
+  // explicit stack, traces can be long enough to overflow a recursive one
+  std::vector<std::pair<size_t, size_t>> stack;
+  stack.emplace_back(0, count - 1);
+  while (!stack.empty()) {
+    size_t first = stack.back().first, last = stack.back().second;
+    stack.pop_back();
+    double furthest = 0;
+    size_t index = first;
+    for (size_t i = first + 1; i < last; ++i) {
+      double d =
+        SegmentDistance2(points + 2 * i, points + 2 * first, points + 2 * last);
+      if (d > furthest) {
+        furthest = d;
+        index = i;
+      }
+    }
+    if (furthest > tolerance2) {
+      keep[index] = 1;
+      ++kept;
+      if (index - first > 1) {
+        stack.emplace_back(first, index);
+      }
+      if (last - index > 1) {
+        stack.emplace_back(index, last);
+      }
+    }
+  }
+  return kept;
+}
+
+void
+EmitPolyline(CommandSink& sink,
+             const double* points,
+             size_t count,
+             const uint8_t* keep,
+             bool close)
+{
+  bool started = false;
+  for (size_t i = 0; i < count; ++i) {
+    if (keep && !keep[i]) {
+      continue;
+    }
+    sink.Command(started ? PaintOp::LineTo : PaintOp::MoveTo, points + 2 * i);
+    started = true;
+  }
+  if (started && close) {
+    sink.Command(PaintOp::ClosePath, nullptr);
+  }
+}
+}
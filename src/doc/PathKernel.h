@@ -0,0 +1,68 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NPDF_PATHKERNEL_H
+#define NPDF_PATHKERNEL_H
+
+#include "CommandBuffer.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace NoPoDoFo {
+
+/**
+ * Geometry helpers for large point sets. Points are interleaved x, y pairs
+ * and nothing here touches the document, so the work can be split across
+ * threads by the caller.
+ */
+
+/**
+ * Apply the affine matrix [a b c d e f] (as in the cm operator) to count
+ * points. in and out may be the same buffer. Uses SSE2 when the target
+ * supports it.
+ */
+void
+TransformPoints(const double* in,
+                double* out,
+                size_t count,
+                const double* matrix);
+
+/**
+ * Douglas-Peucker simplification of a polyline. keep receives one flag per
+ * point, the end points are always kept and no kept point is further than
+ * tolerance from the simplified line. A tolerance <= 0 keeps every point.
+ * Returns the number of points kept.
+ */
+size_t
+SimplifyPolyline(const double* points,
+                 size_t count,
+                 double tolerance,
+                 uint8_t* keep);
+
+/**
+ * Emit the kept points of a polyline as a subpath, keep may be null
+ */
+void
+EmitPolyline(CommandSink& sink,
+             const double* points,
+             size_t count,
+             const uint8_t* keep,
+             bool close);
+}
+#endif // NPDF_PATHKERNEL_H
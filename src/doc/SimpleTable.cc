@@ -19,10 +19,17 @@
 
 #include "SimpleTable.h"
 #include "../ErrorHandler.h"
+#include "../Parallel.h"
 #include "../ValidateArguments.h"
 #include "Font.h"
 #include "Page.h"
 #include "Painter.h"
+#include "Rect.h"
+#include "TableModel.h"
+#include "TextLayout.h"
+
+#include <algorithm>
+#include <limits>
 
 
 namespace NoPoDoFo {
@@ -39,17 +46,15 @@ SimpleTable::SimpleTable(const CallbackInfo& info)
   doc = Document::Unwrap(info[0].As<Object>());
   const int cols = info[1].As<Number>();
   const int rows = info[2].As<Number>();
-  model = new PdfSimpleTableModel(cols, rows);
+  model = new TableModel(cols, rows);
   table = new PdfTable(cols, rows);
 }
 
 SimpleTable::~SimpleTable()
 {
   HandleScope scope(Env());
-  delete model;
   delete table;
-  delete backgroundColor;
-  delete foregroundColor;
+  delete model;
   doc = nullptr;
 }
 
@@ -91,7 +96,10 @@ SimpleTable::Initialize(Napi::Env& env, Napi::Object& target)
       InstanceAccessor("autoPageBreak",
                        &SimpleTable::GetAutoPageBreak,
                        &SimpleTable::SetAutoPageBreak),
+      InstanceMethod("setData", &SimpleTable::SetData),
       InstanceMethod("draw", &SimpleTable::Draw),
+      InstanceMethod("drawAsync", &SimpleTable::DrawAsync),
+      InstanceMethod("layout", &SimpleTable::Layout),
       InstanceMethod("getTableWidth", &SimpleTable::GetWidth),
       InstanceMethod("getTableHeight", &SimpleTable::GetHeight),
       InstanceMethod("columnCount", &SimpleTable::GetCols),
@@ -122,8 +130,9 @@ SimpleTable::SetFont(const CallbackInfo& info, const Napi::Value& value)
       !value.As<Object>().InstanceOf(Font::constructor.Value())) {
     throw Error::New(info.Env(), "value must be an instance of NoPoDoFo Font");
   }
-  const auto pFont = Font::Unwrap(value.As<Object>())->GetPoDoFoFont();
-  model->SetFont(pFont);
+  Font* font = Font::Unwrap(value.As<Object>());
+  AddFont(font);
+  model->SetFont(font->GetPoDoFoFont());
 }
 
 Value
@@ -144,6 +153,149 @@ SimpleTable::SetText(const CallbackInfo& info, const Napi::Value& value)
   model->SetText(col, row, text);
 }
 
+// packed colour value keeping the table colour
+static const uint32_t NoColor = 0xFFFFFFFF;
+
+/**
+ * Per cell style array of the given type, empty when the key is not set
+ */
+template<typename T>
+static TypedArrayOf<T>
+CellStyles(const CallbackInfo& info,
+           const Object& styles,
+           const char* key,
+           napi_typedarray_type type,
+           size_t cells)
+{
+  if (!styles.Has(key) || styles.Get(key).IsUndefined()) {
+    return TypedArrayOf<T>();
+  }
+  auto value = styles.Get(key);
+  if (!value.IsTypedArray() ||
+      value.As<TypedArray>().TypedArrayType() != type ||
+      value.As<TypedArray>().ElementLength() != cells) {
+    throw Error::New(info.Env(),
+                     string(key) + " must be a typed array with a value for "
+                                   "every cell");
+  }
+  return value.As<TypedArrayOf<T>>();
+}
+
+/**
+ * @details Javascript parameters: (data: string[][], columnMajor: boolean,
+ * styles: { fonts?: Font[], font?: Uint16Array, foreground?: Uint32Array,
+ * background?: Uint32Array, border?: Uint32Array, alignment?: Int8Array,
+ * verticalAlignment?: Int8Array, wordWrap?: Int8Array })
+ * data is indexed [row][col], or [col][row] when columnMajor is set. Style
+ * arrays hold a value per cell in row major order: font is 0 for the table
+ * font or n for fonts[n - 1], colours are packed 0xRRGGBB with 0xFFFFFFFF for
+ * the table colour, alignments and wordWrap are -1 for the table setting.
+ */
+void
+SimpleTable::SetData(const CallbackInfo& info)
+{
+  AssertFunctionArgs(info, 3, { napi_object, napi_boolean, napi_object });
+  auto data = info[0].As<Array>();
+  const bool columnMajor = info[1].As<Boolean>();
+  auto styles = info[2].As<Object>();
+  const int cols = model->GetCols();
+  const int rows = model->GetRows();
+  const size_t cells = static_cast<size_t>(cols) * rows;
+  const int outer = columnMajor ? cols : rows;
+  const int inner = columnMajor ? rows : cols;
+  if (data.Length() > static_cast<uint32_t>(outer)) {
+    throw Error::New(info.Env(), "data has more rows or columns than the table");
+  }
+  for (uint32_t i = 0; i < data.Length(); ++i) {
+    auto line = data.Get(i);
+    if (!line.IsArray()) {
+      throw Error::New(info.Env(), "data must be an array of string arrays");
+    }
+    auto values = line.As<Array>();
+    if (values.Length() > static_cast<uint32_t>(inner)) {
+      throw Error::New(info.Env(),
+                       "data has more rows or columns than the table");
+    }
+    for (uint32_t j = 0; j < values.Length(); ++j) {
+      auto value = values.Get(j);
+      if (value.IsUndefined() || value.IsNull()) {
+        continue;
+      }
+      const int col = columnMajor ? i : j;
+      const int row = columnMajor ? j : i;
+      model->SetText(model->Index(col, row),
+                     value.ToString().Utf8Value());
+    }
+  }
+
+  if (styles.Has("fonts") && styles.Get("fonts").IsArray()) {
+    auto js = styles.Get("fonts").As<Array>();
+    std::vector<PdfFont*> fonts;
+    for (uint32_t i = 0; i < js.Length(); ++i) {
+      auto item = js.Get(i);
+      if (!item.IsObject() ||
+          !item.As<Object>().InstanceOf(Font::constructor.Value())) {
+        throw Error::New(info.Env(), "fonts must be instances of Font");
+      }
+      Font* font = Font::Unwrap(item.As<Object>());
+      AddFont(font);
+      fonts.push_back(font->GetPoDoFoFont());
+    }
+    model->SetFonts(fonts);
+  }
+  auto font = CellStyles<uint16_t>(
+    info, styles, "font", napi_uint16_array, cells);
+  auto foreground = CellStyles<uint32_t>(
+    info, styles, "foreground", napi_uint32_array, cells);
+  auto background = CellStyles<uint32_t>(
+    info, styles, "background", napi_uint32_array, cells);
+  auto border = CellStyles<uint32_t>(
+    info, styles, "border", napi_uint32_array, cells);
+  auto alignment = CellStyles<int8_t>(
+    info, styles, "alignment", napi_int8_array, cells);
+  auto verticalAlignment = CellStyles<int8_t>(
+    info, styles, "verticalAlignment", napi_int8_array, cells);
+  auto wordWrap = CellStyles<int8_t>(
+    info, styles, "wordWrap", napi_int8_array, cells);
+  for (size_t i = 0; i < cells; ++i) {
+    if ((!alignment.IsEmpty() && (alignment[i] < -1 || alignment[i] > 2)) ||
+        (!verticalAlignment.IsEmpty() &&
+         (verticalAlignment[i] < -1 || verticalAlignment[i] > 2))) {
+      throw Error::New(info.Env(), "alignments must be -1, 0, 1 or 2");
+    }
+  }
+  if (font.IsEmpty() && foreground.IsEmpty() && background.IsEmpty() &&
+      border.IsEmpty() && alignment.IsEmpty() && verticalAlignment.IsEmpty() &&
+      wordWrap.IsEmpty()) {
+    return;
+  }
+  auto color = [&](uint32_t rgb) {
+    return rgb == NoColor ? CellStyle::Inherit : model->InternRGB(rgb);
+  };
+  try {
+    for (size_t i = 0; i < cells; ++i) {
+      CellStyle style = model->GetStyle(i);
+      if (!font.IsEmpty())
+        style.font = font[i];
+      if (!foreground.IsEmpty())
+        style.foreground = color(foreground[i]);
+      if (!background.IsEmpty())
+        style.background = color(background[i]);
+      if (!border.IsEmpty())
+        style.border = color(border[i]);
+      if (!alignment.IsEmpty())
+        style.alignment = alignment[i];
+      if (!verticalAlignment.IsEmpty())
+        style.verticalAlignment = verticalAlignment[i];
+      if (!wordWrap.IsEmpty())
+        style.wordWrap = wordWrap[i] < 0 ? -1 : wordWrap[i] != 0;
+      model->SetStyle(i, style);
+    }
+  } catch (PdfError& err) {
+    ErrorHandler(err, info);
+  }
+}
+
 Value
 SimpleTable::GetBorderWidth(const CallbackInfo& info)
 {
@@ -188,6 +340,9 @@ SimpleTable::GetImage(const CallbackInfo& info)
   const int col = info[0].As<Number>();
   const int row = info[1].As<Number>();
   auto image = model->GetImage(col, row);
+  if (!image) {
+    return info.Env().Null();
+  }
   auto* pStream = dynamic_cast<PdfMemStream*>(image->GetObject()->GetStream());
   const auto stream = pStream->Get();
   const auto length = pStream->GetLength();
@@ -220,8 +375,7 @@ SimpleTable::SetForegroundColor(const CallbackInfo& info,
 {
   try {
     Array a = value.As<Array>();
-    foregroundColor = SetColor(a);
-    model->SetForegroundColor(*foregroundColor);
+    model->SetForegroundColor(SetColor(info.Env(), a));
   } catch (PdfError& err) {
     ErrorHandler(err, info);
   }
@@ -233,13 +387,9 @@ SimpleTable::GetBackgroundColor(const CallbackInfo& info)
   AssertFunctionArgs(info, 2, { napi_number, napi_number });
   const int col = info[0].As<Number>();
   const int row = info[1].As<Number>();
-  auto color = model->GetForegroundColor(col, row).ToArray();
+  auto color = model->GetBackgroundColor(col, row);
   auto js = Array::New(info.Env());
-  uint32_t n = 1;
-  for (auto& i : color) {
-    js.Set(n, i.GetNumber());
-    ++n;
-  }
+  GetColor(color, js);
   return js;
 }
 
@@ -249,8 +399,7 @@ SimpleTable::SetBackgroundColor(const CallbackInfo& info,
 {
   try {
     auto a = value.As<Array>();
-    backgroundColor = SetColor(a);
-    model->SetBackgroundColor(*backgroundColor);
+    model->SetBackgroundColor(SetColor(info.Env(), a));
   } catch (PdfError& err) {
     ErrorHandler(err, info);
   }
@@ -360,11 +509,44 @@ SimpleTable::Draw(const CallbackInfo& info)
   const double posX = point.Get("x").As<Number>();
   const double posY = point.Get("y").As<Number>();
   auto painter = Painter::Unwrap(info[1].As<Object>());
+  painter->AssertWritable(info.Env());
+  if (!table->GetModel()) {
+    table->SetModel(model);
+  }
+  try {
+    table->Draw(posX, posY, painter->GetPainter());
+  } catch (PdfError& err) {
+    ErrorHandler(err, info);
+  }
+}
+
+/**
+ * @details Javascript parameters: (point: {x, y}, painter: Painter,
+ * cb: Function)
+ * The table is laid out and drawn on a worker, pages added by auto page break
+ * are created while the document lock is held.
+ */
+void
+SimpleTable::DrawAsync(const CallbackInfo& info)
+{
+  AssertFunctionArgs(info, 3, { napi_object, napi_object, napi_function });
+  const Object point = info[0].As<Object>();
+  const double posX = point.Get("x").As<Number>();
+  const double posY = point.Get("y").As<Number>();
+  auto painter = Painter::Unwrap(info[1].As<Object>());
+  painter->AssertNotDrawing(info.Env());
+  auto cb = info[2].As<Function>();
   if (!table->GetModel()) {
-    cout << model->GetText(0, 0).GetStringUtf8() << endl;
     table->SetModel(model);
   }
-  table->Draw(posX, posY, painter->GetPainter());
+  PdfTable* target = table;
+  PdfPainter* pdfPainter = painter->GetPainter();
+  painter->Acquire();
+  auto* worker = new PainterAsync(cb, *painter, [=]() {
+    target->Draw(posX, posY, pdfPainter);
+  });
+  worker->Keep(this->Value());
+  worker->Queue();
 }
 
 Value
@@ -381,7 +563,8 @@ SimpleTable::GetWidth(const CallbackInfo& info)
 void
 SimpleTable::SetTableWidth(const CallbackInfo& info, const Napi::Value& value)
 {
-  table->SetTableWidth(value.As<Number>().DoubleValue());
+  tableWidth = value.As<Number>().DoubleValue();
+  table->SetTableWidth(tableWidth);
 }
 
 Value
@@ -398,7 +581,8 @@ SimpleTable::GetHeight(const CallbackInfo& info)
 void
 SimpleTable::SetTableHeight(const CallbackInfo& info, const Napi::Value& value)
 {
-  table->SetTableHeight(value.As<Number>().DoubleValue());
+  tableHeight = value.As<Number>().DoubleValue();
+  table->SetTableHeight(tableHeight);
 }
 
 Value
@@ -413,43 +597,53 @@ SimpleTable::GetRows(const CallbackInfo& info)
   return Number::New(info.Env(), table->GetRows());
 }
 
+/**
+ * PdfTable copies the widths, it reads one for every column
+ */
 void
 SimpleTable::SetColumnWidths(const CallbackInfo& info)
 {
-  const auto widths = info[0].As<Array>();
-  const auto ws = static_cast<double*>(calloc(sizeof(double), widths.Length()));
+  AssertFunctionArgs(info, 1, { napi_object });
   const auto array = info[0].As<Array>();
+  if (array.Length() != static_cast<uint32_t>(table->GetCols())) {
+    throw Error::New(info.Env(), "a width is required for every column");
+  }
+  std::vector<double> widths(array.Length());
   for (uint32_t i = 0; i < array.Length(); i++) {
-    const double index = array.Get(i).As<Number>();
-    ws[i] = index;
+    widths[i] = array.Get(i).As<Number>();
   }
-  table->SetColumnWidths(ws);
+  table->SetColumnWidths(widths.data());
+  columnWidths = std::move(widths);
 }
 
 void
 SimpleTable::SetColumnWidth(const CallbackInfo& info)
 {
-  table->SetColumnWidth(info[0].As<Number>().DoubleValue());
+  columnWidth = info[0].As<Number>().DoubleValue();
+  table->SetColumnWidth(columnWidth);
 }
 
 void
 SimpleTable::SetRowHeights(const CallbackInfo& info)
 {
-  auto heights = info[0].As<Array>();
-  const auto pdHeights =
-    static_cast<double*>(calloc(sizeof(double), heights.Length()));
-  auto array = info[0].As<Array>();
+  AssertFunctionArgs(info, 1, { napi_object });
+  const auto array = info[0].As<Array>();
+  if (array.Length() != static_cast<uint32_t>(table->GetRows())) {
+    throw Error::New(info.Env(), "a height is required for every row");
+  }
+  std::vector<double> heights(array.Length());
   for (uint32_t i = 0; i < array.Length(); i++) {
-    const double index = array.Get(i).As<Number>();
-    pdHeights[i] = index;
+    heights[i] = array.Get(i).As<Number>();
   }
-  table->SetRowHeights(pdHeights);
+  table->SetRowHeights(heights.data());
+  rowHeights = std::move(heights);
 }
 
 void
 SimpleTable::SetRowHeight(const CallbackInfo& info)
 {
-  table->SetRowHeight(info[0].As<Number>().DoubleValue());
+  rowHeight = info[0].As<Number>().DoubleValue();
+  table->SetRowHeight(rowHeight);
 }
 
 void
@@ -471,32 +665,148 @@ SimpleTable::GetAutoPageBreak(const CallbackInfo& info)
   return Boolean::New(info.Env(), table->GetAutoPageBreak());
 }
 
-PdfColor*
-SimpleTable::SetColor(Array& js)
+void
+SimpleTable::AddFont(Font* font)
 {
-  PdfColor* color = nullptr;
-  try {
-    uint32_t i = 0;
-    if (js.Length() == 3) {
-      const double r = js.Get(i).As<Number>();
-      const double g = js.Get(++i).As<Number>();
-      const double b = js.Get(++i).As<Number>();
-      color = new PdfColor(r, g, b);
-    } else if (js.Length() == 4) {
-      // cmyk color
-      const double c = js.Get(i).As<Number>();
-      const double m = js.Get(++i).As<Number>();
-      const double y = js.Get(++i).As<Number>();
-      const double k = js.Get(++i).As<Number>();
-      color = new PdfColor(c, m, y, k);
-    } else if (js.Length() == 1) {
-      // gray scale
-      const double gs = js.Get(i).As<Number>();
-      color = new PdfColor(gs);
+  advances[font->GetPoDoFoFont()] = font->GetAdvanceCache();
+}
+
+/**
+ * @details Javascript parameters: (area: Rect, x: number, y: number)
+ * Sizes the table as PdfTable::Draw at x, y (the top left corner) would,
+ * without drawing anything. Column widths and row heights follow the table
+ * settings and fall back to an even share of the space left in area, like
+ * PdfTable. With auto page break on, a row that would end below the area
+ * starts a new page at the top of area. contentHeights holds the height the
+ * wrapped text of each row needs at the font's current size.
+ */
+Value
+SimpleTable::Layout(const CallbackInfo& info)
+{
+  AssertFunctionArgs(info, 3, { napi_object, napi_number, napi_number });
+  auto r = info[0].As<Object>();
+  if (!r.InstanceOf(Rect::constructor.Value())) {
+    throw Error::New(info.Env(), "area must be an instance of Rect");
+  }
+  const PdfRect area = *Rect::Unwrap(r)->GetRect();
+  const double x = info[1].As<Number>();
+  const double y = info[2].As<Number>();
+  const int cols = model->GetCols();
+  const int rows = model->GetRows();
+
+  std::vector<double> widths = columnWidths;
+  if (widths.empty()) {
+    double w = tableWidth != 0.0 ? tableWidth / cols : columnWidth;
+    if (w <= 0.0) {
+      w = (area.GetLeft() + area.GetWidth() - x) / cols;
+    }
+    widths.assign(cols, w);
+  }
+  std::vector<double> heights = rowHeights;
+  if (heights.empty()) {
+    double h = tableHeight != 0.0 ? tableHeight / rows : rowHeight;
+    if (h <= 0.0) {
+      h = (y - area.GetBottom()) / rows;
     }
+    heights.assign(rows, h);
+  }
+
+  // every font gets its advance cache before the cells are measured
+  std::vector<PdfFont*> fonts = model->GetFonts();
+  fonts.push_back(model->GetTableFont());
+  for (PdfFont* font : fonts) {
+    if (font && advances.find(font) == advances.end()) {
+      advances[font] =
+        std::make_shared<GlyphAdvanceCache>(font->GetFontMetrics());
+    }
+  }
+  const size_t cells = static_cast<size_t>(cols) * rows;
+  std::vector<double> cellHeights(cells, 0.0);
+  try {
+    ParallelFor(cells, [&](size_t i) {
+      const int col = static_cast<int>(i % cols);
+      const int row = static_cast<int>(i / cols);
+      PdfFont* font = model->GetFont(col, row);
+      string text = model->GetText(col, row).GetStringUtf8();
+      if (!font || text.empty()) {
+        return;
+      }
+      TextLayoutOptions options;
+      options.width = model->HasWordWrap(col, row)
+                        ? widths[col]
+                        : std::numeric_limits<double>::max();
+      double size = font->GetFontSize();
+      double spacing = font->GetFontMetrics()->GetLineSpacing();
+      if (size > 0 && spacing > 0) {
+        options.lineHeight = spacing / size;
+      }
+      TextLayout layout({ { font, advances.at(font), size, text } }, options);
+      layout.Run();
+      cellHeights[i] = layout.GetHeight();
+    });
   } catch (PdfError& err) {
+    ErrorHandler(err, info);
+  }
+
+  auto jsWidths = Float64Array::New(info.Env(), widths.size());
+  for (size_t c = 0; c < widths.size(); ++c) {
+    jsWidths[c] = widths[c];
+  }
+  auto jsHeights = Float64Array::New(info.Env(), rows);
+  auto jsContent = Float64Array::New(info.Env(), rows);
+  auto pageBreaks = Napi::Array::New(info.Env());
+  const double areaTop = area.GetBottom() + area.GetHeight();
+  double top = y;
+  double total = 0.0;
+  uint32_t breaks = 0;
+  for (int row = 0; row < rows; ++row) {
+    if (table->GetAutoPageBreak() && top - heights[row] < area.GetBottom() &&
+        top < areaTop) {
+      pageBreaks.Set(breaks++, Number::New(info.Env(), row));
+      top = areaTop;
+    }
+    top -= heights[row];
+    total += heights[row];
+    double content = 0.0;
+    for (int col = 0; col < cols; ++col) {
+      content = std::max(content, cellHeights[model->Index(col, row)]);
+    }
+    jsHeights[row] = heights[row];
+    jsContent[row] = content;
+  }
+  auto js = Object::New(info.Env());
+  js.Set("widths", jsWidths);
+  js.Set("heights", jsHeights);
+  js.Set("contentHeights", jsContent);
+  js.Set("pageBreaks", pageBreaks);
+  js.Set("height", Number::New(info.Env(), total));
+  js.Set("pages", Number::New(info.Env(), breaks + 1));
+  return js;
+}
+
+PdfColor
+SimpleTable::SetColor(const Napi::Env& env, Array& js)
+{
+  uint32_t i = 0;
+  if (js.Length() == 3) {
+    const double r = js.Get(i).As<Number>();
+    const double g = js.Get(++i).As<Number>();
+    const double b = js.Get(++i).As<Number>();
+    return PdfColor(r, g, b);
+  } else if (js.Length() == 4) {
+    // cmyk color
+    const double c = js.Get(i).As<Number>();
+    const double m = js.Get(++i).As<Number>();
+    const double y = js.Get(++i).As<Number>();
+    const double k = js.Get(++i).As<Number>();
+    return PdfColor(c, m, y, k);
+  } else if (js.Length() == 1) {
+    // gray scale
+    const double gs = js.Get(i).As<Number>();
+    return PdfColor(gs);
   }
-  return color;
+  throw Error::New(env, "color must be an array of 1 (gray), 3 (rgb) or 4 "
+                        "(cmyk) values");
 }
 
 void
@@ -21,9 +21,15 @@
 #define NPDF_SIMPLETABLE_H
 
 #include "Document.h"
+#include "Font.h"
+#include "GlyphAdvanceCache.h"
+#include "TableModel.h"
 
+#include <map>
+#include <memory>
 #include <napi.h>
 #include <podofo/podofo.h>
+#include <vector>
 
 namespace NoPoDoFo {
 
@@ -38,6 +44,7 @@ public:
   void SetFont(const Napi::CallbackInfo&, const Napi::Value&);
   Napi::Value GetText(const Napi::CallbackInfo&);
   void SetText(const Napi::CallbackInfo&, const Napi::Value&);
+  void SetData(const Napi::CallbackInfo&);
   Napi::Value GetBorderWidth(const Napi::CallbackInfo&);
   void SetBorderWidth(const Napi::CallbackInfo&, const Napi::Value&);
   Napi::Value GetBorderColor(const Napi::CallbackInfo&);
@@ -59,6 +66,7 @@ public:
 
   // PdfTable
   void Draw(const Napi::CallbackInfo&);
+  void DrawAsync(const Napi::CallbackInfo&);
   Napi::Value GetWidth(const Napi::CallbackInfo&);
   void SetTableWidth(const Napi::CallbackInfo&, const Napi::Value&);
   Napi::Value GetHeight(const Napi::CallbackInfo&);
@@ -71,15 +79,24 @@ public:
   void SetRowHeight(const Napi::CallbackInfo&);
   void SetAutoPageBreak(const Napi::CallbackInfo&, const Napi::Value&);
   Napi::Value GetAutoPageBreak(const Napi::CallbackInfo&);
+  Napi::Value Layout(const Napi::CallbackInfo&);
 
 private:
-  PoDoFo::PdfSimpleTableModel* model = nullptr;
+  TableModel* model = nullptr;
   PoDoFo::PdfTable* table = nullptr;
   Document* doc = nullptr;
-  PoDoFo::PdfColor* backgroundColor = nullptr;
-  PoDoFo::PdfColor* foregroundColor = nullptr;
+  // the sizes given to PdfTable, it has no getters for them
+  double columnWidth = 0.0;
+  double rowHeight = 0.0;
+  double tableWidth = 0.0;
+  double tableHeight = 0.0;
+  std::vector<double> columnWidths;
+  std::vector<double> rowHeights;
+  // glyph advances of the fonts used by the model, kept between layouts
+  std::map<PoDoFo::PdfFont*, std::shared_ptr<GlyphAdvanceCache>> advances;
 
-  PoDoFo::PdfColor* SetColor(Napi::Array&);
+  void AddFont(Font*);
+  PoDoFo::PdfColor SetColor(const Napi::Env&, Napi::Array&);
   void GetColor(PoDoFo::PdfColor&, Napi::Array& js);
 };
 }
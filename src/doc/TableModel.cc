@@ -0,0 +1,178 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TableModel.h"
+
+namespace NoPoDoFo {
+
+using namespace PoDoFo;
+using std::string;
+using std::vector;
+
+TableModel::TableModel(int cols, int rows)
+  : cols(cols)
+  , rows(rows)
+  , text(static_cast<size_t>(cols) * rows)
+  , cellStyles(text.size(), 0)
+  , styles(1)
+{
+  styleIndex[styles[0]] = 0;
+  // the PdfSimpleTableModel defaults
+  foreground = Intern(PdfColor(0.0, 0.0, 0.0));
+  background = Intern(PdfColor(1.0, 1.0, 1.0));
+  border = foreground;
+}
+
+void
+TableModel::SetText(int col, int row, const PdfString& value)
+{
+  if (Contains(col, row)) {
+    text[Index(col, row)] = value;
+  }
+}
+
+void
+TableModel::SetText(size_t index, const string& value)
+{
+  text[index] = PdfString(value);
+}
+
+void
+TableModel::SetFonts(vector<PdfFont*> list)
+{
+  fonts = std::move(list);
+}
+
+void
+TableModel::SetStyle(size_t index, const CellStyle& style)
+{
+  auto it = styleIndex.find(style);
+  if (it == styleIndex.end()) {
+    if (styles.size() >= CellStyle::Inherit) {
+      PODOFO_RAISE_ERROR_INFO(ePdfError_ValueOutOfRange,
+                              "Too many distinct cell styles");
+    }
+    const auto i = static_cast<uint16_t>(styles.size());
+    styles.push_back(style);
+    it = styleIndex.emplace(style, i).first;
+  }
+  cellStyles[index] = it->second;
+}
+
+uint16_t
+TableModel::Intern(const PdfColor& color)
+{
+  vector<double> key;
+  key.push_back(static_cast<double>(color.GetColorSpace()));
+  for (auto& v : color.ToArray()) {
+    key.push_back(v.GetReal());
+  }
+  auto it = paletteIndex.find(key);
+  if (it != paletteIndex.end()) {
+    return it->second;
+  }
+  if (palette.size() >= CellStyle::Inherit) {
+    PODOFO_RAISE_ERROR_INFO(ePdfError_ValueOutOfRange,
+                            "Too many distinct cell colours");
+  }
+  const auto i = static_cast<uint16_t>(palette.size());
+  palette.push_back(color);
+  paletteIndex.emplace(std::move(key), i);
+  return i;
+}
+
+uint16_t
+TableModel::InternRGB(uint32_t rgb)
+{
+  return Intern(PdfColor(((rgb >> 16) & 0xFF) / 255.0,
+                         ((rgb >> 8) & 0xFF) / 255.0,
+                         (rgb & 0xFF) / 255.0));
+}
+
+const CellStyle&
+TableModel::StyleAt(int col, int row) const
+{
+  return Contains(col, row) ? styles[cellStyles[Index(col, row)]] : styles[0];
+}
+
+PdfString
+TableModel::GetText(int col, int row) const
+{
+  return Contains(col, row) ? text[Index(col, row)] : PdfString();
+}
+
+EPdfAlignment
+TableModel::GetAlignment(int col, int row) const
+{
+  const auto& style = StyleAt(col, row);
+  return style.alignment < 0 ? alignment
+                             : static_cast<EPdfAlignment>(style.alignment);
+}
+
+EPdfVerticalAlignment
+TableModel::GetVerticalAlignment(int col, int row) const
+{
+  const auto& style = StyleAt(col, row);
+  return style.verticalAlignment < 0
+           ? verticalAlignment
+           : static_cast<EPdfVerticalAlignment>(style.verticalAlignment);
+}
+
+PdfFont*
+TableModel::GetFont(int col, int row) const
+{
+  const auto& style = StyleAt(col, row);
+  if (style.font > 0 && style.font <= fonts.size()) {
+    return fonts[style.font - 1];
+  }
+  return font;
+}
+
+bool
+TableModel::HasBackgroundColor(int col, int row) const
+{
+  return backgroundEnabled ||
+         StyleAt(col, row).background != CellStyle::Inherit;
+}
+
+PdfColor
+TableModel::GetBackgroundColor(int col, int row) const
+{
+  return Color(StyleAt(col, row).background, background);
+}
+
+PdfColor
+TableModel::GetForegroundColor(int col, int row) const
+{
+  return Color(StyleAt(col, row).foreground, foreground);
+}
+
+bool
+TableModel::HasWordWrap(int col, int row) const
+{
+  const auto& style = StyleAt(col, row);
+  return style.wordWrap < 0 ? wordWrap : style.wordWrap != 0;
+}
+
+PdfColor
+TableModel::GetBorderColor(int col, int row) const
+{
+  return Color(StyleAt(col, row).border, border);
+}
+}
@@ -0,0 +1,181 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NPDF_TABLEMODEL_H
+#define NPDF_TABLEMODEL_H
+
+#include <cstdint>
+#include <map>
+#include <podofo/podofo.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace NoPoDoFo {
+
+/**
+ * Style overrides of a cell. Every field has an "inherit" value that falls
+ * back to the table wide setting, colours are indices into the model's
+ * palette.
+ */
+struct CellStyle
+{
+  static const uint16_t Inherit = 0xFFFF;
+
+  uint16_t font = 0; // 0 for the table font, n for fonts[n - 1]
+  uint16_t foreground = Inherit;
+  uint16_t background = Inherit;
+  uint16_t border = Inherit;
+  int8_t alignment = -1;
+  int8_t verticalAlignment = -1;
+  int8_t wordWrap = -1;
+
+  bool operator==(const CellStyle& o) const
+  {
+    return font == o.font && foreground == o.foreground &&
+           background == o.background && border == o.border &&
+           alignment == o.alignment &&
+           verticalAlignment == o.verticalAlignment && wordWrap == o.wordWrap;
+  }
+};
+
+struct CellStyleHash
+{
+  size_t operator()(const CellStyle& s) const
+  {
+    uint64_t h = s.font;
+    h = h * 65599 + s.foreground;
+    h = h * 65599 + s.background;
+    h = h * 65599 + s.border;
+    h = h * 65599 + static_cast<uint8_t>(s.alignment);
+    h = h * 65599 + static_cast<uint8_t>(s.verticalAlignment);
+    h = h * 65599 + static_cast<uint8_t>(s.wordWrap);
+    return static_cast<size_t>(h);
+  }
+};
+
+/**
+ * Table model owned by NoPoDoFo. Cells are stored as a struct of arrays, the
+ * text of every cell and the index of its interned style, both row major.
+ * Distinct styles and colours are stored once, so per cell styling costs two
+ * bytes a cell however many cells share a style, and nothing is allocated
+ * per setter call.
+ */
+class TableModel : public PoDoFo::PdfTableModel
+{
+public:
+  TableModel(int cols, int rows);
+
+  int GetCols() const { return cols; }
+  int GetRows() const { return rows; }
+  bool Contains(int col, int row) const
+  {
+    return col >= 0 && row >= 0 && col < cols && row < rows;
+  }
+  size_t Index(int col, int row) const
+  {
+    return static_cast<size_t>(row) * cols + col;
+  }
+
+  // Table wide settings, used by cells without an override
+  void SetFont(PoDoFo::PdfFont* value) { font = value; }
+  void SetForegroundColor(const PoDoFo::PdfColor& value)
+  {
+    foreground = Intern(value);
+  }
+  void SetBackgroundColor(const PoDoFo::PdfColor& value)
+  {
+    background = Intern(value);
+  }
+  void SetBorderColor(const PoDoFo::PdfColor& value) { border = Intern(value); }
+  void SetAlignment(PoDoFo::EPdfAlignment value) { alignment = value; }
+  void SetVerticalAlignment(PoDoFo::EPdfVerticalAlignment value)
+  {
+    verticalAlignment = value;
+  }
+  void SetWordWrapEnabled(bool value) { wordWrap = value; }
+  void SetBorderEnabled(bool value) { borders = value; }
+  void SetBorderWidth(double value) { borderWidth = value; }
+  void SetBackgroundEnabled(bool value) { backgroundEnabled = value; }
+
+  void SetText(int col, int row, const PoDoFo::PdfString& text);
+  void SetText(size_t index, const std::string& text);
+  // Font list referenced by CellStyle::font, the model does not own the fonts
+  void SetFonts(std::vector<PoDoFo::PdfFont*> list);
+  const std::vector<PoDoFo::PdfFont*>& GetFonts() const { return fonts; }
+  PoDoFo::PdfFont* GetTableFont() const { return font; }
+  const CellStyle& GetStyle(size_t index) const
+  {
+    return styles[cellStyles[index]];
+  }
+  void SetStyle(size_t index, const CellStyle& style);
+  // Palette index of a colour, the colour is added on first use
+  uint16_t Intern(const PoDoFo::PdfColor& color);
+  // Packed 0xRRGGBB
+  uint16_t InternRGB(uint32_t rgb);
+  size_t GetStyleCount() const { return styles.size(); }
+
+  PoDoFo::PdfString GetText(int col, int row) const override;
+  PoDoFo::EPdfAlignment GetAlignment(int col, int row) const override;
+  PoDoFo::EPdfVerticalAlignment GetVerticalAlignment(int col,
+                                                     int row) const override;
+  PoDoFo::PdfFont* GetFont(int col, int row) const override;
+  bool HasBackgroundColor(int col, int row) const override;
+  PoDoFo::PdfColor GetBackgroundColor(int col, int row) const override;
+  PoDoFo::PdfColor GetForegroundColor(int col, int row) const override;
+  bool HasWordWrap(int col, int row) const override;
+  bool HasBorders() const override { return borders; }
+  double GetBorderWidth() const override { return borderWidth; }
+  PoDoFo::PdfColor GetBorderColor(int col, int row) const override;
+  bool HasImage(int, int) const override { return false; }
+  PoDoFo::PdfImage* GetImage(int, int) const override { return nullptr; }
+
+private:
+  int cols;
+  int rows;
+  // per cell, row major
+  std::vector<PoDoFo::PdfString> text;
+  std::vector<uint16_t> cellStyles;
+  // interned styles, styles[0] inherits everything
+  std::vector<CellStyle> styles;
+  std::unordered_map<CellStyle, uint16_t, CellStyleHash> styleIndex;
+  std::vector<PoDoFo::PdfColor> palette;
+  std::map<std::vector<double>, uint16_t> paletteIndex;
+  std::vector<PoDoFo::PdfFont*> fonts;
+
+  PoDoFo::PdfFont* font = nullptr;
+  uint16_t foreground;
+  uint16_t background;
+  uint16_t border;
+  PoDoFo::EPdfAlignment alignment = PoDoFo::ePdfAlignment_Left;
+  PoDoFo::EPdfVerticalAlignment verticalAlignment =
+    PoDoFo::ePdfVerticalAlignment_Center;
+  bool wordWrap = false;
+  bool borders = true;
+  double borderWidth = 1.0;
+  bool backgroundEnabled = false;
+
+  const CellStyle& StyleAt(int col, int row) const;
+  const PoDoFo::PdfColor& Color(uint16_t cell, uint16_t fallback) const
+  {
+    return palette[cell != CellStyle::Inherit ? cell : fallback];
+  }
+};
+}
+#endif // NPDF_TABLEMODEL_H
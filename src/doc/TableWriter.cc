@@ -0,0 +1,320 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TableWriter.h"
+#include "../ErrorHandler.h"
+#include "../Parallel.h"
+#include "../ValidateArguments.h"
+#include "Font.h"
+#include "Page.h"
+#include "Rect.h"
+
+#include <algorithm>
+
+namespace NoPoDoFo {
+
+using namespace Napi;
+using namespace PoDoFo;
+using std::string;
+using std::vector;
+
+FunctionReference TableWriter::constructor; // NOLINT
+
+static vector<vector<string>>
+ParseRows(const Napi::Env& env, const Napi::Array& js, size_t columns)
+{
+  vector<vector<string>> rows(js.Length());
+  for (uint32_t i = 0; i < js.Length(); ++i) {
+    auto item = js.Get(i);
+    if (!item.IsArray()) {
+      throw Error::New(env, "rows must be arrays of strings");
+    }
+    auto cells = item.As<Napi::Array>();
+    if (cells.Length() > columns) {
+      throw Error::New(env, "row has more cells than the table has columns");
+    }
+    rows[i].resize(columns);
+    for (uint32_t c = 0; c < cells.Length(); ++c) {
+      auto cell = cells.Get(c);
+      if (!cell.IsUndefined() && !cell.IsNull()) {
+        rows[i][c] = cell.ToString().Utf8Value();
+      }
+    }
+  }
+  return rows;
+}
+
+/**
+ * @details Javascript parameters: (doc: Document, options: {
+ *   columns: number[], font: Font, size?: number, header?: string[][],
+ *   pageSize?: Rect, area?: Rect, firstPage?: Page, padding?: number,
+ *   borderWidth?: number, lineHeight?: number })
+ * area defaults to the page size less a 36 point margin, a borderWidth of 0
+ * draws no cell borders.
+ */
+TableWriter::TableWriter(const CallbackInfo& info)
+  : ObjectWrap(info)
+{
+  AssertFunctionArgs(info, 2, { napi_object, napi_object });
+  auto o = info[0].As<Object>();
+  if (!o.InstanceOf(Document::constructor.Value())) {
+    throw Error::New(info.Env(), "TableWriter requires an instance of Document");
+  }
+  doc = Document::Unwrap(o);
+  auto opts = info[1].As<Object>();
+
+  if (!opts.Get("columns").IsArray()) {
+    throw Error::New(info.Env(), "columns must be an array of widths");
+  }
+  auto widths = opts.Get("columns").As<Napi::Array>();
+  for (uint32_t i = 0; i < widths.Length(); ++i) {
+    double width = widths.Get(i).ToNumber();
+    if (!(width > 0)) {
+      throw Error::New(info.Env(), "column widths must be positive");
+    }
+    columns.push_back(width);
+  }
+  if (columns.empty()) {
+    throw Error::New(info.Env(), "a table needs at least one column");
+  }
+
+  auto f = opts.Get("font");
+  if (!f.IsObject() || !f.As<Object>().InstanceOf(Font::constructor.Value())) {
+    throw Error::New(info.Env(), "font must be an instance of Font");
+  }
+  Font* wrap = Font::Unwrap(f.As<Object>());
+  font = wrap->GetPoDoFoFont();
+  advances = wrap->GetAdvanceCache();
+  size = opts.Has("size") && opts.Get("size").IsNumber()
+           ? opts.Get("size").As<Number>().DoubleValue()
+           : font->GetFontSize();
+  if (opts.Get("padding").IsNumber()) {
+    padding = opts.Get("padding").As<Number>();
+  }
+  if (opts.Get("borderWidth").IsNumber()) {
+    borderWidth = opts.Get("borderWidth").As<Number>();
+  }
+  if (opts.Get("lineHeight").IsNumber()) {
+    lineHeight = opts.Get("lineHeight").As<Number>();
+  }
+
+  auto first = opts.Get("firstPage");
+  if (first.IsObject() &&
+      first.As<Object>().InstanceOf(Page::constructor.Value())) {
+    firstPage = Page::Unwrap(first.As<Object>())->GetPage();
+  }
+  auto ps = opts.Get("pageSize");
+  if (ps.IsObject() && ps.As<Object>().InstanceOf(Rect::constructor.Value())) {
+    pageSize = *Rect::Unwrap(ps.As<Object>())->GetRect();
+  } else if (firstPage) {
+    pageSize = firstPage->GetPageSize();
+  } else {
+    pageSize = PdfPage::CreateStandardPageSize(ePdfPageSize_A4);
+  }
+  auto a = opts.Get("area");
+  if (a.IsObject() && a.As<Object>().InstanceOf(Rect::constructor.Value())) {
+    area = *Rect::Unwrap(a.As<Object>())->GetRect();
+  } else {
+    area = PdfRect(pageSize.GetLeft() + 36,
+                   pageSize.GetBottom() + 36,
+                   pageSize.GetWidth() - 72,
+                   pageSize.GetHeight() - 72);
+  }
+
+  if (opts.Get("header").IsArray()) {
+    header = Layout(
+      ParseRows(info.Env(), opts.Get("header").As<Napi::Array>(), columns.size()));
+    for (auto& row : header) {
+      headerHeight += row.height;
+    }
+    if (headerHeight >= area.GetHeight()) {
+      throw Error::New(info.Env(), "header rows do not fit the table area");
+    }
+  }
+  painter = new PdfPainter();
+}
+
+TableWriter::~TableWriter()
+{
+  HandleScope scope(Env());
+  delete painter;
+  doc = nullptr;
+}
+
+void
+TableWriter::Initialize(Napi::Env& env, Napi::Object& target)
+{
+  HandleScope scope(env);
+  auto ctor = DefineClass(
+    env,
+    "TableWriter",
+    { InstanceAccessor("pageCount", &TableWriter::GetPageCount, nullptr),
+      InstanceAccessor("pendingRows", &TableWriter::GetPendingRows, nullptr),
+      InstanceMethod("addRows", &TableWriter::AddRows),
+      InstanceMethod("close", &TableWriter::Close) });
+  constructor = Napi::Persistent(ctor);
+  constructor.SuppressDestruct();
+  target.Set("TableWriter", ctor);
+}
+
+/**
+ * Cells are laid out in parallel, each row is as tall as its tallest cell
+ */
+vector<TableWriter::Row>
+TableWriter::Layout(const vector<vector<string>>& rows)
+{
+  const size_t cols = columns.size();
+  vector<Row> out(rows.size());
+  for (auto& row : out) {
+    row.cells.resize(cols);
+  }
+  ParallelFor(rows.size() * cols, [&](size_t i) {
+    const size_t r = i / cols;
+    const size_t c = i % cols;
+    TextLayoutOptions options;
+    options.width = std::max(columns[c] - 2 * padding, 1.0);
+    options.lineHeight = lineHeight;
+    auto* layout =
+      new TextLayout({ { font, advances, size, rows[r][c] } }, options);
+    out[r].cells[c].reset(layout);
+    layout->Run();
+  });
+  for (auto& row : out) {
+    double height = size * lineHeight;
+    for (auto& cell : row.cells) {
+      height = std::max(height, cell->GetHeight());
+    }
+    row.height = height + 2 * padding;
+  }
+  return out;
+}
+
+void
+TableWriter::FlushPage()
+{
+  PdfPage* page = pages == 0 && firstPage
+                    ? firstPage
+                    : doc->GetDocument()->CreatePage(pageSize);
+  painter->SetPage(page);
+  const double top = area.GetBottom() + area.GetHeight();
+  // text first, a path under construction can not contain text objects
+  double y = top;
+  for (auto* rows : { &header, &pending }) {
+    for (auto& row : *rows) {
+      double x = area.GetLeft();
+      for (size_t c = 0; c < columns.size(); ++c) {
+        row.cells[c]->Draw(painter, x + padding, y - padding);
+        x += columns[c];
+      }
+      y -= row.height;
+    }
+  }
+  if (borderWidth > 0) {
+    // graphics state operators are not allowed inside a path object
+    painter->SetStrokeWidth(borderWidth);
+    y = top;
+    for (auto* rows : { &header, &pending }) {
+      for (auto& row : *rows) {
+        double x = area.GetLeft();
+        for (double width : columns) {
+          painter->Rectangle(x, y - row.height, width, row.height);
+          x += width;
+        }
+        y -= row.height;
+      }
+    }
+    painter->Stroke();
+  }
+  painter->FinishPage();
+  ++pages;
+  pending.clear();
+  pending.shrink_to_fit();
+  pendingHeight = 0.0;
+  doc->InvalidateTextIndex();
+}
+
+/**
+ * @details Javascript parameters: (rows: string[][])
+ * Every page filled by the new rows is drawn before this returns, the number
+ * of pages drawn is returned. A row taller than the table area is drawn on a
+ * page of its own and overflows the area.
+ */
+Napi::Value
+TableWriter::AddRows(const CallbackInfo& info)
+{
+  AssertFunctionArgs(info, 1, { napi_object });
+  if (closed) {
+    throw Error::New(info.Env(), "TableWriter is closed");
+  }
+  doc->AssertIdle(info.Env());
+  if (!info[0].IsArray()) {
+    throw Error::New(info.Env(), "rows must be an array of string arrays");
+  }
+  auto rows =
+    Layout(ParseRows(info.Env(), info[0].As<Napi::Array>(), columns.size()));
+  const int before = pages;
+  const double available = area.GetHeight() - headerHeight;
+  try {
+    for (auto& row : rows) {
+      if (!pending.empty() && pendingHeight + row.height > available) {
+        FlushPage();
+      }
+      pendingHeight += row.height;
+      pending.push_back(std::move(row));
+    }
+  } catch (PdfError& err) {
+    ErrorHandler(err, info);
+  }
+  return Number::New(info.Env(), pages - before);
+}
+
+/**
+ * @details Draw the rows still pending and return the total page count, a
+ * table without rows still draws its header
+ */
+Napi::Value
+TableWriter::Close(const CallbackInfo& info)
+{
+  if (!closed) {
+    doc->AssertIdle(info.Env());
+    try {
+      if (!pending.empty() || pages == 0) {
+        FlushPage();
+      }
+    } catch (PdfError& err) {
+      ErrorHandler(err, info);
+    }
+    closed = true;
+    header.clear();
+  }
+  return Number::New(info.Env(), pages);
+}
+
+Napi::Value
+TableWriter::GetPageCount(const CallbackInfo& info)
+{
+  return Number::New(info.Env(), pages);
+}
+
+Napi::Value
+TableWriter::GetPendingRows(const CallbackInfo& info)
+{
+  return Number::New(info.Env(), static_cast<double>(pending.size()));
+}
+}
@@ -0,0 +1,83 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NPDF_TABLEWRITER_H
+#define NPDF_TABLEWRITER_H
+
+#include "Document.h"
+#include "TextLayout.h"
+
+#include <memory>
+#include <napi.h>
+#include <podofo/podofo.h>
+#include <string>
+#include <vector>
+
+namespace NoPoDoFo {
+
+/**
+ * Streams rows into a table spanning as many pages as needed. Rows are laid
+ * out as they are added and kept only until the page they land on is full,
+ * the page is then drawn with the header rows on top and the rows released.
+ */
+class TableWriter : public Napi::ObjectWrap<TableWriter>
+{
+public:
+  explicit TableWriter(const Napi::CallbackInfo&);
+  ~TableWriter();
+  static Napi::FunctionReference constructor;
+  static void Initialize(Napi::Env&, Napi::Object&);
+  Napi::Value AddRows(const Napi::CallbackInfo&);
+  Napi::Value Close(const Napi::CallbackInfo&);
+  Napi::Value GetPageCount(const Napi::CallbackInfo&);
+  Napi::Value GetPendingRows(const Napi::CallbackInfo&);
+
+private:
+  struct Row
+  {
+    double height;
+    std::vector<std::unique_ptr<TextLayout>> cells;
+  };
+
+  Document* doc;
+  PoDoFo::PdfPainter* painter;
+  PoDoFo::PdfFont* font;
+  std::shared_ptr<GlyphAdvanceCache> advances;
+  double size;
+  std::vector<double> columns;
+  // size of the pages created, and the area of each page the table fills
+  PoDoFo::PdfRect pageSize;
+  PoDoFo::PdfRect area;
+  double padding = 2.0;
+  double borderWidth = 0.5;
+  double lineHeight = 1.2;
+  // drawn first when set, later pages are created
+  PoDoFo::PdfPage* firstPage = nullptr;
+  std::vector<Row> header;
+  double headerHeight = 0.0;
+  std::vector<Row> pending;
+  double pendingHeight = 0.0;
+  int pages = 0;
+  bool closed = false;
+
+  std::vector<Row> Layout(const std::vector<std::vector<std::string>>&);
+  void FlushPage();
+};
+}
+#endif // NPDF_TABLEWRITER_H
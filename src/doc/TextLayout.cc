@@ -0,0 +1,663 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TextLayout.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+
+namespace NoPoDoFo {
+
+using namespace PoDoFo;
+using std::size_t;
+using std::string;
+using std::u32string;
+using std::vector;
+
+static const char32_t SoftHyphen = 0xAD;
+static const double ForcedBreak = -10000.0;
+// added to the demerits of two consecutive lines ending in a hyphen
+static const double FlaggedDemerits = 3000.0;
+static const double LinePenalty = 10.0;
+
+static bool
+IsSpace(char32_t c)
+{
+  return c == ' ' || c == '\t';
+}
+
+static bool
+IsBoxChar(char32_t c)
+{
+  return !IsSpace(c) && c != '\n' && c != '\r' && c != SoftHyphen;
+}
+
+u32string
+TextLayout::DecodeUtf8(const string& text)
+{
+  u32string out;
+  out.reserve(text.size());
+  size_t i = 0, n = text.size();
+  while (i < n) {
+    auto b = static_cast<unsigned char>(text[i]);
+    char32_t c;
+    size_t extra;
+    if (b < 0x80) {
+      c = b;
+      extra = 0;
+    } else if ((b & 0xE0) == 0xC0) {
+      c = b & 0x1F;
+      extra = 1;
+    } else if ((b & 0xF0) == 0xE0) {
+      c = b & 0x0F;
+      extra = 2;
+    } else if ((b & 0xF8) == 0xF0) {
+      c = b & 0x07;
+      extra = 3;
+    } else {
+      out.push_back(0xFFFD);
+      ++i;
+      continue;
+    }
+    if (i + extra >= n) {
+      out.push_back(0xFFFD);
+      break;
+    }
+    bool valid = true;
+    for (size_t k = 1; k <= extra; ++k) {
+      auto cb = static_cast<unsigned char>(text[i + k]);
+      if ((cb & 0xC0) != 0x80) {
+        valid = false;
+        break;
+      }
+      c = (c << 6) | (cb & 0x3F);
+    }
+    if (!valid) {
+      out.push_back(0xFFFD);
+      ++i;
+      continue;
+    }
+    out.push_back(c);
+    i += extra + 1;
+  }
+  return out;
+}
+
+string
+TextLayout::EncodeUtf8(const u32string& text, size_t begin, size_t end)
+{
+  string out;
+  end = std::min(end, text.size());
+  out.reserve(end > begin ? end - begin : 0);
+  for (size_t i = begin; i < end; ++i) {
+    char32_t c = text[i];
+    if (c < 0x80) {
+      out.push_back(static_cast<char>(c));
+    } else if (c < 0x800) {
+      out.push_back(static_cast<char>(0xC0 | (c >> 6)));
+      out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    } else if (c < 0x10000) {
+      out.push_back(static_cast<char>(0xE0 | (c >> 12)));
+      out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+      out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    } else {
+      out.push_back(static_cast<char>(0xF0 | (c >> 18)));
+      out.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+      out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+      out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    }
+  }
+  return out;
+}
+
+string
+LayoutLine::Text() const
+{
+  u32string text;
+  for (auto& segment : segments) {
+    text += segment.text;
+  }
+  return TextLayout::EncodeUtf8(text);
+}
+
+TextLayout::TextLayout(vector<TextRun> runs, const TextLayoutOptions& options)
+  : runs(std::move(runs))
+  , options(options)
+{}
+
+double
+TextLayout::Scale(size_t run) const
+{
+  return runs[run].size / 1000.0 * runs[run].font->GetFontScale() / 100.0;
+}
+
+double
+TextLayout::CharSpace(size_t run) const
+{
+  return runs[run].font->GetFontCharSpace() * runs[run].size / 100.0 *
+         runs[run].font->GetFontScale() / 100.0;
+}
+
+void
+TextLayout::Measure()
+{
+  chars.clear();
+  charRuns.clear();
+  for (size_t r = 0; r < runs.size(); ++r) {
+    u32string text = DecodeUtf8(runs[r].text);
+    chars += text;
+    charRuns.insert(charRuns.end(), text.size(), r);
+  }
+  advances.assign(chars.size(), 0.0);
+  kerns.assign(chars.size(), 0.0);
+  size_t offset = 0;
+  for (size_t r = 0; r < runs.size(); ++r) {
+    size_t n = 0;
+    while (offset + n < chars.size() && charRuns[offset + n] == r) {
+      ++n;
+    }
+    if (n == 0) {
+      continue;
+    }
+    runs[r].advances->Measure(chars.data() + offset,
+                              n,
+                              advances.data() + offset,
+                              options.kerning ? kerns.data() + offset
+                                              : nullptr);
+    double scale = Scale(r);
+    double charSpace = CharSpace(r);
+    for (size_t i = offset; i < offset + n; ++i) {
+      advances[i] = advances[i] * scale + charSpace;
+      kerns[i] *= scale;
+    }
+    offset += n;
+  }
+}
+
+void
+TextLayout::BuildItems()
+{
+  items.clear();
+  auto glue = [this](size_t run, size_t begin, size_t end, double width) {
+    items.push_back(
+      { ItemKind::Glue, run, begin, end, width, width / 2, width / 3, false, 0.0,
+        false });
+  };
+  auto fil = [this](size_t run, size_t at) {
+    items.push_back(
+      { ItemKind::Glue, run, at, at, 0.0, 0.0, 0.0, true, 0.0, false });
+    items.push_back({ ItemKind::Penalty,
+                      run,
+                      at,
+                      at,
+                      0.0,
+                      0.0,
+                      0.0,
+                      false,
+                      ForcedBreak,
+                      false });
+  };
+  auto hyphen = [this](size_t run, size_t at, double width) {
+    items.push_back({ ItemKind::Penalty,
+                      run,
+                      at,
+                      at,
+                      width,
+                      0.0,
+                      0.0,
+                      false,
+                      options.hyphenPenalty,
+                      true });
+  };
+
+  size_t i = 0, n = chars.size();
+  while (i < n) {
+    char32_t c = chars[i];
+    size_t run = charRuns[i];
+    if (c == '\r') {
+      ++i;
+    } else if (c == '\n') {
+      fil(run, i);
+      ++i;
+    } else if (IsSpace(c)) {
+      size_t j = i + 1;
+      if (options.collapseSpaces) {
+        while (j < n && IsSpace(chars[j])) {
+          ++j;
+        }
+      }
+      double space = runs[run].advances->Advance(' ') * Scale(run) +
+                     CharSpace(run) +
+                     runs[run].font->GetWordSpace() *
+                       runs[run].font->GetFontScale() / 100.0;
+      glue(run, i, j, space);
+      i = j;
+    } else if (c == SoftHyphen) {
+      hyphen(run,
+             i,
+             runs[run].advances->Advance('-') * Scale(run) + CharSpace(run));
+      ++i;
+    } else {
+      size_t j = i;
+      double width = 0.0;
+      while (j < n && IsBoxChar(chars[j]) && charRuns[j] == run) {
+        width += advances[j];
+        ++j;
+        bool next = j < n && IsBoxChar(chars[j]) && charRuns[j] == run;
+        if (chars[j - 1] == '-' && next) {
+          break;
+        }
+        if (next) {
+          width += kerns[j - 1];
+        }
+      }
+      items.push_back(
+        { ItemKind::Box, run, i, j, width, 0.0, 0.0, false, 0.0, false });
+      if (chars[j - 1] == '-' && j < n && IsBoxChar(chars[j])) {
+        hyphen(run, j, 0.0);
+      }
+      i = j;
+    }
+  }
+  fil(runs.empty() ? 0 : runs.size() - 1, n);
+}
+
+void
+TextLayout::Run()
+{
+  lines.clear();
+  if (runs.empty()) {
+    return;
+  }
+  Measure();
+  BuildItems();
+  Sum();
+  BuildLines(options.breaking == LineBreaking::Optimal ? BreakOptimal()
+                                                       : BreakGreedy());
+}
+
+void
+TextLayout::Sum()
+{
+  sumWidth.assign(items.size() + 1, 0.0);
+  sumStretch.assign(items.size() + 1, 0.0);
+  sumShrink.assign(items.size() + 1, 0.0);
+  sumFil.assign(items.size() + 1, 0);
+  for (size_t k = 0; k < items.size(); ++k) {
+    const Item& it = items[k];
+    // a penalty only has width when the line breaks at it
+    bool counts = it.kind != ItemKind::Penalty;
+    sumWidth[k + 1] = sumWidth[k] + (counts ? it.width : 0.0);
+    sumStretch[k + 1] = sumStretch[k] + it.stretch;
+    // unjustified lines never shrink their spaces
+    sumShrink[k + 1] = sumShrink[k] + (options.justify ? it.shrink : 0.0);
+    sumFil[k + 1] = sumFil[k] + (it.fil ? 1 : 0);
+  }
+}
+
+bool
+TextLayout::Legal(size_t k) const
+{
+  const Item& it = items[k];
+  if (it.kind == ItemKind::Penalty) {
+    return true;
+  }
+  return it.kind == ItemKind::Glue && !it.fil && k > 0 &&
+         items[k - 1].kind == ItemKind::Box;
+}
+
+TextLayout::LineStats
+TextLayout::Stats(size_t from, size_t b) const
+{
+  LineStats s;
+  s.start = from;
+  // glue and penalties following a break are discarded
+  while (s.start < b && items[s.start].kind != ItemKind::Box) {
+    ++s.start;
+  }
+  s.width = sumWidth[b] - sumWidth[s.start];
+  if (items[b].kind == ItemKind::Penalty) {
+    s.width += items[b].width;
+  }
+  s.stretch = sumStretch[b] - sumStretch[s.start];
+  s.shrink = sumShrink[b] - sumShrink[s.start];
+  s.fil = sumFil[b] - sumFil[s.start];
+  return s;
+}
+
+vector<size_t>
+TextLayout::BreakGreedy() const
+{
+  const double eps = 1e-9;
+  vector<size_t> breaks;
+  size_t from = 0;
+  bool hasFit = false;
+  size_t lastFit = 0;
+  for (size_t k = 0; k < items.size(); ++k) {
+    if (!Legal(k)) {
+      continue;
+    }
+    bool forced = items[k].kind == ItemKind::Penalty &&
+                  items[k].penalty <= ForcedBreak;
+    LineStats s = Stats(from, k);
+    if (s.width - s.shrink > options.width + eps) {
+      if (hasFit) {
+        // break at the last point that fit, then retry this one on the
+        // fresh line
+        breaks.push_back(lastFit);
+        from = lastFit + 1;
+        hasFit = false;
+        s = Stats(from, k);
+      }
+      if (s.width - s.shrink > options.width + eps) {
+        // a single unbreakable box wider than the line, let it overflow
+        breaks.push_back(k);
+        from = k + 1;
+        continue;
+      }
+    }
+    if (forced) {
+      breaks.push_back(k);
+      from = k + 1;
+      hasFit = false;
+    } else {
+      hasFit = true;
+      lastFit = k;
+    }
+  }
+  return breaks;
+}
+
+vector<size_t>
+TextLayout::BreakOptimal() const
+{
+  struct Node
+  {
+    size_t item; // break item, unused for the paragraph start
+    size_t from; // first item of the following line
+    double demerits;
+    size_t previous;
+    bool flagged;
+  };
+  const size_t none = std::numeric_limits<size_t>::max();
+  vector<Node> nodes;
+  nodes.push_back({ none, 0, 0.0, none, false });
+  vector<size_t> active{ 0 };
+
+  for (size_t k = 0; k < items.size(); ++k) {
+    if (!Legal(k)) {
+      continue;
+    }
+    const Item& at = items[k];
+    bool forced = at.kind == ItemKind::Penalty && at.penalty <= ForcedBreak;
+    size_t best = none;
+    double bestDemerits = std::numeric_limits<double>::infinity();
+    size_t nearest = none;
+    vector<size_t> keep;
+    keep.reserve(active.size());
+    // newest nodes give the shortest lines, walk them first
+    for (auto a = active.rbegin(); a != active.rend(); ++a) {
+      const Node& node = nodes[*a];
+      LineStats s = Stats(node.from, k);
+      double ratio;
+      if (s.width < options.width) {
+        ratio = s.fil > 0 ? 0.0
+                          : s.stretch > 0 ? (options.width - s.width) / s.stretch
+                                          : 1e6;
+      } else if (s.width > options.width) {
+        ratio =
+          s.shrink > 0 ? (options.width - s.width) / s.shrink : -1e6;
+      } else {
+        ratio = 0.0;
+      }
+      if (nearest == none) {
+        nearest = *a;
+      }
+      if (ratio < -1.0) {
+        // overfull, every later break from this node is too
+        continue;
+      }
+      keep.push_back(*a);
+      double badness = std::min(100.0 * std::pow(std::fabs(ratio), 3), 1e4);
+      double d = (LinePenalty + badness) * (LinePenalty + badness);
+      if (at.kind == ItemKind::Penalty) {
+        if (at.penalty >= 0) {
+          d += at.penalty * at.penalty;
+        } else if (at.penalty > ForcedBreak) {
+          d -= at.penalty * at.penalty;
+        }
+      }
+      if (at.flagged && node.flagged) {
+        d += FlaggedDemerits;
+      }
+      d += node.demerits;
+      if (d < bestDemerits) {
+        bestDemerits = d;
+        best = *a;
+      }
+    }
+    if (best == none && keep.empty() && nearest != none) {
+      // nothing fits, accept an overfull line rather than fail
+      best = nearest;
+      bestDemerits = nodes[nearest].demerits + 1e10;
+      keep.push_back(nearest);
+    }
+    std::reverse(keep.begin(), keep.end());
+    active.swap(keep);
+    if (best != none) {
+      nodes.push_back({ k, k + 1, bestDemerits, best, at.flagged });
+      if (forced) {
+        active.clear();
+      }
+      active.push_back(nodes.size() - 1);
+    }
+  }
+
+  vector<size_t> breaks;
+  // the final forced break is the last node
+  for (size_t n = nodes.size() - 1; n != 0 && n != none;
+       n = nodes[n].previous) {
+    breaks.push_back(nodes[n].item);
+  }
+  std::reverse(breaks.begin(), breaks.end());
+  return breaks;
+}
+
+void
+TextLayout::BuildLines(const vector<size_t>& breaks)
+{
+  size_t from = 0;
+  double top = 0.0;
+  for (size_t b : breaks) {
+    size_t start = from;
+    while (start < b && items[start].kind != ItemKind::Box) {
+      ++start;
+    }
+    double natural = 0.0, stretch = 0.0, shrink = 0.0;
+    bool fil = false;
+    for (size_t k = start; k < b; ++k) {
+      if (items[k].kind == ItemKind::Penalty) {
+        continue;
+      }
+      natural += items[k].width;
+      stretch += items[k].stretch;
+      shrink += items[k].shrink;
+      fil = fil || items[k].fil;
+    }
+    if (items[b].kind == ItemKind::Penalty) {
+      natural += items[b].width;
+    }
+    double ratio = 0.0;
+    if (options.justify && !fil) {
+      if (natural < options.width && stretch > 0) {
+        ratio = (options.width - natural) / stretch;
+      } else if (natural > options.width && shrink > 0) {
+        ratio = std::max((options.width - natural) / shrink, -1.0);
+      }
+    }
+
+    LayoutLine line;
+    line.hyphenated = false;
+    double x = 0.0;
+    LayoutSegment* segment = nullptr;
+    auto open = [&](size_t run) {
+      if (segment) {
+        segment->width = x - segment->x;
+      }
+      line.segments.push_back({ run, x, 0.0, u32string(), {} });
+      segment = &line.segments.back();
+      segment->pieces.push_back({ 0, 0.0 });
+    };
+    for (size_t k = start; k < b; ++k) {
+      const Item& it = items[k];
+      if (it.kind == ItemKind::Box) {
+        if (!segment || segment->run != it.run) {
+          open(it.run);
+        }
+        for (size_t j = it.begin; j < it.end; ++j) {
+          segment->text.push_back(chars[j]);
+          x += advances[j];
+          if (j + 1 < it.end && kerns[j] != 0.0) {
+            x += kerns[j];
+            segment->pieces.push_back({ segment->text.size(), x - segment->x });
+          }
+        }
+      } else if (it.kind == ItemKind::Glue && !it.fil) {
+        double width =
+          it.width + (ratio > 0 ? ratio * it.stretch : ratio * it.shrink);
+        if (ratio == 0.0 && segment && segment->run == it.run) {
+          segment->text.push_back(' ');
+          x += width;
+        } else {
+          x += width;
+          if (segment) {
+            segment->width = x - width - segment->x;
+          }
+          segment = nullptr;
+        }
+      }
+    }
+    const Item& end = items[b];
+    if (end.kind == ItemKind::Penalty && end.flagged) {
+      line.hyphenated = true;
+      if (end.width > 0.0) {
+        if (!segment || segment->run != end.run) {
+          open(end.run);
+        }
+        segment->text.push_back('-');
+        x += end.width;
+      }
+    }
+    if (segment) {
+      segment->width = x - segment->x;
+    }
+    line.width = x;
+
+    double offset = 0.0;
+    if (ratio == 0.0) {
+      if (options.alignment == ePdfAlignment_Center) {
+        offset = (options.width - line.width) / 2;
+      } else if (options.alignment == ePdfAlignment_Right) {
+        offset = options.width - line.width;
+      }
+    }
+    for (auto& s : line.segments) {
+      s.x += offset;
+    }
+
+    double size = 0.0, ascent = 0.0, descent = 0.0;
+    auto metrics = [&](size_t run) {
+      size = std::max(size, runs[run].size);
+      ascent =
+        std::max(ascent, runs[run].advances->GetAscent() * runs[run].size / 1000);
+      descent = std::min(descent,
+                         runs[run].advances->GetDescent() * runs[run].size /
+                           1000);
+    };
+    if (line.segments.empty()) {
+      metrics(end.run);
+    }
+    for (auto& s : line.segments) {
+      metrics(s.run);
+    }
+    line.height = size * options.lineHeight;
+    line.top = top;
+    line.baseline = top + (line.height - (ascent - descent)) / 2 + ascent;
+    top += line.height;
+    lines.push_back(std::move(line));
+    from = b + 1;
+  }
+}
+
+double
+TextLayout::GetHeight() const
+{
+  return lines.empty() ? 0.0 : lines.back().top + lines.back().height;
+}
+
+void
+TextLayout::Draw(PdfPainter* painter, double x, double top) const
+{
+  PdfFont* previous = painter->GetFont();
+  std::map<PdfFont*, float> sizes;
+  for (auto& run : runs) {
+    sizes.emplace(run.font, run.font->GetFontSize());
+  }
+  auto restore = [&]() {
+    for (auto& s : sizes) {
+      s.first->SetFontSize(s.second);
+    }
+    if (previous) {
+      painter->SetFont(previous);
+    }
+  };
+  try {
+    for (auto& line : lines) {
+      double y = top - line.baseline;
+      for (auto& segment : line.segments) {
+        if (segment.text.empty()) {
+          continue;
+        }
+        const TextRun& run = runs[segment.run];
+        run.font->SetFontSize(static_cast<float>(run.size));
+        painter->SetFont(run.font);
+        painter->BeginText(x + segment.x, y);
+        for (size_t p = 0; p < segment.pieces.size(); ++p) {
+          const LayoutPiece& piece = segment.pieces[p];
+          size_t end = p + 1 < segment.pieces.size()
+                         ? segment.pieces[p + 1].offset
+                         : segment.text.size();
+          if (p > 0) {
+            painter->MoveTextPos(piece.x - segment.pieces[p - 1].x, 0.0);
+          }
+          string text = EncodeUtf8(segment.text, piece.offset, end);
+          painter->AddText(
+            PdfString(reinterpret_cast<const pdf_utf8*>(text.c_str())));
+        }
+        painter->EndText();
+      }
+    }
+  } catch (...) {
+    restore();
+    throw;
+  }
+  restore();
+}
+}
@@ -0,0 +1,181 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NPDF_TEXTLAYOUT_H
+#define NPDF_TEXTLAYOUT_H
+
+#include "GlyphAdvanceCache.h"
+#include <memory>
+#include <podofo/podofo.h>
+#include <string>
+#include <vector>
+
+namespace NoPoDoFo {
+
+/**
+ * A span of text sharing a font and a font size. The font's scale and
+ * character spacing are read when the layout runs.
+ */
+struct TextRun
+{
+  PoDoFo::PdfFont* font;
+  std::shared_ptr<GlyphAdvanceCache> advances;
+  double size;
+  std::string text; // utf-8
+};
+
+enum class LineBreaking
+{
+  Greedy,
+  Optimal // Knuth-Plass, minimizes the total demerits of the paragraph
+};
+
+struct TextLayoutOptions
+{
+  double width = 0.0;
+  PoDoFo::EPdfAlignment alignment = PoDoFo::ePdfAlignment_Left;
+  // stretch and shrink interword spaces to the full width, the last line of
+  // each paragraph stays aligned by alignment
+  bool justify = false;
+  LineBreaking breaking = LineBreaking::Greedy;
+  bool kerning = true;
+  // line height as a multiple of the largest font size on the line
+  double lineHeight = 1.2;
+  // a run of whitespace is a single interword space
+  bool collapseSpaces = true;
+  // demerits of breaking at a hyphen or soft hyphen (U+00AD)
+  double hyphenPenalty = 50.0;
+};
+
+/**
+ * A piece of a segment drawn with a single text showing operator, split
+ * from the previous piece where a kerning pair moves the next glyph
+ */
+struct LayoutPiece
+{
+  size_t offset; // into LayoutSegment::text
+  double x;      // relative to the segment
+};
+
+struct LayoutSegment
+{
+  size_t run;
+  double x; // relative to the left edge of the layout
+  double width;
+  std::u32string text;
+  std::vector<LayoutPiece> pieces;
+};
+
+struct LayoutLine
+{
+  double top; // distance from the top of the layout, growing downwards
+  double baseline;
+  double width;
+  double height;
+  bool hyphenated;
+  std::vector<LayoutSegment> segments;
+
+  std::string Text() const;
+};
+
+/**
+ * Breaks runs of text into lines of a fixed width. Spaces are glue that can
+ * stretch and shrink, hyphens and soft hyphens are optional breaks with a
+ * penalty and newlines force a break. Only metrics are used, the document is
+ * not touched until Draw.
+ */
+class TextLayout
+{
+public:
+  TextLayout(std::vector<TextRun> runs, const TextLayoutOptions& options);
+  void Run();
+  const std::vector<LayoutLine>& GetLines() const { return lines; }
+  const std::vector<TextRun>& GetRuns() const { return runs; }
+  double GetHeight() const;
+  /**
+   * Draw the lines with the top left corner of the layout at x, top. Font
+   * sizes and the painter's font are restored afterwards.
+   */
+  void Draw(PoDoFo::PdfPainter* painter, double x, double top) const;
+
+  static std::u32string DecodeUtf8(const std::string&);
+  static std::string EncodeUtf8(const std::u32string&,
+                                size_t begin = 0,
+                                size_t end = std::u32string::npos);
+
+private:
+  enum class ItemKind
+  {
+    Box,
+    Glue,
+    Penalty
+  };
+  struct Item
+  {
+    ItemKind kind;
+    size_t run;
+    size_t begin; // range in chars
+    size_t end;
+    double width;
+    double stretch;
+    double shrink;
+    bool fil; // infinitely stretchable glue
+    double penalty;
+    bool flagged;
+  };
+
+  std::vector<TextRun> runs;
+  TextLayoutOptions options;
+  std::vector<LayoutLine> lines;
+  // paragraph text with the run of each character
+  std::u32string chars;
+  std::vector<size_t> charRuns;
+  std::vector<double> advances;
+  std::vector<double> kerns;
+  std::vector<Item> items;
+  // prefix sums over items, index k covers items [0, k)
+  std::vector<double> sumWidth;
+  std::vector<double> sumStretch;
+  std::vector<double> sumShrink;
+  std::vector<int> sumFil;
+
+  struct LineStats
+  {
+    size_t start; // first item after the discardables following a break
+    double width;
+    double stretch;
+    double shrink;
+    int fil;
+  };
+
+  void Measure();
+  void BuildItems();
+  void Sum();
+  bool Legal(size_t) const;
+  LineStats Stats(size_t from, size_t b) const;
+  std::vector<size_t> BreakGreedy() const;
+  std::vector<size_t> BreakOptimal() const;
+  void BuildLines(const std::vector<size_t>& breaks);
+  double Scale(size_t run) const;
+  // Tc between glyphs of a run, PdfFont char space is a percentage of the
+  // font size
+  double CharSpace(size_t run) const;
+};
+}
+#endif // NPDF_TEXTLAYOUT_H
@@ -0,0 +1,298 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TextSearch.h"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <regex>
+
+namespace NoPoDoFo {
+
+using std::u32string;
+using std::vector;
+
+// std::regex recurses per character of the subject, longer subjects risk
+// overflowing the stack of a worker thread
+static const size_t MaxRegexInput = 1024;
+
+// std::wregex works on wchar_t, UTF-16 where it is 16 bit wide. offsets, when
+// given, receives the code point index of every code unit plus the end.
+static std::wstring
+ToWide(u32string::const_iterator begin,
+       u32string::const_iterator end,
+       vector<size_t>* offsets = nullptr)
+{
+  std::wstring out;
+  out.reserve(static_cast<size_t>(end - begin));
+  size_t index = 0;
+  for (auto it = begin; it != end; ++it, ++index) {
+    char32_t c = *it;
+    if (sizeof(wchar_t) == 2 && c > 0xFFFF && c <= 0x10FFFF) {
+      c -= 0x10000;
+      out.push_back(static_cast<wchar_t>(0xD800 + (c >> 10)));
+      out.push_back(static_cast<wchar_t>(0xDC00 + (c & 0x3FF)));
+      if (offsets) {
+        offsets->push_back(index);
+        offsets->push_back(index);
+      }
+    } else {
+      out.push_back(static_cast<wchar_t>(c));
+      if (offsets) {
+        offsets->push_back(index);
+      }
+    }
+  }
+  if (offsets) {
+    offsets->push_back(index);
+  }
+  return out;
+}
+
+char32_t
+TextSearch::Fold(char32_t c)
+{
+  if (c >= 'A' && c <= 'Z') {
+    return c + 0x20;
+  }
+  if (c < 0xC0) {
+    return c;
+  }
+  // Latin-1, Greek and Cyrillic upper case blocks
+  if ((c >= 0xC0 && c <= 0xDE && c != 0xD7) || (c >= 0x391 && c <= 0x3A9) ||
+      (c >= 0x410 && c <= 0x42F)) {
+    return c + 0x20;
+  }
+  if (c >= 0x400 && c <= 0x40F) {
+    return c + 0x50;
+  }
+  // Latin Extended-A alternates upper/lower case
+  if (c >= 0x100 && c <= 0x17F && c != 0x130 && c != 0x131 && c != 0x138 &&
+      c != 0x149 && c != 0x178 && c != 0x17F) {
+    const bool oddUpper = (c >= 0x139 && c <= 0x148) || c >= 0x179;
+    if ((c % 2 == 1) == oddUpper) {
+      return c + 1;
+    }
+  }
+  return c;
+}
+
+u32string
+TextSearch::Fold(const u32string& in)
+{
+  u32string out(in);
+  for (auto& c : out) {
+    c = Fold(c);
+  }
+  return out;
+}
+
+bool
+TextSearch::IsWordChar(char32_t c)
+{
+  if (c < 0x80) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+           (c >= 'A' && c <= 'Z') || c == '_';
+  }
+  return c >= 0xC0 && !(c >= 0x2000 && c <= 0x206F) &&
+         !(c >= 0x3000 && c <= 0x303F);
+}
+
+PageText
+TextSearch::Layout(const vector<TextRun>& runs)
+{
+  PageText page;
+  const TextRun* previous = nullptr;
+  auto separator = [&](char32_t c) {
+    page.text.push_back(c);
+    page.boxes.emplace_back();
+    page.placed.push_back(false);
+  };
+  for (auto& run : runs) {
+    if (previous) {
+      const double size = std::max(run.fontSize, previous->fontSize);
+      const Box& last = previous->glyphs.back().box;
+      const Box& first = run.glyphs.front().box;
+      if (std::fabs(run.baseline - previous->baseline) > size * 0.5) {
+        separator('\n');
+      } else if (first.left - last.right > size * 0.15) {
+        separator(' ');
+      }
+    }
+    for (auto& glyph : run.glyphs) {
+      page.text.push_back(glyph.ch);
+      page.boxes.push_back(glyph.box);
+      page.placed.push_back(true);
+    }
+    previous = &run;
+  }
+  page.folded = Fold(page.text);
+  return page;
+}
+
+static vector<Box>
+HitRects(const PageText& page, size_t start, size_t end)
+{
+  vector<Box> rects;
+  for (size_t i = start; i < end; ++i) {
+    if (!page.placed[i]) {
+      continue;
+    }
+    const Box& box = page.boxes[i];
+    if (!rects.empty()) {
+      Box& current = rects.back();
+      const double height = current.top - current.bottom;
+      if (std::fabs(box.bottom - current.bottom) < height * 0.5) {
+        current.left = std::min(current.left, box.left);
+        current.right = std::max(current.right, box.right);
+        current.bottom = std::min(current.bottom, box.bottom);
+        current.top = std::max(current.top, box.top);
+        continue;
+      }
+    }
+    rects.push_back(box);
+  }
+  return rects;
+}
+
+void
+TextSearch::Find(const PageText& page,
+                 const u32string& query,
+                 const SearchOptions& options,
+                 int pageIndex,
+                 vector<SearchHit>& out)
+{
+  auto accept = [&](size_t start, size_t end) {
+    if (end <= start) {
+      return;
+    }
+    if (options.wholeWord &&
+        ((start > 0 && IsWordChar(page.text[start - 1])) ||
+         (end < page.text.size() && IsWordChar(page.text[end])))) {
+      return;
+    }
+    SearchHit hit;
+    hit.page = pageIndex;
+    hit.text =
+      TextExtractor::ToUtf8(page.text.substr(start, end - start));
+    hit.rects = HitRects(page, start, end);
+    out.push_back(std::move(hit));
+  };
+
+  if (options.regex) {
+    auto flags = std::regex_constants::ECMAScript;
+    if (options.caseFold) {
+      flags |= std::regex_constants::icase;
+    }
+    std::wregex expression(ToWide(query.begin(), query.end()), flags);
+    // lines are matched one at a time, cut into windows of MaxRegexInput
+    // characters, a match never spans two of them
+    size_t line = 0;
+    while (line < page.text.size()) {
+      size_t lineEnd = page.text.find(U'\n', line);
+      if (lineEnd == u32string::npos) {
+        lineEnd = page.text.size();
+      }
+      for (size_t begin = line; begin < lineEnd; begin += MaxRegexInput) {
+        const size_t end = std::min(lineEnd, begin + MaxRegexInput);
+        vector<size_t> offsets;
+        const std::wstring subject = ToWide(
+          page.text.begin() + begin, page.text.begin() + end, &offsets);
+        for (auto it = std::wsregex_iterator(
+               subject.begin(), subject.end(), expression);
+             it != std::wsregex_iterator();
+             ++it) {
+          const auto position = static_cast<size_t>(it->position());
+          const auto length = static_cast<size_t>(it->length());
+          accept(begin + offsets[position],
+                 begin + offsets[position + length]);
+        }
+      }
+      line = lineEnd + 1;
+    }
+    return;
+  }
+  if (query.empty()) {
+    return;
+  }
+  const u32string& subject = options.caseFold ? page.folded : page.text;
+  const u32string needle = options.caseFold ? Fold(query) : query;
+  size_t position = subject.find(needle);
+  while (position != u32string::npos) {
+    accept(position, position + needle.size());
+    position = subject.find(needle, position + 1);
+  }
+}
+
+uint64_t
+TextIndex::Key(const char32_t* c)
+{
+  return (static_cast<uint64_t>(c[0]) << 42) |
+         (static_cast<uint64_t>(c[1]) << 21) | static_cast<uint64_t>(c[2]);
+}
+
+TextIndex::TextIndex(vector<PageText>&& input)
+  : pages(std::move(input))
+{
+  for (size_t p = 0; p < pages.size(); ++p) {
+    const u32string& text = pages[p].folded;
+    for (size_t i = 0; i + 2 < text.size(); ++i) {
+      auto& list = postings[Key(&text[i])];
+      if (list.empty() || list.back() != p) {
+        list.push_back(static_cast<uint32_t>(p));
+      }
+    }
+  }
+}
+
+vector<size_t>
+TextIndex::Candidates(const u32string& folded) const
+{
+  vector<size_t> result;
+  if (folded.size() < 3) {
+    for (size_t p = 0; p < pages.size(); ++p) {
+      result.push_back(p);
+    }
+    return result;
+  }
+  vector<uint32_t> current;
+  for (size_t i = 0; i + 2 < folded.size(); ++i) {
+    auto it = postings.find(Key(&folded[i]));
+    if (it == postings.end()) {
+      return result;
+    }
+    if (i == 0) {
+      current = it->second;
+    } else {
+      vector<uint32_t> next;
+      std::set_intersection(current.begin(),
+                            current.end(),
+                            it->second.begin(),
+                            it->second.end(),
+                            std::back_inserter(next));
+      current.swap(next);
+    }
+    if (current.empty()) {
+      return result;
+    }
+  }
+  result.assign(current.begin(), current.end());
+  return result;
+}
+}
@@ -0,0 +1,87 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NPDF_TEXTSEARCH_H
+#define NPDF_TEXTSEARCH_H
+
+#include "../base/TextExtractor.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace NoPoDoFo {
+
+/**
+ * Reading order text of a page, each character keeps the box of the glyph
+ * it was decoded from. Inserted word and line separators have no box.
+ */
+struct PageText
+{
+  std::u32string text;
+  std::u32string folded;
+  std::vector<Box> boxes;
+  std::vector<bool> placed;
+};
+
+struct SearchOptions
+{
+  bool regex = false;
+  bool caseFold = false;
+  bool wholeWord = false;
+};
+
+struct SearchHit
+{
+  int page = 0;
+  std::string text;
+  std::vector<Box> rects;
+};
+
+class TextSearch
+{
+public:
+  static PageText Layout(const std::vector<TextRun>&);
+  static void Find(const PageText&,
+                   const std::u32string& query,
+                   const SearchOptions&,
+                   int page,
+                   std::vector<SearchHit>& out);
+  static char32_t Fold(char32_t);
+  static std::u32string Fold(const std::u32string&);
+  static bool IsWordChar(char32_t);
+};
+
+/**
+ * Trigram index over the case folded text of every page of a document. The
+ * index keeps the laid out page text so repeated queries skip extraction and
+ * only scan pages containing every trigram of the query.
+ */
+class TextIndex
+{
+public:
+  explicit TextIndex(std::vector<PageText>&& pages);
+  std::vector<size_t> Candidates(const std::u32string& folded) const;
+  const std::vector<PageText>& GetPages() const { return pages; }
+
+private:
+  std::vector<PageText> pages;
+  std::unordered_map<uint64_t, std::vector<uint32_t>> postings;
+  static uint64_t Key(const char32_t*);
+};
+}
+#endif // NPDF_TEXTSEARCH_H
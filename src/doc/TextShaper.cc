@@ -0,0 +1,467 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TextShaper.h"
+#include "ContentsWriter.h"
+#include "Encoding.h"
+#include "TextLayout.h"
+#include <algorithm>
+
+namespace NoPoDoFo {
+
+using namespace PoDoFo;
+using std::string;
+using std::u32string;
+using std::vector;
+
+/**
+ * Presentation forms of the Arabic letters U+0621 to U+064A, in the order
+ * isolated, final, initial, medial starting at base. R letters only join
+ * to the previous letter and have two forms, D letters join both ways.
+ */
+struct ArabicLetter
+{
+  char16_t base;
+  char type;
+};
+
+static const ArabicLetter ArabicLetters[] = {
+  { 0xFE80, 'U' }, { 0xFE81, 'R' }, { 0xFE83, 'R' }, { 0xFE85, 'R' },
+  { 0xFE87, 'R' }, { 0xFE89, 'D' }, { 0xFE8D, 'R' }, { 0xFE8F, 'D' },
+  { 0xFE93, 'R' }, { 0xFE95, 'D' }, { 0xFE99, 'D' }, { 0xFE9D, 'D' },
+  { 0xFEA1, 'D' }, { 0xFEA5, 'D' }, { 0xFEA9, 'R' }, { 0xFEAB, 'R' },
+  { 0xFEAD, 'R' }, { 0xFEAF, 'R' }, { 0xFEB1, 'D' }, { 0xFEB5, 'D' },
+  { 0xFEB9, 'D' }, { 0xFEBD, 'D' }, { 0xFEC1, 'D' }, { 0xFEC5, 'D' },
+  { 0xFEC9, 'D' }, { 0xFECD, 'D' }, { 0, 'U' },      { 0, 'U' },
+  { 0, 'U' },      { 0, 'U' },      { 0, 'U' },      { 0, 'C' },
+  { 0xFED1, 'D' }, { 0xFED5, 'D' }, { 0xFED9, 'D' }, { 0xFEDD, 'D' },
+  { 0xFEE1, 'D' }, { 0xFEE5, 'D' }, { 0xFEE9, 'D' }, { 0xFEED, 'R' },
+  { 0xFEEF, 'R' }, { 0xFEF1, 'D' },
+};
+
+// combining marks, skipped when looking for the neighbouring letters
+static bool
+IsTransparent(char32_t c)
+{
+  return (c >= 0x064B && c <= 0x065F) || c == 0x0670;
+}
+
+static char
+JoiningType(char32_t c)
+{
+  if (c >= 0x0621 && c <= 0x064A) {
+    return ArabicLetters[c - 0x0621].type;
+  }
+  return IsTransparent(c) ? 'T' : 'U';
+}
+
+// isolated form of lam followed by this alef, 0 for other letters
+static char32_t
+LamAlef(char32_t c)
+{
+  switch (c) {
+    case 0x0622:
+      return 0xFEF5;
+    case 0x0623:
+      return 0xFEF7;
+    case 0x0625:
+      return 0xFEF9;
+    case 0x0627:
+      return 0xFEFB;
+    default:
+      return 0;
+  }
+}
+
+enum class BidiClass
+{
+  L,
+  R,
+  Number,
+  Neutral
+};
+
+static BidiClass
+Classify(char32_t c)
+{
+  if ((c >= '0' && c <= '9') || (c >= 0x0660 && c <= 0x0669) ||
+      (c >= 0x06F0 && c <= 0x06F9)) {
+    return BidiClass::Number;
+  }
+  if ((c >= 0x0590 && c <= 0x08FF) || (c >= 0xFB1D && c <= 0xFDFF) ||
+      (c >= 0xFE70 && c <= 0xFEFF)) {
+    return BidiClass::R;
+  }
+  if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+    return BidiClass::L;
+  }
+  if (c < 0xC0 || c == 0xD7 || c == 0xF7 || (c >= 0x2000 && c <= 0x206F)) {
+    return BidiClass::Neutral;
+  }
+  return BidiClass::L;
+}
+
+static char32_t
+Mirror(char32_t c)
+{
+  switch (c) {
+    case '(':
+      return ')';
+    case ')':
+      return '(';
+    case '[':
+      return ']';
+    case ']':
+      return '[';
+    case '{':
+      return '}';
+    case '}':
+      return '{';
+    case '<':
+      return '>';
+    case '>':
+      return '<';
+    case 0xAB:
+      return 0xBB;
+    case 0xBB:
+      return 0xAB;
+    default:
+      return c;
+  }
+}
+
+double
+ShapedRun::Width(const PdfFont* font) const
+{
+  const double scale = font->GetFontScale() / 100.0;
+  size_t spaces = static_cast<size_t>(std::count(glyphs.begin(), glyphs.end(), ' '));
+  return advance * font->GetFontSize() / 1000.0 * scale +
+         glyphs.size() * font->GetFontCharSpace() * font->GetFontSize() /
+           100.0 * scale +
+         spaces * font->GetWordSpace() * scale;
+}
+
+static void
+WriteString(PdfFont* font,
+            const u32string& glyphs,
+            size_t begin,
+            size_t end,
+            ContentsWriter& writer)
+{
+  static const char hex[] = "0123456789ABCDEF";
+  string utf8 = TextLayout::EncodeUtf8(glyphs, begin, end);
+  PdfString text(reinterpret_cast<const pdf_utf8*>(utf8.c_str()));
+  if (font->IsSubsetting()) {
+    font->AddUsedSubsettingGlyphs(text, static_cast<long>(text.GetLength()));
+  }
+  PdfRefCountedBuffer encoded =
+    font->GetEncoding()->ConvertToEncoding(text, font);
+  string out;
+  out.reserve(encoded.GetSize() * 2 + 2);
+  out.push_back('<');
+  for (size_t i = 0; i < encoded.GetSize(); ++i) {
+    auto b = static_cast<unsigned char>(encoded.GetBuffer()[i]);
+    out.push_back(hex[b >> 4]);
+    out.push_back(hex[b & 0xF]);
+  }
+  out.push_back('>');
+  writer.Raw(out.data(), out.size());
+}
+
+void
+ShapedRun::Write(PdfFont* font, ContentsWriter& writer) const
+{
+  writer.Raw("[", 1);
+  size_t begin = 0;
+  for (size_t i = 0; i < glyphs.size(); ++i) {
+    if (i + 1 == glyphs.size() || adjustments[i] != 0.0) {
+      WriteString(font, glyphs, begin, i + 1, writer);
+      if (i + 1 < glyphs.size()) {
+        writer.Number(adjustments[i]);
+      }
+      begin = i + 1;
+    }
+  }
+  writer.Operator("] TJ");
+}
+
+TextShaper::TextShaper(std::shared_ptr<GlyphAdvanceCache> advances,
+                       size_t capacity)
+  : advances(std::move(advances))
+  , capacity(capacity)
+{}
+
+void
+TextShaper::JoinArabic(u32string& text, bool ligatures, const Usable& usable)
+{
+  u32string out;
+  out.reserve(text.size());
+  const size_t n = text.size();
+  for (size_t i = 0; i < n; ++i) {
+    char32_t c = text[i];
+    char type = JoiningType(c);
+    if (c < 0x0621 || c > 0x064A || !ArabicLetters[c - 0x0621].base) {
+      out.push_back(c);
+      continue;
+    }
+    char previous = 'U';
+    for (size_t j = i; j-- > 0;) {
+      char t = JoiningType(text[j]);
+      if (t != 'T') {
+        previous = t;
+        break;
+      }
+    }
+    char next = 'U';
+    size_t nextIndex = n;
+    for (size_t j = i + 1; j < n; ++j) {
+      char t = JoiningType(text[j]);
+      if (t != 'T') {
+        next = t;
+        nextIndex = j;
+        break;
+      }
+    }
+    bool joinsPrevious =
+      (type == 'R' || type == 'D') && (previous == 'D' || previous == 'C');
+    if (ligatures && c == 0x0644 && nextIndex < n && LamAlef(text[nextIndex])) {
+      char32_t ligature = LamAlef(text[nextIndex]) + (joinsPrevious ? 1 : 0);
+      if (usable(ligature)) {
+        out.push_back(ligature);
+        // marks on the lam stay with the ligature
+        out.append(text, i + 1, nextIndex - i - 1);
+        i = nextIndex;
+        continue;
+      }
+    }
+    bool joinsNext =
+      type == 'D' && (next == 'R' || next == 'D' || next == 'C');
+    int form = joinsPrevious ? (joinsNext ? 3 : 1) : (joinsNext ? 2 : 0);
+    char32_t shaped = ArabicLetters[c - 0x0621].base + form;
+    out.push_back(usable(shaped) ? shaped : c);
+  }
+  text.swap(out);
+}
+
+void
+TextShaper::Ligate(u32string& text, const Usable& usable)
+{
+  static const struct
+  {
+    const char32_t* sequence;
+    size_t length;
+    char32_t ligature;
+  } Ligatures[] = {
+    { U"ffi", 3, 0xFB03 }, { U"ffl", 3, 0xFB04 }, { U"ff", 2, 0xFB00 },
+    { U"fi", 2, 0xFB01 },  { U"fl", 2, 0xFB02 },
+  };
+  u32string out;
+  out.reserve(text.size());
+  for (size_t i = 0; i < text.size();) {
+    bool replaced = false;
+    if (text[i] == 'f') {
+      for (auto& l : Ligatures) {
+        if (text.compare(i, l.length, l.sequence) == 0 &&
+            usable(l.ligature)) {
+          out.push_back(l.ligature);
+          i += l.length;
+          replaced = true;
+          break;
+        }
+      }
+    }
+    if (!replaced) {
+      out.push_back(text[i++]);
+    }
+  }
+  text.swap(out);
+}
+
+/**
+ * A reduced form of the Unicode bidirectional algorithm for a single line
+ * without explicit embeddings: strong characters set the level, numbers keep
+ * their left to right order, neutrals between two characters of the same
+ * direction take that direction and otherwise the paragraph's. Runs are then
+ * reversed from the highest level down (rule L2) and mirrored characters in
+ * right to left runs replaced.
+ */
+void
+TextShaper::Reorder(u32string& text, TextDirection direction, bool& rtl)
+{
+  const size_t n = text.size();
+  vector<BidiClass> classes(n);
+  for (size_t i = 0; i < n; ++i) {
+    classes[i] = Classify(text[i]);
+  }
+  rtl = direction == TextDirection::RightToLeft;
+  if (direction == TextDirection::Auto) {
+    for (BidiClass c : classes) {
+      if (c == BidiClass::L || c == BidiClass::R) {
+        rtl = c == BidiClass::R;
+        break;
+      }
+    }
+  }
+  const int base = rtl ? 1 : 0;
+  const int left = rtl ? 2 : 0;
+  if (!rtl && std::none_of(classes.begin(), classes.end(), [](BidiClass c) {
+        return c == BidiClass::R;
+      })) {
+    return;
+  }
+  // direction each character imposes on neighbouring neutrals
+  vector<BidiClass> strong(n, BidiClass::Neutral);
+  BidiClass last = rtl ? BidiClass::R : BidiClass::L;
+  for (size_t i = 0; i < n; ++i) {
+    if (classes[i] == BidiClass::Number) {
+      strong[i] = last == BidiClass::R ? BidiClass::R : BidiClass::L;
+    } else if (classes[i] != BidiClass::Neutral) {
+      strong[i] = last = classes[i];
+    }
+  }
+  vector<int> levels(n, base);
+  last = rtl ? BidiClass::R : BidiClass::L;
+  for (size_t i = 0; i < n; ++i) {
+    switch (classes[i]) {
+      case BidiClass::L:
+        levels[i] = left;
+        break;
+      case BidiClass::R:
+        levels[i] = 1;
+        break;
+      case BidiClass::Number:
+        levels[i] = strong[i] == BidiClass::R || rtl ? 2 : 0;
+        break;
+      case BidiClass::Neutral: {
+        size_t j = i;
+        while (j < n && classes[j] == BidiClass::Neutral) {
+          ++j;
+        }
+        BidiClass before = i > 0 ? strong[i - 1] : last;
+        BidiClass after = j < n ? strong[j] : (rtl ? BidiClass::R : BidiClass::L);
+        int level = base;
+        if (before == after) {
+          level = before == BidiClass::R ? 1 : left;
+        }
+        std::fill(levels.begin() + i, levels.begin() + j, level);
+        i = j - 1;
+        break;
+      }
+    }
+  }
+  for (size_t i = 0; i < n; ++i) {
+    if (levels[i] % 2) {
+      text[i] = Mirror(text[i]);
+    }
+  }
+  int highest = *std::max_element(levels.begin(), levels.end());
+  for (int level = highest; level >= 1; --level) {
+    for (size_t i = 0; i < n;) {
+      if (levels[i] < level) {
+        ++i;
+        continue;
+      }
+      size_t j = i;
+      while (j < n && levels[j] >= level) {
+        ++j;
+      }
+      std::reverse(text.begin() + i, text.begin() + j);
+      std::reverse(levels.begin() + i, levels.begin() + j);
+      i = j;
+    }
+  }
+}
+
+std::shared_ptr<const ShapedRun>
+TextShaper::Shape(const string& text,
+                  const ShapeOptions& options,
+                  const PdfEncoding* encoding)
+{
+  // a substitution the encoding can not encode would be lost on write
+  std::shared_ptr<const SingleByteTable> table;
+  char substitutions = 'I';
+  if (!dynamic_cast<const PdfIdentityEncoding*>(encoding)) {
+    table = encoding ? SingleByteTable::Get(encoding) : nullptr;
+    substitutions = table ? 'S' : '-';
+  }
+  string key;
+  key.reserve(text.size() + 4);
+  key.push_back(options.kerning ? 'k' : '-');
+  key.push_back(options.ligatures ? 'l' : '-');
+  key.push_back(static_cast<char>('0' + static_cast<int>(options.direction)));
+  key.push_back(substitutions);
+  if (table) {
+    key += static_cast<const PdfSimpleEncoding*>(encoding)->GetName().GetName();
+    key.push_back('\0');
+  }
+  key += text;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = index.find(key);
+    if (it != index.end()) {
+      entries.splice(entries.begin(), entries, it->second);
+      return it->second->second;
+    }
+  }
+
+  auto usable = [&](char32_t c) {
+    if (substitutions == '-' || !advances->HasGlyph(c)) {
+      return false;
+    }
+    return !table || (c < table->fromUnicode.size() &&
+                      table->fromUnicode[c] >= 0);
+  };
+  auto run = std::make_shared<ShapedRun>();
+  u32string glyphs = TextLayout::DecodeUtf8(text);
+  if (std::any_of(glyphs.begin(), glyphs.end(), [](char32_t c) {
+        return c >= 0x0621 && c <= 0x064A;
+      })) {
+    JoinArabic(glyphs, options.ligatures, usable);
+  }
+  if (options.ligatures && glyphs.find('f') != u32string::npos) {
+    Ligate(glyphs, usable);
+  }
+  Reorder(glyphs, options.direction, run->rtl);
+  vector<double> widths(glyphs.size());
+  vector<double> kerns(glyphs.size(), 0.0);
+  advances->Measure(glyphs.data(),
+                    glyphs.size(),
+                    widths.data(),
+                    options.kerning ? kerns.data() : nullptr);
+  run->adjustments.resize(glyphs.size());
+  for (size_t i = 0; i < glyphs.size(); ++i) {
+    run->advance += widths[i] + kerns[i];
+    run->adjustments[i] = -kerns[i];
+  }
+  run->glyphs = std::move(glyphs);
+
+  std::lock_guard<std::mutex> guard(lock);
+  auto it = index.find(key);
+  if (it != index.end()) {
+    return it->second->second;
+  }
+  entries.emplace_front(key, run);
+  index[key] = entries.begin();
+  while (entries.size() > capacity) {
+    index.erase(entries.back().first);
+    entries.pop_back();
+  }
+  return run;
+}
+}
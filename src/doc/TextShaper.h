@@ -0,0 +1,118 @@
+/**
+ * This file is part of the NoPoDoFo (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * NoPoDoFo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NoPoDoFo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NPDF_TEXTSHAPER_H
+#define NPDF_TEXTSHAPER_H
+
+#include "GlyphAdvanceCache.h"
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <podofo/podofo.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace NoPoDoFo {
+
+class ContentsWriter;
+
+enum class TextDirection
+{
+  Auto, // from the first strong character
+  LeftToRight,
+  RightToLeft
+};
+
+struct ShapeOptions
+{
+  bool kerning = true;
+  bool ligatures = true;
+  TextDirection direction = TextDirection::Auto;
+};
+
+/**
+ * A line of text after shaping, in visual (left to right) order. Glyphs are
+ * still unicode codepoints, substitutions use the Arabic and Latin
+ * presentation forms so the font encoding maps them to glyph ids.
+ */
+struct ShapedRun
+{
+  std::u32string glyphs;
+  // TJ adjustment after each glyph in 1/1000 em, the last one always 0
+  std::vector<double> adjustments;
+  // unscaled advance including kerning, 1/1000 em
+  double advance = 0.0;
+  bool rtl = false;
+
+  /**
+   * Width at the font's size, scale and spacing
+   */
+  double Width(const PoDoFo::PdfFont*) const;
+  /**
+   * Append the glyphs as a TJ operator, inside a text object
+   */
+  void Write(PoDoFo::PdfFont*, ContentsWriter&) const;
+};
+
+/**
+ * Shapes single lines of text for one font: Arabic joining forms and
+ * lam-alef ligatures, Latin f-ligatures, bidirectional reordering and
+ * kerning from the GlyphAdvanceCache. Forms the font has no glyph for, or
+ * its encoding can not encode, are left alone. There is no OpenType layout
+ * (GSUB / GPOS), substitutions are table driven. Shaped runs are kept in a
+ * bounded LRU keyed by the text, options and encoding, safe to use from any
+ * thread.
+ */
+class TextShaper
+{
+public:
+  explicit TextShaper(std::shared_ptr<GlyphAdvanceCache> advances,
+                      size_t capacity = 4096);
+  /**
+   * Substitutions are only applied when the encoding of the font drawing
+   * the run can encode them: always for Identity, through the byte table for
+   * simple encodings and never for any other encoding
+   */
+  std::shared_ptr<const ShapedRun> Shape(const std::string& text,
+                                         const ShapeOptions&,
+                                         const PoDoFo::PdfEncoding*);
+  const std::shared_ptr<GlyphAdvanceCache>& GetAdvances() const
+  {
+    return advances;
+  }
+
+  static void Reorder(std::u32string&, TextDirection, bool& rtl);
+
+private:
+  typedef std::pair<std::string, std::shared_ptr<const ShapedRun>> Entry;
+  std::shared_ptr<GlyphAdvanceCache> advances;
+  size_t capacity;
+  std::mutex lock;
+  std::list<Entry> entries; // most recently used first
+  std::unordered_map<std::string, std::list<Entry>::iterator> index;
+
+  typedef std::function<bool(char32_t)> Usable;
+  void JoinArabic(std::u32string&, bool ligatures, const Usable&);
+  void Ligate(std::u32string&, const Usable&);
+};
+}
+#endif // NPDF_TEXTSHAPER_H